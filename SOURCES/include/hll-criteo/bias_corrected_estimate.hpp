@@ -1,17 +1,33 @@
 #ifndef _BIAS_CORRECTED_ESTIMATE_H_
 #define _BIAS_CORRECTED_ESTIMATE_H_
 
-#include <vector>
+#include <stdint.h>
 
 class BiasCorrectedEstimate {
-  static double kNeighborsInterpolationBias(uint64_t rawEstimate, uint8_t precision);
+public:
+  static const uint8_t MIN_PRECISION = 4;
+  static const uint8_t MAX_PRECISION = 18;
+  static const uint32_t NEIGHBORS = 6;
 
-  static const std::vector<std::vector<double>> rawEstimateData;
-  static const std::vector<std::vector<double>> biasData;
+  /**
+   * Raw estimates measured for a precision, in ascending order, and the bias
+   * measured at each of them. Both point to static data.
+   */
+  struct Table {
+    const double* rawEstimates;
+    const double* biases;
+    uint32_t size;
+  };
 
-public:
   static uint64_t estimate(uint64_t rawEstimate, uint8_t precision);
+
+  static double kNeighborsInterpolationBias(uint64_t rawEstimate, uint8_t precision);
+
+  static const Table& table(uint8_t precision);
+
+private:
+  static const Table tables[MAX_PRECISION - MIN_PRECISION + 1];
 };
 
 
-#endif
\ No newline at end of file
+#endif
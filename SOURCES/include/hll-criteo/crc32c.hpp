@@ -0,0 +1,84 @@
+#ifndef _CRC32C_H_
+#define _CRC32C_H_
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+#include "../hll_utils.hpp"
+
+/**
+ * CRC-32C (Castagnoli) of a byte range, with the crc32 instruction of SSE4.2
+ * 8 bytes at a time when the CPU we run on has it, and a byte at a time from
+ * a table otherwise. Both give the same value, so a checksum written on one
+ * node checks out on any other.
+ */
+class Crc32c {
+  public:
+    static uint32_t of(const uint8_t* data, size_t length) {
+      static const Crc32cFunction crc32cForCpu = selectCrc32c();
+      return crc32cForCpu(data, length);
+    }
+
+  private:
+    typedef uint32_t (*Crc32cFunction)(const uint8_t*, size_t);
+
+    // reflected polynomial of CRC-32C
+    static const uint32_t POLYNOMIAL = 0x82f63b78;
+
+    struct Table {
+      uint32_t entries[256];
+
+      Table() {
+        for (uint32_t byte = 0; byte < 256; ++byte) {
+          uint32_t crc = byte;
+          for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (POLYNOMIAL & (0 - (crc & 1)));
+          }
+          entries[byte] = crc;
+        }
+      }
+    };
+
+    static uint32_t crc32cScalar(const uint8_t* data, size_t length) {
+      // built on first use, thread-safe as any local static
+      static const Table table;
+      uint32_t crc = 0xffffffff;
+      for (size_t i = 0; i < length; ++i) {
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+      }
+      return ~crc;
+    }
+
+#if defined(__x86_64__)
+    __target_isa__("sse4.2")
+    static uint32_t crc32cSse42(const uint8_t* data, size_t length) {
+      uint64_t crc = 0xffffffff;
+      size_t i = 0;
+      for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        crc = _mm_crc32_u64(crc, word);
+      }
+      uint32_t crc32 = static_cast<uint32_t>(crc);
+      for (; i < length; ++i) {
+        crc32 = _mm_crc32_u8(crc32, data[i]);
+      }
+      return ~crc32;
+    }
+#endif
+
+    static Crc32cFunction selectCrc32c() {
+#if defined(__x86_64__)
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("sse4.2")) {
+        return crc32cSse42;
+      }
+#endif
+      return crc32cScalar;
+    }
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef _HASH_FUNCTION_H_
+#define _HASH_FUNCTION_H_
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+
+#include "mix64_hash.hpp"
+#include "murmur_hash.hpp"
+#include "string_key.hpp"
+#include "xxh3_hash.hpp"
+
+/**
+ * The hash functions a synopsis can be built with, for the UDx to pick one at
+ * runtime by name while Hll<uint64_t> and its kernels stay compiled for
+ * MurMurHash: values are hashed with hashBatch() and handed over to
+ * Hll::addHashes() along with the id, which goes in the synopsis header.
+ * Strings and binary values are reduced to a 64-bit key with key() first, as
+ * StringKey does for MurMurHash. mix64 has no byte hash of its own and takes
+ * the XXH3 one.
+ */
+struct HashFunction {
+  typedef void (*HashBatch)(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed);
+  typedef uint64_t (*Key)(const char* data, size_t length);
+
+  uint8_t id;
+  const char* name;
+  HashBatch hashBatch;
+  Key key;
+
+  // nullptr for a name none of them has
+  static const HashFunction* forName(const std::string& name) {
+    for (size_t i = 0; i < COUNT; ++i) {
+      if (name == all()[i].name) {
+        return &all()[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // nullptr for an id none of them has, 0 included
+  static const HashFunction* forId(uint8_t id) {
+    for (size_t i = 0; i < COUNT; ++i) {
+      if (all()[i].id == id) {
+        return &all()[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // The name of the hash function of a synopsis header, or its id if we don't know it
+  static std::string describe(uint8_t id) {
+    const HashFunction* function = forId(id);
+    return function != nullptr ? std::string(function->name) : "#" + std::to_string(id);
+  }
+
+  static const size_t COUNT = 3;
+
+  // murmur first, the default
+  static const HashFunction* all() {
+    static const HashFunction functions[COUNT] = {
+      { MurMurHash<uint64_t>::ID, "murmur", &hashBatchWith<MurMurHash<uint64_t> >, &StringKey::of },
+      { Xxh3Hash<uint64_t>::ID, "xxh3", &hashBatchWith<Xxh3Hash<uint64_t> >, &xxh3Key },
+      { Mix64Hash<uint64_t>::ID, "mix64", &hashBatchWith<Mix64Hash<uint64_t> >, &xxh3Key },
+    };
+    return functions;
+  }
+
+private:
+  template<typename H>
+  static void hashBatchWith(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed) {
+    H().hashBatch(values, n, hashes, seed);
+  }
+
+  static uint64_t xxh3Key(const char* data, size_t length) {
+    return Xxh3::hashBytes(reinterpret_cast<const uint8_t*>(data), length);
+  }
+};
+
+#endif
@@ -2,17 +2,44 @@
 #define _HLL_H_
 
 #include <bitset>
+#include <cstddef>
 
 #include "../hll_utils.hpp"
+#include "crc32c.hpp"
+#include "hash_function.hpp"
 #include "hll_raw.hpp"
+#include "hll_sparse.hpp"
+#include "joint_estimate.hpp"
 
 
+// Version of the header serialize() writes
+static const uint8_t HLL_HEADER_VERSION = 2;
+// Synopses written before the header had a version have 0 in its place and
+// only the first 8 bytes of it
+static const size_t HLL_HEADER_V1_SIZE = 8;
+// Flag of HLLHdr::flags: checksum holds the CRC-32C of the payload
+static const uint8_t HLL_HEADER_CHECKSUM = 0x01;
+// Flags of HLLHdr::flags of an in-memory synopsis only, which serialize() never
+// writes: a RegisterHistogram of the registers follows them in the buffer, and
+// it is up to date
+static const uint8_t HLL_HEADER_HISTOGRAM = 0x02;
+static const uint8_t HLL_HEADER_HISTOGRAM_CURRENT = 0x04;
+
 struct HLLHdr {
   uint8_t magic[2] = {'H','L'};
   uint8_t format;
   uint8_t bucketBase;
   uint16_t bucketSparseCount; // Only meaning if format is sparse - only maintained at serialization
-  uint8_t padding[2] = {'\0','\0'}; // padding to reach 8 bytes in length
+  // 0 in the synopses written before it was recorded, which are read at the reader's precision
+  uint8_t precision = 0;
+  uint8_t version = HLL_HEADER_VERSION;
+  // the fields below are only in version 2 headers
+  uint32_t hashSeed = 0;
+  uint32_t checksum = 0;
+  uint32_t length = 0; // of the payload after the header
+  uint8_t hashId = 0; // Hash<T>::ID of the hash function the values went through, 0 while there are none
+  uint8_t flags = 0;
+  uint8_t padding[2] = {'\0','\0'}; // padding to reach 24 bytes in length
 } __packed__;
 
 typedef std::pair<std::unique_ptr<uint8_t[]>, size_t> SizedBuffer;
@@ -22,7 +49,11 @@ class Hll {
 
   HllRaw<T, H> hll;
   const HLLHdr *header;
-  LinearCounting linearCounting;
+  const HllKernels<T, H> *kernels;
+  bool checksum;
+  // registers for the payloads of a higher precision, see setFoldScratch()
+  uint8_t *foldScratch;
+  size_t foldScratchLength;
 
   static uint8_t formatToCode(Format format) {
     uint8_t ret;
@@ -31,90 +62,607 @@ class Hll {
     else if(format == Format::COMPACT_5BITS) ret = 0x04;
     else if(format == Format::COMPACT_4BITS) ret = 0x08;
     else if(format == Format::SPARSE) ret = 0x10;
+    else if(format == Format::SPARSE_VARINT) ret = 0x20;
+    // 0x80 flags the exceptions after the registers of the 5 or 4-bit format
+    else if(format == Format::COMPACT_5BITS_EXCEPTIONS) ret = 0x84;
+    else if(format == Format::COMPACT_4BITS_EXCEPTIONS) ret = 0x88;
+    // the first code that isn't a single bit or the exception flag
+    else if(format == Format::ENTROPY) ret = 0x03;
     else throw SerializationError("Unknown format parameter in formatToCode");
     return ret;
   }
 
+  // Payloads foldMany() hands over to HllKernels::foldMany() at most at once
+  static const size_t FOLD_MANY_BATCH_SIZE = 64;
+
+  /**
+   * Format of the registers of a payload for HllKernels::foldMany(), the 5 or
+   * 4-bit one for the formats with exceptions. False for the formats it
+   * doesn't fold.
+   */
+  static bool registerFormat(uint8_t code, Format& format) {
+    if (code == formatToCode(Format::NORMAL)) format = Format::NORMAL;
+    else if (code == formatToCode(Format::COMPACT_6BITS)) format = Format::COMPACT_6BITS;
+    else if (code == formatToCode(Format::COMPACT_5BITS) || code == formatToCode(Format::COMPACT_5BITS_EXCEPTIONS)) format = Format::COMPACT_5BITS;
+    else if (code == formatToCode(Format::COMPACT_4BITS) || code == formatToCode(Format::COMPACT_4BITS_EXCEPTIONS)) format = Format::COMPACT_4BITS;
+    else return false;
+    return true;
+  }
+
+  // Format of the in-memory synopsis while it is in the HllSparse representation,
+  // never written by serialize()
+  static const uint8_t SPARSE_INTERMEDIATE_CODE = 0x40;
+
+  const uint8_t* synopsisData() const {
+    if (isSparse()) {
+      throw SerializationError("Registers of a sparse synopsis are only available after toDense()");
+    }
+    return reinterpret_cast<const uint8_t*>(header) + sizeof(HLLHdr);
+  }
+
+  HllSparse sparse() const {
+    return HllSparse(hll.getBucketBits(), const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(header)) + sizeof(HLLHdr));
+  }
+
+  void setFormatCode(uint8_t code) {
+    const_cast<HLLHdr*>(header)->format = code;
+  }
+
+  // Header of an empty synopsis of this Hll in the given format
+  void resetHeader(uint8_t code) {
+    HLLHdr *hdr = const_cast<HLLHdr*>(header);
+    *hdr = HLLHdr();
+    hdr->format = code;
+    hdr->bucketBase = 0;
+    hdr->bucketSparseCount = 0;
+    hdr->precision = hll.getBucketBits();
+    hdr->hashSeed = hll.getHashSeed();
+    hdr->length = hll.getDeserializedSynopsisSize();
+  }
+
+  // The RegisterHistogram after the registers, in a buffer that has one
+  RegisterHistogram* histogramTrailer() const {
+    return reinterpret_cast<RegisterHistogram*>(const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(header))
+      + sizeof(HLLHdr) + hll.getDeserializedSynopsisSize());
+  }
+
+  bool isHistogramCurrent() const {
+    return (header->flags & HLL_HEADER_HISTOGRAM_CURRENT) != 0;
+  }
+
+  // Registers changed without the histogram after them, it is recomputed when next needed
+  void invalidateHistogram() {
+    const_cast<HLLHdr*>(header)->flags &= ~HLL_HEADER_HISTOGRAM_CURRENT;
+  }
+
+  // Histogram after the registers from the registers themselves, in one pass over them
+  void refreshHistogram() const {
+    *histogramTrailer() = kernels->histogram(synopsisData());
+    const_cast<HLLHdr*>(header)->flags |= HLL_HEADER_HISTOGRAM_CURRENT;
+  }
+
+  /**
+   * Records in the header that the synopsis holds values hashed with the
+   * given function: the first one sticks, and the values of any other one
+   * can't go in. 0 is the id of the payloads that don't say.
+   */
+  void useHashFunction(uint8_t hashId) {
+    if (hashId == 0 || hashId == header->hashId) {
+      return;
+    }
+    if (header->hashId != 0) {
+      throw SerializationError("Synopsis was built with hash function " + HashFunction::describe(header->hashId)
+        + ", not " + HashFunction::describe(hashId));
+    }
+    const_cast<HLLHdr*>(header)->hashId = hashId;
+  }
+
 public:
   Hll(uint8_t bucketBits, uint8_t* payload, uint32_t hashSeed = MURMURHASH_DEFAULT_SEED) :
     hll(bucketBits, payload + sizeof(HLLHdr), hashSeed),
     header(reinterpret_cast<HLLHdr*>(payload)),
-    linearCounting(bucketBits - 4) {}
+    kernels(&HllKernels<T, H>::forPrecision(bucketBits)),
+    checksum(false),
+    foldScratch(nullptr),
+    foldScratchLength(0) {}
+
+  Hll(const HllKernels<T, H>& kernels, uint8_t* payload, uint32_t hashSeed = MURMURHASH_DEFAULT_SEED) :
+    hll(kernels.precision, payload + sizeof(HLLHdr), hashSeed),
+    header(reinterpret_cast<HLLHdr*>(payload)),
+    kernels(&kernels),
+    checksum(false),
+    foldScratch(nullptr),
+    foldScratchLength(0) {}
 
   static Hll wrapRawBuffer(uint8_t bucketBits, uint8_t* payload, size_t length, uint32_t hashSeed = MURMURHASH_DEFAULT_SEED) {
       return Hll(bucketBits, payload, hashSeed);
   }
 
+  static Hll wrapRawBuffer(const HllKernels<T, H>& kernels, uint8_t* payload, size_t length, uint32_t hashSeed = MURMURHASH_DEFAULT_SEED) {
+      return Hll(kernels, payload, hashSeed);
+  }
+
   void reset() {
     hll.reset();
-    HLLHdr *hdr = const_cast<HLLHdr*>(header);
-    hdr->magic[0] = 'H';
-    hdr->magic[1] = 'L';
-    hdr->bucketBase = 0;
-    hdr->bucketSparseCount = 0;
-    hdr->format = formatToCode(Format::NORMAL);
+    resetHeader(formatToCode(Format::NORMAL));
+  }
+
+  /**
+   * Same as reset(), except that the synopsis starts in the sparse
+   * representation of HllSparse: only its header is written, and values are
+   * kept at a higher precision until they no longer fit in the buffer.
+   * Precisions below HllSparse::MIN_PRECISION always start dense.
+   */
+  void resetSparse() {
+    if (hll.getBucketBits() < HllSparse::MIN_PRECISION) {
+      reset();
+      return;
+    }
+    resetHeader(SPARSE_INTERMEDIATE_CODE);
+    sparse().reset();
+  }
+
+  /**
+   * Keeps a RegisterHistogram of the registers after them in the buffer, which
+   * has to be getMaxDeserializedBufferSize(precision, true) bytes long. The
+   * values added to the dense registers update it as they raise a register,
+   * which gets rare once most registers are set, so that histogram() and the
+   * estimates take a few operations instead of a pass over the registers.
+   * The registers fold() and add() change are counted again the next time
+   * histogram() is needed, once however many payloads went in. A sparse
+   * synopsis is counted from its own list, the histogram starts when its
+   * values no longer fit in it. reset() and resetSparse() stop it, to be
+   * called again after them; serialize() doesn't write it.
+   */
+  void trackHistogram() {
+    const_cast<HLLHdr*>(header)->flags |= HLL_HEADER_HISTOGRAM;
+    if (!isSparse()) {
+      refreshHistogram();
+    }
+  }
+
+  bool tracksHistogram() const {
+    return (header->flags & HLL_HEADER_HISTOGRAM) != 0;
+  }
+
+  /**
+   * Whether serialize() writes the CRC-32C of the payload in the header, for
+   * fold() to check it. Off by default, as it takes another pass over the
+   * payload on both sides.
+   */
+  void setChecksum(bool checksum) {
+    this->checksum = checksum;
+  }
+
+  /**
+   * Buffer fold() and foldMany() unpack the payloads of a higher precision
+   * into before they fold them down, e.g. of getMaxDeserializedBufferSize()
+   * of HLL_ARRAY_SIZE_MAX_VALUE allocated once in setup(). The payloads it is
+   * too short for, or all of them without one, take a buffer of their own.
+   */
+  void setFoldScratch(uint8_t* buffer, size_t length) {
+    foldScratch = buffer;
+    foldScratchLength = length;
+  }
+
+  bool isSparse() const {
+    return header->format == SPARSE_INTERMEDIATE_CODE;
   }
 
+  // Seed of the hashes added to the synopsis, e.g. by addHashes() after hashBatch()
+  uint32_t getHashSeed() const {
+    return hll.getHashSeed();
+  }
+
+  /**
+   * Turns a sparse synopsis into the dense registers, does nothing on a dense
+   * one. A tracked histogram is counted the next time it is needed.
+   */
+  void toDense() {
+    if (isSparse()) {
+      sparse().toDense();
+      setFormatCode(formatToCode(Format::NORMAL));
+    }
+  }
+
+  /**
+   * Folds a synopsis serialized by serialize() into this one. Version 1
+   * payloads, with no hash function, seed or length in their header, are
+   * taken as they are; others have to come from the same hash function as
+   * the values already in this one and the same seed, and match their
+   * checksum if they have one.
+   */
   void fold(const uint8_t* byteArray, size_t length) {
+    HLLHdr hdr;
+    length = readHeader(byteArray, length, hdr);
+    useHashFunction(hdr.hashId);
+    invalidateHistogram();
+    foldPayload(hdr, byteArray + headerSize(hdr), length);
+  }
+
+  /**
+   * Same as fold() of each of the n payloads. The registers of the 8, 6, 5
+   * and 4-bit formats (before the exceptions for the formats that have them)
+   * go to HllKernels::foldMany() FOLD_MANY_BATCH_SIZE payloads at a time,
+   * which reads the synopsis once for all of them instead of once each. The
+   * other formats, whose registers come in no fixed order, go to fold().
+   */
+  void foldMany(const uint8_t* const* byteArrays, const size_t* lengths, size_t n) {
+    const uint8_t* inputs[FOLD_MANY_BATCH_SIZE];
+    Format formats[FOLD_MANY_BATCH_SIZE];
+    uint8_t bases[FOLD_MANY_BATCH_SIZE];
+    size_t batched = 0;
+    invalidateHistogram();
+    for (size_t k = 0; k < n; ++k) {
+      HLLHdr hdr;
+      const size_t length = readHeader(byteArrays[k], lengths[k], hdr);
+      useHashFunction(hdr.hashId);
+      const uint8_t* registers = byteArrays[k] + headerSize(hdr);
+      Format format;
+      if (!registerFormat(hdr.format, format)
+          || !(hdr.precision == 0 || hdr.precision == hll.getBucketBits())
+          || length < HllRaw<T, H>::getMaxSerializedSynopsisSize(format, hll.getBucketBits())) {
+        // foldPayload() also reports the payloads too short for their format
+        foldPayload(hdr, registers, length);
+        continue;
+      }
+      toDense();
+      if (hdr.format == formatToCode(Format::COMPACT_5BITS_EXCEPTIONS)
+          || hdr.format == formatToCode(Format::COMPACT_4BITS_EXCEPTIONS)) {
+        const size_t denseLength = HllRaw<T, H>::getMaxSerializedSynopsisSize(format, hll.getBucketBits());
+        kernels->fold8BitsSparseVarint(hll.getCurrentSynopsis(), registers + denseLength, length - denseLength);
+      }
+      inputs[batched] = registers;
+      formats[batched] = format;
+      bases[batched] = hdr.bucketBase;
+      if (++batched == FOLD_MANY_BATCH_SIZE) {
+        kernels->foldMany(hll.getCurrentSynopsis(), inputs, formats, bases, batched);
+        batched = 0;
+      }
+    }
+    if (batched > 0) {
+      kernels->foldMany(hll.getCurrentSynopsis(), inputs, formats, bases, batched);
+    }
+  }
+
+  void serialize(uint8_t* byteArray, Format format) const {
+    if (format == Format::COMPACT_5BITS || format == Format::COMPACT_4BITS
+        || format == Format::COMPACT_5BITS_EXCEPTIONS || format == Format::COMPACT_4BITS_EXCEPTIONS
+        || format == Format::ENTROPY) {
+      serialize(byteArray, format, histogram());
+    } else {
+      serializeWithBase(byteArray, format, 0);
+    }
+  }
+
+  /**
+   * Same as above with the histogram of the registers already at hand, which
+   * gives the base of the 5 and 4-bit formats and the code of the entropy
+   * coded one without reading them again.
+   */
+  void serialize(uint8_t* byteArray, Format format, const RegisterHistogram& histogram) const {
+    if (format == Format::ENTROPY) {
+      serializeWithBase(byteArray, format, RegisterEntropyCode::bestCenter(histogram));
+    } else {
+      serializeWithBase(byteArray, format, histogram.minValue());
+    }
+  }
+
+private:
+  static size_t headerSize(const HLLHdr& hdr) {
+    return hdr.version == 0 ? HLL_HEADER_V1_SIZE : sizeof(HLLHdr);
+  }
+
+  /**
+   * Reads the header of a payload into hdr, the fields a version 1 header
+   * doesn't have left at their defaults, and returns the length of the
+   * payload after it: the one in the header, which may be less than what is
+   * left of the buffer, or for version 1 all of it.
+   */
+  size_t readHeader(const uint8_t* byteArray, size_t length, HLLHdr& hdr) const {
+    if (length < HLL_HEADER_V1_SIZE) {
+      throw SerializationError("payload is not big enough to contain header");
+    }
+    const uint8_t version = byteArray[offsetof(HLLHdr, version)];
+    if (version == 0) {
+      memcpy(reinterpret_cast<uint8_t*>(&hdr), byteArray, HLL_HEADER_V1_SIZE);
+      return length - HLL_HEADER_V1_SIZE;
+    }
+    if (version != HLL_HEADER_VERSION) {
+      throw SerializationError("Unknown header version " + std::to_string(version));
+    }
     if (length < sizeof(HLLHdr)) {
       throw SerializationError("payload is not big enough to contain header");
     }
-    length -= sizeof(HLLHdr);
-    HLLHdr hdr = *(reinterpret_cast<const HLLHdr*>(byteArray));
-    const uint8_t* byteArrayHll = byteArray + sizeof(HLLHdr);
+    memcpy(reinterpret_cast<uint8_t*>(&hdr), byteArray, sizeof(HLLHdr));
+    if (hdr.length > length - sizeof(HLLHdr)) {
+      throw SerializationError("payload is shorter than the length in its header");
+    }
+    if (hdr.hashSeed != hll.getHashSeed()) {
+      throw SerializationError("Synopsis was built with hash seed " + std::to_string(hdr.hashSeed)
+        + ", not " + std::to_string(hll.getHashSeed()));
+    }
+    if ((hdr.flags & HLL_HEADER_CHECKSUM) && Crc32c::of(byteArray + sizeof(HLLHdr), hdr.length) != hdr.checksum) {
+      throw SerializationError("Synopsis doesn't match its checksum");
+    }
+    return hdr.length;
+  }
+
+  // fold() of the payload after a header readHeader() read and checked
+  void foldPayload(const HLLHdr& hdr, const uint8_t* byteArrayHll, size_t length) {
+    uint8_t* synopsis = hll.getCurrentSynopsis();
+
+    if (hdr.precision != 0 && hdr.precision != hll.getBucketBits()) {
+      foldHigherPrecision(hdr, byteArrayHll, length);
+      return;
+    }
+
+    if (hdr.format == SPARSE_INTERMEDIATE_CODE) {
+      foldSparse(byteArrayHll, length);
+      return;
+    }
+    toDense();
 
     if(hdr.format == formatToCode(Format::SPARSE)) {
-      hll.fold8BitsSparse(byteArrayHll, hdr.bucketSparseCount, length);
+      kernels->fold8BitsSparse(synopsis, byteArrayHll, hdr.bucketSparseCount, length);
+    } else if(hdr.format == formatToCode(Format::SPARSE_VARINT)) {
+      kernels->fold8BitsSparseVarint(synopsis, byteArrayHll, length);
     } else if(hdr.format == formatToCode(Format::NORMAL)) {
-      hll.fold8Bits(byteArrayHll, length);
+      kernels->fold8Bits(synopsis, byteArrayHll, length);
     } else if (hdr.format == formatToCode(Format::COMPACT_6BITS)) {
-      hll.fold6Bits(byteArrayHll, length);
+      kernels->fold6Bits(synopsis, byteArrayHll, length);
     } else if (hdr.format == formatToCode(Format::COMPACT_5BITS)) {
-      hll.fold5BitsWithBase(byteArrayHll, hdr.bucketBase, length);
+      kernels->fold5BitsWithBase(synopsis, byteArrayHll, hdr.bucketBase, length);
     } else if (hdr.format == formatToCode(Format::COMPACT_4BITS)) {
-      hll.fold4BitsWithBase(byteArrayHll, hdr.bucketBase, length);
+      kernels->fold4BitsWithBase(synopsis, byteArrayHll, hdr.bucketBase, length);
+    } else if (hdr.format == formatToCode(Format::ENTROPY)) {
+      kernels->foldEntropy(synopsis, byteArrayHll, hdr.bucketBase, length);
+    } else if (hdr.format == formatToCode(Format::COMPACT_5BITS_EXCEPTIONS)
+        || hdr.format == formatToCode(Format::COMPACT_4BITS_EXCEPTIONS)) {
+      foldWithExceptions(hdr.format == formatToCode(Format::COMPACT_5BITS_EXCEPTIONS)
+        ? Format::COMPACT_5BITS_EXCEPTIONS : Format::COMPACT_4BITS_EXCEPTIONS, byteArrayHll, hdr.bucketBase, length);
     } else {
       throw SerializationError("Unknown format parameter in fold().");
     }
   }
 
-  void serialize(uint8_t* byteArray, Format format) const {
+  /**
+   * foldPayload() of a payload of a higher precision. The registers of the
+   * 8-bit format are folded down as they are; the other formats are folded
+   * into registers of their own precision first, in the buffer of
+   * setFoldScratch() when it is big enough, then down into these.
+   */
+  void foldHigherPrecision(const HLLHdr& hdr, const uint8_t* byteArrayHll, size_t length) {
+    if (hdr.precision < hll.getBucketBits()) {
+      throw SerializationError("Synopsis of precision " + std::to_string(hdr.precision)
+        + " can only be folded into one of the same or a lower precision, not " + std::to_string(hll.getBucketBits()));
+    }
+    toDense();
+    if (hdr.format == formatToCode(Format::NORMAL)) {
+      if (length < HllRaw<T, H>::getDeserializedSynopsisSize(hdr.precision)) {
+        throw SerializationError("Payload is not big enough for all advertised buckets");
+      }
+      kernels->foldDown(hll.getCurrentSynopsis(), byteArrayHll, hdr.precision);
+      return;
+    }
+    const HllKernels<T, H>& higherKernels = HllKernels<T, H>::forPrecision(hdr.precision);
+    SizedBuffer ownBuffer;
+    uint8_t* buffer = foldScratch;
+    if (foldScratchLength < getMaxDeserializedBufferSize(hdr.precision)) {
+      ownBuffer = makeDeserializedBuffer(hdr.precision);
+      buffer = ownBuffer.first.get();
+    }
+    Hll higher(higherKernels, buffer, hll.getHashSeed());
+    higher.reset();
+    higher.foldPayload(hdr, byteArrayHll, length);
+    higher.toDense();
+    kernels->foldDown(hll.getCurrentSynopsis(), higher.synopsisData(), hdr.precision);
+  }
+
+  /**
+   * The clamped registers of the dense part come out as base + 15 (or 31) and
+   * the exceptions, all above that, then put back their exact value.
+   */
+  void foldWithExceptions(Format format, const uint8_t* byteArray, uint8_t base, size_t length) {
+    uint8_t* synopsis = hll.getCurrentSynopsis();
+    const size_t denseLength = HllRaw<T, H>::getMaxSerializedSynopsisSize(HllRaw<T, H>::denseFormat(format), hll.getBucketBits());
+    if (length < denseLength) {
+      throw SerializationError("Payload is not big enough for all advertised buckets");
+    }
+    if (format == Format::COMPACT_5BITS_EXCEPTIONS) {
+      kernels->fold5BitsWithBase(synopsis, byteArray, base, denseLength);
+    } else {
+      kernels->fold4BitsWithBase(synopsis, byteArray, base, denseLength);
+    }
+    kernels->fold8BitsSparseVarint(synopsis, byteArray + denseLength, length - denseLength);
+  }
+
+  // fold() of the in-memory sparse synopsis of another Hll of the same precision
+  void foldSparse(const uint8_t* byteArray, size_t length) {
+    const HllSparse other(hll.getBucketBits(), const_cast<uint8_t*>(byteArray));
+    other.validate(length);
+    if (isSparse()) {
+      HllSparse self = sparse();
+      bool fits = true;
+      other.forEachEntry([&self, &fits](uint32_t entry) {
+        fits = fits && self.add(entry);
+      });
+      if (fits) {
+        return;
+      }
+      toDense();
+    }
+    other.foldTo(hll.getCurrentSynopsis());
+  }
+
+  void serializeWithBase(uint8_t* byteArray, Format format, uint8_t base) const {
     // for the time being we skip the header and serialize it once
     // the buckets are written down
     HLLHdr hdr;
 
     uint8_t* byteArrayHll = byteArray + sizeof(HLLHdr);
-    uint8_t base = 0;
+    const uint8_t* synopsis = synopsisData();
     uint16_t bucketSparseCount = 0;
+    // bytes written after the header, the same as for the dense formats unless said otherwise
+    uint64_t length = HllRaw<T, H>::getMaxSerializedSynopsisSize(format, hll.getBucketBits());
 
     if (format == Format::SPARSE) {
-      bucketSparseCount = hll.serialize8BitsSparse(byteArrayHll);
+      if (hll.getBucketBits() > 16) {
+        throw SerializationError("Sparse format only holds bucket ids up to precision 16, use SPARSE_VARINT");
+      }
+      bucketSparseCount = kernels->serialize8BitsSparse(synopsis, byteArrayHll);
+      length = 3 * bucketSparseCount;
+    } else if (format == Format::SPARSE_VARINT) {
+      length = kernels->serialize8BitsSparseVarint(synopsis, byteArrayHll, 0);
+    } else if (format == Format::ENTROPY) {
+      length = kernels->serializeEntropy(synopsis, byteArrayHll, base);
+    } else if (format == Format::COMPACT_5BITS_EXCEPTIONS) {
+      kernels->serialize5BitsWithBase(synopsis, byteArrayHll, base);
+      length = HllRaw<T, H>::getMaxSerializedSynopsisSize(Format::COMPACT_5BITS, hll.getBucketBits());
+      length += kernels->serialize8BitsSparseVarint(synopsis, byteArrayHll + length, HllRaw<T, H>::exceptionThreshold(format, base));
+    } else if (format == Format::COMPACT_4BITS_EXCEPTIONS) {
+      kernels->serialize4BitsWithBase(synopsis, byteArrayHll, base);
+      length = HllRaw<T, H>::getMaxSerializedSynopsisSize(Format::COMPACT_4BITS, hll.getBucketBits());
+      length += kernels->serialize8BitsSparseVarint(synopsis, byteArrayHll + length, HllRaw<T, H>::exceptionThreshold(format, base));
     } else if(format == Format::NORMAL) {
-      hll.serialize8Bits(byteArrayHll);
+      kernels->serialize8Bits(synopsis, byteArrayHll);
     } else if (format == Format::COMPACT_6BITS) {
-      hll.serialize6Bits(byteArrayHll);
+      kernels->serialize6Bits(synopsis, byteArrayHll);
     } else if (format == Format::COMPACT_5BITS) {
-      base = hll.serialize5BitsWithBase(byteArrayHll);
+      kernels->serialize5BitsWithBase(synopsis, byteArrayHll, base);
     } else if (format == Format::COMPACT_4BITS) {
-      base = hll.serialize4BitsWithBase(byteArrayHll);
+      kernels->serialize4BitsWithBase(synopsis, byteArrayHll, base);
     } else {
       throw SerializationError("Unknown format parameter in serialize().");
     }
     // serialize the header as well
     hdr.bucketSparseCount = bucketSparseCount;
-    hdr.bucketBase = base;
+    hdr.precision = hll.getBucketBits();
+    hdr.bucketBase = (format == Format::COMPACT_5BITS || format == Format::COMPACT_4BITS
+      || format == Format::COMPACT_5BITS_EXCEPTIONS || format == Format::COMPACT_4BITS_EXCEPTIONS
+      || format == Format::ENTROPY) ? base : 0;
     hdr.format = formatToCode(format);
+    hdr.hashSeed = hll.getHashSeed();
+    hdr.length = length;
+    hdr.hashId = header->hashId;
+    if (checksum) {
+      hdr.flags |= HLL_HEADER_CHECKSUM;
+      hdr.checksum = Crc32c::of(byteArrayHll, length);
+    }
     *reinterpret_cast<HLLHdr*>(byteArray) = hdr;
   }
 
+public:
+
+  // Registers of other, of the same or a higher precision, folded into these
   void add(const Hll& other) {
-    this->hll.add(other.hll);
+    if (other.hll.getBucketBits() < hll.getBucketBits()) {
+      throw SerializationError("A synopsis can only be folded into one of the same or a lower precision");
+    }
+    useHashFunction(other.header->hashId);
+    invalidateHistogram();
+    if (other.hll.getBucketBits() > hll.getBucketBits()) {
+      if (other.isSparse()) {
+        // resetSparse() recorded its precision
+        fold(reinterpret_cast<const uint8_t*>(other.header), sizeof(HLLHdr) + other.hll.getDeserializedSynopsisSize());
+      } else {
+        toDense();
+        kernels->foldDown(hll.getCurrentSynopsis(), other.synopsisData(), other.hll.getBucketBits());
+      }
+      return;
+    }
+    if (other.isSparse()) {
+      foldSparse(reinterpret_cast<const uint8_t*>(other.header) + sizeof(HLLHdr), other.hll.getDeserializedSynopsisSize());
+    } else {
+      toDense();
+      this->hll.add(other.hll);
+    }
   }
 
   void add(T value) {
-    hll.add(value);
+    useHashFunction(H::ID);
+    if (isSparse() || isHistogramCurrent()) {
+      addBatch(&value, 1);
+    } else {
+      hll.add(value);
+    }
+  }
+
+  void addBatch(const T* values, size_t n) {
+    useHashFunction(H::ID);
+    size_t offset = 0;
+    if (isSparse()) {
+      offset = addBatchSparse(values, n);
+      startHistogramAfterSparse();
+    }
+    if (isHistogramCurrent()) {
+      H hashFunction;
+      uint64_t hashes[HllSparse::HASH_CHUNK_SIZE];
+      for (; offset < n; offset += HllSparse::HASH_CHUNK_SIZE) {
+        const size_t chunk = std::min<size_t>(n - offset, HllSparse::HASH_CHUNK_SIZE);
+        hashFunction.hashBatch(values + offset, chunk, hashes, hll.getHashSeed());
+        hll.addHashes(hashes, chunk, *histogramTrailer());
+      }
+      return;
+    }
+    kernels->addBatch(hll.getCurrentSynopsis(), values + offset, n - offset, hll.getHashSeed());
+  }
+
+  /**
+   * Adds n values already hashed with the hash function of the given id (see
+   * HashFunction) and this Hll's seed, in place of H.
+   */
+  void addHashes(const uint64_t* hashes, size_t n, uint8_t hashId) {
+    useHashFunction(hashId);
+    size_t offset = 0;
+    if (isSparse()) {
+      offset = addHashesSparse(hashes, n);
+      startHistogramAfterSparse();
+    }
+    if (isHistogramCurrent()) {
+      hll.addHashes(hashes + offset, n - offset, *histogramTrailer());
+      return;
+    }
+    kernels->addHashes(hll.getCurrentSynopsis(), hashes + offset, n - offset);
   }
 
+private:
+  // Counts the tracked histogram once added values turned the sparse synopsis dense
+  void startHistogramAfterSparse() {
+    if (!isSparse() && tracksHistogram()) {
+      refreshHistogram();
+    }
+  }
+
+  // Adds values to the sparse synopsis until it has to become dense, returns the number added
+  size_t addBatchSparse(const T* values, size_t n) {
+    H hashFunction;
+    uint64_t hashes[HllSparse::HASH_CHUNK_SIZE];
+    for (size_t offset = 0; offset < n; offset += HllSparse::HASH_CHUNK_SIZE) {
+      const size_t chunk = std::min<size_t>(n - offset, HllSparse::HASH_CHUNK_SIZE);
+      hashFunction.hashBatch(values + offset, chunk, hashes, hll.getHashSeed());
+      const size_t added = addHashesSparse(hashes, chunk);
+      if (added < chunk) {
+        return offset + added;
+      }
+    }
+    return n;
+  }
+
+  // Same as addBatchSparse() of hashes
+  size_t addHashesSparse(const uint64_t* hashes, size_t n) {
+    HllSparse sparse = this->sparse();
+    for (size_t i = 0; i < n; ++i) {
+      if (!sparse.add(HllSparse::entry(hashes[i]))) {
+        toDense();
+        return i;
+      }
+    }
+    return n;
+  }
+
+public:
+
   void printBuckets() const {
     hll.printBuckets();
   }
@@ -123,16 +671,44 @@ public:
     return this->hll.getSerializedSynopsisSize(format) + sizeof(HLLHdr);
   }
 
+  uint64_t getSerializedBufferSize(Format format, const RegisterHistogram& histogram) const {
+    if (format == Format::SPARSE) {
+      return histogram.setRegisters() * 3 + sizeof(HLLHdr);
+    } else if (format == Format::SPARSE_VARINT) {
+      // the gaps depend on where the set registers are, not only on how many there are
+      return histogram.setRegisters() == 0 ? sizeof(uint32_t) + sizeof(HLLHdr)
+        : kernels->sparseVarintSize(synopsisData(), 0) + sizeof(HLLHdr);
+    } else if (format == Format::ENTROPY) {
+      return RegisterEntropyCode::forCenter(RegisterEntropyCode::bestCenter(histogram)).encodedBytes(histogram) + sizeof(HLLHdr);
+    } else if (format == Format::COMPACT_5BITS_EXCEPTIONS || format == Format::COMPACT_4BITS_EXCEPTIONS) {
+      const uint8_t threshold = HllRaw<T, H>::exceptionThreshold(format, histogram.minValue());
+      const uint64_t denseSize = getMaxSerializedBufferSize(HllRaw<T, H>::denseFormat(format), hll.getBucketBits());
+      return histogram.registersAbove(threshold) == 0 ? denseSize + sizeof(uint32_t)
+        : denseSize + kernels->sparseVarintSize(synopsisData(), threshold);
+    }
+    return getMaxSerializedBufferSize(format, hll.getBucketBits());
+  }
+
   static uint64_t getMaxDeserializedBufferSize(uint8_t precision) {
       return HllRaw<T,H>::getDeserializedSynopsisSize(precision) + sizeof(HLLHdr);
   }
 
+  // Same as above, with room for the histogram of trackHistogram() if withHistogram
+  static uint64_t getMaxDeserializedBufferSize(uint8_t precision, bool withHistogram) {
+      return getMaxDeserializedBufferSize(precision) + (withHistogram ? sizeof(RegisterHistogram) : 0);
+  }
+
   static uint64_t getMaxSerializedBufferSize(Format format, uint8_t precision) {
     return HllRaw<T,H>::getMaxSerializedSynopsisSize(format, precision) + sizeof(HLLHdr);
   }
 
   static SizedBuffer makeDeserializedBuffer(uint8_t precision) {
-    uint64_t length = getMaxDeserializedBufferSize(precision);
+    return makeDeserializedBuffer(precision, false);
+  }
+
+  // Same as above, with room for the histogram of trackHistogram() if withHistogram
+  static SizedBuffer makeDeserializedBuffer(uint8_t precision, bool withHistogram) {
+    uint64_t length = getMaxDeserializedBufferSize(precision, withHistogram);
     uint8_t *buffer = new uint8_t[length];
     memset(buffer, 0, length);
     return std::make_pair(std::unique_ptr<uint8_t[]>(buffer), length);
@@ -145,8 +721,206 @@ public:
     return std::make_pair(std::unique_ptr<uint8_t[]>(buffer), length);
   }
 
-  bool isBetterSerializedSparse() const {
-    return this->hll.getNumberOfSetBuckets() < 256;
+  /**
+   * Whether SPARSE_VARINT takes fewer bytes than the given dense format. Each
+   * set register takes at least 2 bytes in it, so the registers are only read
+   * for the exact size when that isn't already enough to rule it out.
+   */
+  bool isBetterSerializedSparse(Format denseFormat) const {
+    return isBetterSerializedSparse(denseFormat, histogram());
+  }
+
+  bool isBetterSerializedSparse(Format denseFormat, const RegisterHistogram& histogram) const {
+    const uint64_t denseSize = getSerializedBufferSize(denseFormat, histogram);
+    if (sizeof(HLLHdr) + sizeof(uint32_t) + 2 * histogram.setRegisters() >= denseSize) {
+      return false;
+    }
+    return getSerializedBufferSize(Format::SPARSE_VARINT, histogram) < denseSize;
+  }
+
+  /**
+   * Format to serialize the synopsis in when the given one is asked for:
+   * SPARSE_VARINT when it is smaller, and for AUTO the smallest format that
+   * keeps every register as it is. 4 bits hold the registers when they span
+   * less than 16 values above the base, 6 bits always do, and either is
+   * weighed against 5 bits (with exceptions if the registers span 32 values
+   * or more) and 4 bits with exceptions. The histogram gives the number of
+   * exceptions, and the registers are only read for the exact size of the
+   * latter when 2 bytes each don't already rule the format out. The entropy
+   * coded format is left out: it is a fifth smaller than 4 bits with
+   * exceptions but decodes a register at a time, which every later fold of
+   * the synopsis would pay for, so it is only written when asked for.
+   */
+  Format serializationFormat(Format requested, const RegisterHistogram& histogram) const {
+    Format denseFormat = requested;
+    if (requested == Format::AUTO) {
+      const uint8_t spread = histogram.maxValue() - histogram.minValue();
+      denseFormat = spread < 16 ? Format::COMPACT_4BITS : Format::COMPACT_6BITS;
+      uint64_t denseSize = getSerializedBufferSize(denseFormat, histogram);
+      const Format candidates[] = {
+        spread < 32 ? Format::COMPACT_5BITS : Format::COMPACT_5BITS_EXCEPTIONS,
+        Format::COMPACT_4BITS_EXCEPTIONS
+      };
+      for (Format candidate: candidates) {
+        if (minSerializedBufferSize(candidate, histogram) < denseSize) {
+          const uint64_t size = getSerializedBufferSize(candidate, histogram);
+          if (size < denseSize) {
+            denseFormat = candidate;
+            denseSize = size;
+          }
+        }
+      }
+    }
+    return isBetterSerializedSparse(denseFormat, histogram) ? Format::SPARSE_VARINT : denseFormat;
+  }
+
+private:
+  // Lower bound of getSerializedBufferSize() that doesn't read the registers
+  uint64_t minSerializedBufferSize(Format format, const RegisterHistogram& histogram) const {
+    if (format == Format::COMPACT_5BITS_EXCEPTIONS || format == Format::COMPACT_4BITS_EXCEPTIONS) {
+      const uint8_t threshold = HllRaw<T, H>::exceptionThreshold(format, histogram.minValue());
+      return getMaxSerializedBufferSize(HllRaw<T, H>::denseFormat(format), hll.getBucketBits())
+        + sizeof(uint32_t) + 2 * histogram.registersAbove(threshold);
+    }
+    return getSerializedBufferSize(format, histogram);
+  }
+
+  // histogramOf() of a SPARSE payload: the registers it doesn't list are 0
+  RegisterHistogram sparseHistogram(const uint8_t* byteArray, uint16_t setBuckets, size_t length) const {
+    const uint32_t numberOfRegisters = hll.getNumberOfBuckets();
+    if (length < setBuckets * 3u || setBuckets > numberOfRegisters) {
+      throw SerializationError("Payload is not big enough for all advertised buckets");
+    }
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    histogram.counts[0] = numberOfRegisters - setBuckets;
+    for (uint32_t i = 0; i < setBuckets; ++i) {
+      uint16_t id;
+      memcpy(&id, byteArray + 3 * i, sizeof(id));
+      if (id >= numberOfRegisters) {
+        throw SerializationError("Bucket id is not valid when decoding sparse");
+      }
+      ++histogram.counts[RegisterHistogram::bin(byteArray[3 * i + 2])];
+    }
+    return histogram;
+  }
+
+  /**
+   * Moves each register a SPARSE_VARINT list holds from the value it is
+   * counted at in histogram to its own. The ids have to go up, as
+   * serialize() writes them, so that no register moves twice.
+   */
+  void moveListedRegisters(RegisterHistogram& histogram, uint8_t from, const uint8_t* byteArray, size_t length) const {
+    uint32_t setBuckets;
+    if (length < sizeof(setBuckets)) {
+      throw SerializationError("Payload is not big enough for the number of buckets");
+    }
+    memcpy(&setBuckets, byteArray, sizeof(setBuckets));
+    const uint8_t* in = byteArray + sizeof(setBuckets);
+    const uint8_t* end = byteArray + length;
+    if (setBuckets > (length - sizeof(setBuckets)) / 2) {
+      throw SerializationError("Payload is not big enough for all advertised buckets");
+    }
+
+    uint64_t id = 0;
+    for (uint32_t i = 0; i < setBuckets; ++i) {
+      uint32_t gap;
+      if (!read_varint(in, end, gap) || in == end) {
+        throw SerializationError("Payload is not big enough for all advertised buckets");
+      }
+      id += gap;
+      if ((i > 0 && gap == 0) || id >= hll.getNumberOfBuckets() || histogram.counts[from] == 0) {
+        throw SerializationError("Bucket id is not valid when decoding sparse");
+      }
+      --histogram.counts[from];
+      ++histogram.counts[RegisterHistogram::bin(*in++)];
+    }
+  }
+
+public:
+
+  /**
+   * Counts of registers per value, in one pass over the synopsis. Callers that
+   * need several of the estimates, the sparse decision and the serialization
+   * below should compute it once and pass it to each of them.
+   */
+  RegisterHistogram histogram() const {
+    if (isSparse()) {
+      return sparse().histogram();
+    }
+    if (tracksHistogram()) {
+      if (!isHistogramCurrent()) {
+        refreshHistogram();
+      }
+      return *histogramTrailer();
+    }
+    return kernels->histogram(synopsisData());
+  }
+
+  /**
+   * Precision of the synopsis in a payload serialize() wrote, for the Hll
+   * that reads it with histogramOf(), or the given one if the header doesn't
+   * record it.
+   */
+  static uint8_t precisionOf(const uint8_t* byteArray, size_t length, uint8_t defaultPrecision) {
+    if (length < HLL_HEADER_V1_SIZE) {
+      throw SerializationError("payload is not big enough to contain header");
+    }
+    const uint8_t precision = byteArray[offsetof(HLLHdr, precision)];
+    return precision != 0 ? precision : defaultPrecision;
+  }
+
+  /**
+   * histogram() of the synopsis in a payload serialize() wrote, read from the
+   * payload instead of folded into registers first: the 8-bit registers are
+   * counted where they are, the 6 and 5-bit ones a block at a time and the
+   * 4-bit ones where they are packed, and the registers the sparse formats
+   * and the exceptions list are moved from the value they were counted at to
+   * their own. Only the entropy coded format and the payloads of another
+   * precision go through fold(), into the registers of this Hll, which are
+   * reset first.
+   */
+  RegisterHistogram histogramOf(const uint8_t* byteArray, size_t length) {
+    HLLHdr hdr;
+    length = readHeader(byteArray, length, hdr);
+    const uint8_t* payload = byteArray + headerSize(hdr);
+    const uint32_t numberOfRegisters = hll.getNumberOfBuckets();
+    const bool samePrecision = hdr.precision == 0 || hdr.precision == hll.getBucketBits();
+    Format format;
+    if (samePrecision && registerFormat(hdr.format, format)) {
+      const size_t denseLength = HllRaw<T, H>::getMaxSerializedSynopsisSize(format, hll.getBucketBits());
+      if (length < denseLength) {
+        throw SerializationError("Payload is not big enough for all advertised buckets");
+      }
+      RegisterHistogram histogram;
+      if (format == Format::NORMAL) {
+        histogram = kernels->histogram(payload);
+      } else if (format == Format::COMPACT_6BITS) {
+        histogram = kernels->histogram6Bits(payload);
+      } else if (format == Format::COMPACT_5BITS) {
+        histogram = kernels->histogram5BitsWithBase(payload, hdr.bucketBase);
+      } else {
+        histogram = RegisterHistogram::of4BitsWithBase(payload, hdr.bucketBase, numberOfRegisters);
+      }
+      if (hdr.format == formatToCode(Format::COMPACT_5BITS_EXCEPTIONS)
+          || hdr.format == formatToCode(Format::COMPACT_4BITS_EXCEPTIONS)) {
+        // the dense part holds the exceptions at the largest register it can
+        const uint8_t clamped = RegisterHistogram::binAbove(hdr.bucketBase, format == Format::COMPACT_5BITS ? 31 : 15);
+        moveListedRegisters(histogram, clamped, payload + denseLength, length - denseLength);
+      }
+      return histogram;
+    } else if (samePrecision && hdr.format == formatToCode(Format::SPARSE)) {
+      return sparseHistogram(payload, hdr.bucketSparseCount, length);
+    } else if (samePrecision && hdr.format == formatToCode(Format::SPARSE_VARINT)) {
+      RegisterHistogram histogram;
+      histogram.reset(numberOfRegisters);
+      histogram.counts[0] = numberOfRegisters;
+      moveListedRegisters(histogram, 0, payload, length);
+      return histogram;
+    }
+    reset();
+    foldPayload(hdr, payload, length);
+    return histogram();
   }
 
   /**
@@ -154,20 +928,53 @@ public:
    */
 
   uint64_t approximateCountDistinct_beta() const {
-    return this->hll.betaEstimate();
+    if (isSparse() || tracksHistogram()) {
+      return hll.betaEstimate(histogram());
+    }
+    return kernels->betaEstimate(synopsisData());
+  }
+
+  uint64_t approximateCountDistinct_beta(const RegisterHistogram& histogram) const {
+    return hll.betaEstimate(histogram);
+  }
+
+  /**
+   * get cardinality estimation using Ertl's improved raw estimator, which
+   * only needs the register histogram
+   */
+  uint64_t approximateCountDistinct_improved() const {
+    return approximateCountDistinct_improved(histogram());
+  }
+
+  uint64_t approximateCountDistinct_improved(const RegisterHistogram& histogram) const {
+    return hll.improvedEstimate(histogram);
   }
 
 /**
  * Hll's error becomes significant for small cardinalities. For instance, when
  * the cardinality is 0, HLL(p=14) estimates it to ~11k.
- * To circumvent
+ * To circumvent that, as in Google's HyperLogLog++, raw estimates up to 5
+ * times the number of buckets are bias corrected, and the linear counting
+ * estimate of the empty registers is returned instead when it is below the
+ * threshold of the precision.
+ *
+ * A sparse synopsis holds few enough values for HllSparse to count them at
+ * its own precision, which beats all of the below. That only holds while it
+ * is in memory: serialize() writes the registers of toDense().
  */
   uint64_t approximateCountDistinct() const {
-    uint64_t e = this->hll.estimate();
+    if (isSparse()) {
+      return sparse().estimate();
+    }
+    return approximateCountDistinct(histogram());
+  }
+
+  uint64_t approximateCountDistinct(const RegisterHistogram& histogram) const {
+    uint64_t e = hll.estimate(histogram);
     uint64_t ee;
     // Google's paper suggests to set the threshold to this value
     uint64_t biasCorrectedThreshold = hll.getNumberOfBuckets()*5;
-    uint64_t lcThreshold = linearCounting.getLinearCountingThreshold(this->hll.getBucketBits());
+    uint64_t lcThreshold = LinearCounting::getLinearCountingThreshold(this->hll.getBucketBits());
 
     if(e <= biasCorrectedThreshold) {
       ee = BiasCorrectedEstimate::estimate(e, hll.getBucketBits());
@@ -176,8 +983,9 @@ public:
     }
 
     uint64_t h;
-    if(this->hll.emptyBucketsCount() != 0) {
-      double v = static_cast<double>(hll.getNumberOfBuckets())/static_cast<double>(hll.emptyBucketsCount());
+    uint32_t emptyBuckets = histogram.emptyRegisters();
+    if(emptyBuckets != 0) {
+      double v = static_cast<double>(hll.getNumberOfBuckets())/static_cast<double>(emptyBuckets);
       h = hll.getNumberOfBuckets() * log(v);
     } else {
       h = ee;
@@ -190,6 +998,36 @@ public:
     }
   }
 
+  /**
+   * Cardinalities of the values only this synopsis holds, of those only other
+   * holds and of those both hold, with JointEstimate. Both synopses have the
+   * same precision and are dense, the registers of both are read once.
+   */
+  JointCardinality jointEstimate(const Hll& other) const {
+    if (other.hll.getBucketBits() != hll.getBucketBits()) {
+      throw SerializationError("Joint estimate of synopses of precisions " + std::to_string(hll.getBucketBits())
+        + " and " + std::to_string(other.hll.getBucketBits()) + ", fold them to the lower one first");
+    }
+    if (header->hashId != 0 && other.header->hashId != 0 && header->hashId != other.header->hashId) {
+      throw SerializationError("Synopses were built with hash functions " + HashFunction::describe(header->hashId)
+        + " and " + HashFunction::describe(other.header->hashId));
+    }
+    const JointRegisterHistogram joint = kernels->jointHistogram(synopsisData(), other.synopsisData());
+    // inclusion-exclusion of the usual estimates is where the likelihood is maximized from
+    const double first = approximateCountDistinct(joint.firstHistogram());
+    const double second = approximateCountDistinct(joint.secondHistogram());
+    const double both = approximateCountDistinct(joint.unionHistogram());
+    return JointEstimate::estimate(joint, hll.getBucketBits(), both - second, both - first, first + second - both);
+  }
+
 };
 
+/**
+ * Hll neither owns the buffer it wraps nor allocates anything on construction,
+ * so wrapping Vertica's intermediate aggregates for every block is just a couple
+ * of pointer stores. The UDAFs use it through this name to make it explicit.
+ */
+template<typename T, typename H = MurMurHash<T> >
+using HllView = Hll<T, H>;
+
 #endif
@@ -0,0 +1,142 @@
+#ifndef _HLL_DISTINCT_COUNT_HPP_
+#define _HLL_DISTINCT_COUNT_HPP_
+
+#include "hll_vertica.hpp"
+
+/**
+ * The aggregate functions folding the synopses of a VARBINARY column into one
+ * and returning its number of distinct values, as estimated by Estimate, e.g.
+ * &HllView<uint64_t>::approximateCountDistinct. HllDistinctCount and the
+ * functions of the other estimators only differ by it.
+ */
+template<uint64_t (HllView<uint64_t>::*Estimate)() const>
+class DistinctCount : public AggregateFunction
+{
+
+  vint hllLeadingBits;
+  const HllKernels<uint64_t> *kernels;
+  uint8_t* foldScratch;
+
+  HllView<uint64_t> wrap(IntermediateAggs &aggs) const {
+    return HllView<uint64_t>::wrapRawBuffer(
+      *kernels,
+      reinterpret_cast<uint8_t *>(aggs.getStringRef(0).data()),
+      aggs.getTypeMetaData().getColumnType(0).getStringLength()
+    );
+  }
+
+public:
+
+  virtual void setup(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
+    this -> hllLeadingBits = readSubStreamBits(srvInterface);
+    this -> kernels = &selectKernels(hllLeadingBits);
+    this -> foldScratch = vt_allocArray(srvInterface.allocator, uint8_t,
+      HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
+  }
+
+  virtual void initAggregate(ServerInterface &srvInterface, IntermediateAggs &aggs)
+  {
+    try
+    {
+      size_t maxSize = HllView<uint64_t>::getMaxDeserializedBufferSize(hllLeadingBits);
+      aggs.getStringRef(0).alloc(maxSize);
+      wrap(aggs).reset();
+    } catch (std::exception &e)
+    {
+      vt_report_error(0, "Exception while initializing intermediate aggregates: [%s]", e.what());
+    }
+
+  }
+
+  void aggregate(ServerInterface &srvInterface,
+                 BlockReader &argReader,
+                 IntermediateAggs &aggs)
+  {
+    try {
+      HllView<uint64_t> hll = wrap(aggs);
+      foldAll(hll, argReader, foldScratch);
+    } catch(SerializationError& e) {
+      vt_report_error(0, e.what());
+    }
+
+  }
+
+  virtual void combine(ServerInterface &srvInterface,
+                       IntermediateAggs &aggs,
+                       MultipleIntermediateAggs &aggsOther)
+  {
+    try {
+      HllView<uint64_t> hll = wrap(aggs);
+      foldAll(hll, aggsOther, foldScratch);
+    } catch(SerializationError& e) {
+      vt_report_error(0, e.what());
+    }
+  }
+
+  virtual void terminate(ServerInterface &srvInterface,
+                         BlockWriter &resWriter,
+                         IntermediateAggs &aggs)
+  {
+    try {
+      HllView<uint64_t> hll = wrap(aggs);
+      resWriter.setInt((hll.*Estimate)());
+    } catch(SerializationError& e) {
+      vt_report_error(0, e.what());
+    }
+
+  }
+
+  InlineAggregate()
+};
+
+
+template<uint64_t (HllView<uint64_t>::*Estimate)() const>
+class DistinctCountFactory : public AggregateFunctionFactory
+{
+  virtual void getIntermediateTypes(ServerInterface &srvInterface,
+                                    const SizedColumnTypes &inputTypes,
+                                    SizedColumnTypes &intermediateTypeMetaData)
+  {
+    uint8_t precision = readSubStreamBits(srvInterface);
+    intermediateTypeMetaData.addVarbinary(HllView<uint64_t>::getMaxDeserializedBufferSize(precision));
+  }
+
+
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addVarbinary();
+    returnType.addInt();
+  }
+
+  virtual void getReturnType(ServerInterface &srvInterface,
+                             const SizedColumnTypes &inputTypes,
+                             SizedColumnTypes &outputTypes)
+  {
+    outputTypes.addInt();
+  }
+
+  virtual AggregateFunction *createAggregateFunction(ServerInterface &srvInterface)
+  {
+    return vt_createFuncObject<DistinctCount<Estimate> >(srvInterface.allocator);
+  }
+
+  virtual void getParameterType(ServerInterface &srvInterface,
+                                SizedColumnTypes &parameterTypes)
+  {
+    parameterTypes.addInt("_minimizeCallCount");
+
+    SizedColumnTypes::Properties props;
+    props.required = false;
+    props.canBeNull = false;
+    props.comment = "Precision bits";
+    parameterTypes.addInt(HLL_ARRAY_SIZE_PARAMETER_NAME, props);
+
+    props.comment = "Serialization/deserialization bits per bucket";
+    parameterTypes.addInt(HLL_BITS_PER_BUCKET_PARAMETER_NAME, props);
+  }
+
+};
+
+#endif
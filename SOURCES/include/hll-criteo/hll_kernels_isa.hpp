@@ -0,0 +1,122 @@
+/*
+ * No include guard: hll_raw.hpp includes this file once per instruction set,
+ * with HLL_KERNELS_ISA set to a CpuIsa value, HLL_KERNELS_TARGET to the
+ * attributes of the thunks compiled for it, HLL_KERNELS_HISTOGRAM to the
+ * RegisterHistogram and JointRegisterHistogram functions they use and HLL_KERNELS_UNPACK to the struct
+ * of register_unpack.hpp their compact folds use. flatten inlines the HllRaw loops
+ * into the thunks, so that they are compiled for that instruction set too.
+ */
+#if !defined(HLL_KERNELS_ISA) || !defined(HLL_KERNELS_TARGET) || !defined(HLL_KERNELS_HISTOGRAM) || !defined(HLL_KERNELS_UNPACK)
+#error "hll_kernels_isa.hpp is only meant to be included by hll_raw.hpp"
+#endif
+
+template<typename T, typename H, uint8_t P>
+struct HllFixedPrecisionKernels<T, H, P, HLL_KERNELS_ISA> {
+  typedef HllRaw<T, H, P> Raw;
+
+  static Raw wrap(const uint8_t* synopsis) {
+    return Raw(P, const_cast<uint8_t*>(synopsis));
+  }
+
+  HLL_KERNELS_TARGET static RegisterHistogram histogram(const uint8_t* synopsis) {
+    return RegisterHistogram::HLL_KERNELS_HISTOGRAM(synopsis, wrap(synopsis).getNumberOfBuckets());
+  }
+  HLL_KERNELS_TARGET static RegisterHistogram histogram6Bits(const uint8_t* byteArray) {
+    return Raw::template histogram6Bits<HLL_KERNELS_UNPACK, &RegisterHistogram::HLL_KERNELS_HISTOGRAM>(byteArray, 1u << P);
+  }
+  HLL_KERNELS_TARGET static RegisterHistogram histogram5BitsWithBase(const uint8_t* byteArray, uint8_t base) {
+    return Raw::template histogram5BitsWithBase<HLL_KERNELS_UNPACK, &RegisterHistogram::HLL_KERNELS_HISTOGRAM>(byteArray, base, 1u << P);
+  }
+  HLL_KERNELS_TARGET static JointRegisterHistogram jointHistogram(const uint8_t* synopsis, const uint8_t* other) {
+    return JointRegisterHistogram::HLL_KERNELS_HISTOGRAM(synopsis, other, 1u << P);
+  }
+  HLL_KERNELS_TARGET static uint64_t estimate(const uint8_t* synopsis) {
+    return wrap(synopsis).estimate(histogram(synopsis));
+  }
+  HLL_KERNELS_TARGET static uint64_t betaEstimate(const uint8_t* synopsis) {
+    return wrap(synopsis).betaEstimate(histogram(synopsis));
+  }
+  HLL_KERNELS_TARGET static uint32_t emptyBucketsCount(const uint8_t* synopsis) {
+    return wrap(synopsis).emptyBucketsCount();
+  }
+  HLL_KERNELS_TARGET static uint64_t getNumberOfSetBuckets(const uint8_t* synopsis) {
+    return wrap(synopsis).getNumberOfSetBuckets();
+  }
+  HLL_KERNELS_TARGET static uint64_t sparseVarintSize(const uint8_t* synopsis, uint8_t threshold) {
+    return wrap(synopsis).sparseVarintSize(threshold);
+  }
+  HLL_KERNELS_TARGET static void merge(uint8_t* synopsis, const uint8_t* otherSynopsis) {
+    wrap(synopsis).add(otherSynopsis);
+  }
+  HLL_KERNELS_TARGET static void addBatch(uint8_t* synopsis, const T* values, size_t n, uint32_t hashSeed) {
+    Raw(P, synopsis, hashSeed).addBatch(values, n);
+  }
+  HLL_KERNELS_TARGET static void addHashes(uint8_t* synopsis, const uint64_t* hashes, size_t n) {
+    wrap(synopsis).addHashes(hashes, n);
+  }
+
+  HLL_KERNELS_TARGET static void fold8BitsSparse(uint8_t* synopsis, const uint8_t* byteArray, uint16_t setBuckets, size_t length) {
+    wrap(synopsis).fold8BitsSparse(byteArray, setBuckets, length);
+  }
+  HLL_KERNELS_TARGET static void fold8BitsSparseVarint(uint8_t* synopsis, const uint8_t* byteArray, size_t length) {
+    wrap(synopsis).fold8BitsSparseVarint(byteArray, length);
+  }
+  HLL_KERNELS_TARGET static void fold8Bits(uint8_t* synopsis, const uint8_t* byteArray, size_t length) {
+    wrap(synopsis).fold8Bits(byteArray, length);
+  }
+  HLL_KERNELS_TARGET static void fold6Bits(uint8_t* synopsis, const uint8_t* byteArray, size_t length) {
+    wrap(synopsis).template fold6Bits<HLL_KERNELS_UNPACK>(byteArray, length);
+  }
+  HLL_KERNELS_TARGET static void fold5BitsWithBase(uint8_t* synopsis, const uint8_t* byteArray, uint8_t base, size_t length) {
+    wrap(synopsis).template fold5BitsWithBase<HLL_KERNELS_UNPACK>(byteArray, base, length);
+  }
+  HLL_KERNELS_TARGET static void fold4BitsWithBase(uint8_t* synopsis, const uint8_t* byteArray, uint8_t base, size_t length) {
+    wrap(synopsis).template fold4BitsWithBase<HLL_KERNELS_UNPACK>(byteArray, base, length);
+  }
+  HLL_KERNELS_TARGET static void foldEntropy(uint8_t* synopsis, const uint8_t* byteArray, uint8_t center, size_t length) {
+    wrap(synopsis).foldEntropy(byteArray, center, length);
+  }
+  HLL_KERNELS_TARGET static void foldDown(uint8_t* synopsis, const uint8_t* higher, uint8_t higherPrecision) {
+    wrap(synopsis).foldDown(higher, higherPrecision);
+  }
+  HLL_KERNELS_TARGET static void foldMany(uint8_t* synopsis, const uint8_t* const* inputs, const Format* formats, const uint8_t* bases, size_t n) {
+    wrap(synopsis).template foldMany<HLL_KERNELS_UNPACK>(inputs, formats, bases, n);
+  }
+
+  HLL_KERNELS_TARGET static uint16_t serialize8BitsSparse(const uint8_t* synopsis, uint8_t* byteArray) {
+    return wrap(synopsis).serialize8BitsSparse(byteArray);
+  }
+  HLL_KERNELS_TARGET static uint64_t serialize8BitsSparseVarint(const uint8_t* synopsis, uint8_t* byteArray, uint8_t threshold) {
+    return wrap(synopsis).serialize8BitsSparseVarint(byteArray, threshold);
+  }
+  HLL_KERNELS_TARGET static void serialize8Bits(const uint8_t* synopsis, uint8_t* byteArray) {
+    wrap(synopsis).serialize8Bits(byteArray);
+  }
+  HLL_KERNELS_TARGET static void serialize6Bits(const uint8_t* synopsis, uint8_t* byteArray) {
+    wrap(synopsis).serialize6Bits(byteArray);
+  }
+  HLL_KERNELS_TARGET static void serialize5BitsWithBase(const uint8_t* synopsis, uint8_t* byteArray, uint8_t base) {
+    wrap(synopsis).serialize5BitsWithBase(byteArray, base);
+  }
+  HLL_KERNELS_TARGET static void serialize4BitsWithBase(const uint8_t* synopsis, uint8_t* byteArray, uint8_t base) {
+    wrap(synopsis).serialize4BitsWithBase(byteArray, base);
+  }
+  HLL_KERNELS_TARGET static uint64_t serializeEntropy(const uint8_t* synopsis, uint8_t* byteArray, uint8_t center) {
+    return wrap(synopsis).serializeEntropy(byteArray, center);
+  }
+
+  static constexpr HllKernels<T, H> kernels() {
+    return HllKernels<T, H> {
+      P,
+      &histogram, &histogram6Bits, &histogram5BitsWithBase, &jointHistogram, &estimate, &betaEstimate, &emptyBucketsCount, &getNumberOfSetBuckets, &sparseVarintSize, &merge, &addBatch, &addHashes,
+      &fold8BitsSparse, &fold8BitsSparseVarint, &fold8Bits, &fold6Bits, &fold5BitsWithBase, &fold4BitsWithBase, &foldEntropy, &foldDown, &foldMany,
+      &serialize8BitsSparse, &serialize8BitsSparseVarint, &serialize8Bits, &serialize6Bits, &serialize5BitsWithBase, &serialize4BitsWithBase,
+      &serializeEntropy
+    };
+  }
+};
+
+#undef HLL_KERNELS_ISA
+#undef HLL_KERNELS_TARGET
+#undef HLL_KERNELS_HISTOGRAM
+#undef HLL_KERNELS_UNPACK
@@ -13,21 +13,69 @@
 #include <cassert>
 
 #include "bias_corrected_estimate.hpp"
+#include "joint_estimate.hpp"
 #include "linear_counting.hpp"
 #include "murmur_hash.hpp"
+#include "register_entropy_code.hpp"
+#include "register_histogram.hpp"
+#include "register_unpack.hpp"
 #include "../hll_utils.hpp"
 
 struct SerializationError : public virtual std::runtime_error {
   SerializationError(const char* message) : std::runtime_error(std::string(message)) {}
+  SerializationError(const std::string& message) : std::runtime_error(message) {}
 };
 
-enum class Format {NORMAL, COMPACT_6BITS, COMPACT_5BITS, COMPACT_4BITS, SPARSE};
+/**
+ * SPARSE stores 16-bit bucket ids, so it only holds precisions up to 16.
+ * SPARSE_VARINT stores the gaps between set buckets as varints after a 32-bit
+ * count, which holds any precision and takes 2 bytes per bucket when they are
+ * less than 128 apart.
+ * COMPACT_5BITS and COMPACT_4BITS clamp the registers more than 31 and 15
+ * above their base. The _EXCEPTIONS variants follow them with the clamped
+ * registers in SPARSE_VARINT, which keeps them exact (HLL4 in Apache
+ * DataSketches does the same).
+ * ENTROPY stores every register with the RegisterEntropyCode of the center
+ * of their distribution, under 3 bits per register at any cardinality.
+ * AUTO is never written: it asks Hll::serializationFormat() for the smallest
+ * format that keeps every register, ENTROPY aside as it is slower to fold.
+ */
+enum class Format {NORMAL, COMPACT_6BITS, COMPACT_5BITS, COMPACT_4BITS, SPARSE, SPARSE_VARINT,
+  COMPACT_5BITS_EXCEPTIONS, COMPACT_4BITS_EXCEPTIONS, ENTROPY, AUTO};
+
+// Instruction sets HllKernels are compiled for, from the least to the most capable
+enum class CpuIsa {DEFAULT, SSE42, AVX2, AVX512};
+
+inline CpuIsa detectCpuIsa() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")) {
+    return CpuIsa::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")) {
+    return CpuIsa::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+    return CpuIsa::SSE42;
+  }
+#endif
+  return CpuIsa::DEFAULT;
+}
+
+// detectCpuIsa() of the host, looked up once
+inline CpuIsa hostCpuIsa() {
+  static const CpuIsa isa = detectCpuIsa();
+  return isa;
+}
 
 /**
  * T is the hashable type. The class can be used to count various types.
  * H is a class deriving from Hash<T>
+ * P is the precision when it's known at compile time. With P != 0 all the masks
+ * and trip counts below are constants. P = 0 means the precision is given at runtime.
  */
-template<typename T, typename H = MurMurHash<T> >
+template<typename T, typename H = MurMurHash<T>, uint8_t P = 0>
 class HllRaw {
 /**
  * The line below is the fanciest thing I've ever done.
@@ -37,6 +85,8 @@ class HllRaw {
  */
   static_assert(std::is_base_of<Hash<T>, H>::value,
     "Hll's H parameter has to be a subclass of Hash<T>");
+  static_assert(P == 0 || (P >= 4 && P <= 18),
+    "HllRaw's P parameter has to be between 4 and 18");
 private:
   /**
    * The below member variables' order aims at minimizing the memory fooprint
@@ -45,14 +95,22 @@ private:
   uint8_t bucketBits;
   uint8_t valueBits;
   uint8_t* synopsis;
-
-  const uint32_t DEFAULT_HASH_SEED = 27072015;
   uint32_t hashSeed; // Ability to get different hashing for same data
 
+  // addBatch() hashes values in chunks of this size before touching the synopsis
+  static const size_t HASH_CHUNK_SIZE = 64;
+
+  // histogram6Bits() and histogram5BitsWithBase() unpack this many registers at once, 4 KB on the stack
+  static const uint32_t HISTOGRAM_BLOCK_SIZE = 4096;
+
+  // foldMany() folds the payloads into this many registers at a time, 8 KB of the L1 cache
+  static const uint32_t FOLD_MANY_TILE_SIZE = 8192;
+
   // 8 constant values per precision for polynom (taken from LogLog-beta paper and appendix)
   // Source : https://github.com/colings86/elasticsearch/blob/b0093fc059b615d9ca2136efec0fc880f2be1815/core/src/main/java/org/elasticsearch/search/aggregations/metrics/cardinality/HyperLogLogBeta.java#L56
-  static const size_t nCoefficients = 8;
-  const std::vector<std::vector<double>> betaConstants = {
+  // The table is static and constexpr so that wrapping a buffer doesn't build it again.
+  static constexpr size_t nCoefficients = 8;
+  static constexpr double betaConstants[][nCoefficients] = {
     // precision 4
     { 129.811426122, -127.758849345, -144.856462515, 185.084979526, -13.2281686587, 43.5841078986, -383.603665383, 154.492845304 },
     // precision 5
@@ -79,14 +137,33 @@ private:
     { -0.560387006169, 59.8108631214, -120.370073477, 86.0699330472, -28.9537963009, 5.03900955483, -0.439967193352, 0.0157440364892 },
     // precision 16
     { -0.391416234743, 1.85229689725, -8.882746972, 7.48086624254, -2.80472962045, 0.568918604145, -0.0583909163033, 0.00261029795878 },
-     // precision 17
-     { -0.339120524001, -72.1994426957, 113.185471625, -62.8282169476, 16.6562758098, -2.26144354617, 0.150939847827, -0.0036642817302 },
-     // precision 18
+    // precision 17
+    { -0.339120524001, -72.1994426957, 113.185471625, -62.8282169476, 16.6562758098, -2.26144354617, 0.150939847827, -0.0036642817302 },
+    // precision 18
     { -0.372494978401, 39.9302213478, -69.8219564407, 43.7971215279, -13.1312309526, 2.0820456299, -0.1696126329, 0.00591592212173 }
   };
 
+  // Alpha constants per precision (see Flajolet's paper), indexed like betaConstants
+  static constexpr double alphaConstants[] = {
+    0.673, // precision 4
+    0.697, // precision 5
+    0.709, // precision 6
+    0.7213 / (1.0 + 1.079 / (1 << 7)),
+    0.7213 / (1.0 + 1.079 / (1 << 8)),
+    0.7213 / (1.0 + 1.079 / (1 << 9)),
+    0.7213 / (1.0 + 1.079 / (1 << 10)),
+    0.7213 / (1.0 + 1.079 / (1 << 11)),
+    0.7213 / (1.0 + 1.079 / (1 << 12)),
+    0.7213 / (1.0 + 1.079 / (1 << 13)),
+    0.7213 / (1.0 + 1.079 / (1 << 14)),
+    0.7213 / (1.0 + 1.079 / (1 << 15)),
+    0.7213 / (1.0 + 1.079 / (1 << 16)),
+    0.7213 / (1.0 + 1.079 / (1 << 17)),
+    0.7213 / (1.0 + 1.079 / (1 << 18))
+  };
+
   size_t betaDataIndex() const {
-    return bucketBits - 4;
+    return getBucketBits() - 4;
   }
 
   uint8_t leftMostSetBit(uint64_t hash) const {
@@ -96,13 +173,13 @@ private:
     else {
       // Ex: with a 4 bits bucket on a 16 bit size_t  we want 0000 1111 1111 1111
       // So that's 1 with 12 ( 16 - 4 ) zeroes 0001 0000 0000 0000, minus one = 0000 1111 1111 1111
-      const uint64_t valueMask = (1UL << valueBits ) - 1UL;
+      const uint64_t valueMask = (1UL << getValueBits() ) - 1UL;
       /**
        * clz returns number of leading zero bits couting from the MSB
        * we have to add 1 to count the set bit
        * then we subtract bucketBits, since they are zeroed by valueMask
        */
-      return (uint8_t)__builtin_clzll(hash & valueMask) + 1 - bucketBits;
+      return (uint8_t)__builtin_clzll(hash & valueMask) + 1 - getBucketBits();
     }
   }
 
@@ -120,6 +197,32 @@ private:
     if (!(bucketBits >= 4 && bucketBits <= 18)) {
       throw SerializationError("precision has to be between 4 and 18");
     }
+    if (P != 0 && bucketBits != P) {
+      throw SerializationError("precision doesn't match the one HllRaw was specialized for");
+    }
+  }
+
+  template<typename, typename> friend class Hll;
+
+  /**
+   * Same as addHashes(), keeping histogram, the RegisterHistogram of the
+   * registers, up to date: a register that grows moves from the count of its
+   * old value to that of its new one. The estimates can then be taken from it
+   * after every batch without a pass over the synopsis. Only Hll calls it,
+   * on the histogram it tracks after the registers (see trackHistogram()).
+   */
+  void addHashes(const uint64_t* hashes, size_t n, RegisterHistogram& histogram) {
+    uint8_t* __restrict__ synopsis_ = synopsis;
+    for (size_t i = 0; i < n; ++i) {
+      const uint32_t dstBucket = bucket(hashes[i]);
+      const uint8_t value = leftMostSetBit(hashes[i]);
+      const uint8_t previous = synopsis_[dstBucket];
+      if (value > previous) {
+        synopsis_[dstBucket] = value;
+        --histogram.counts[RegisterHistogram::bin(previous)];
+        ++histogram.counts[RegisterHistogram::bin(value)];
+      }
+    }
   }
 public:
 
@@ -128,13 +231,13 @@ public:
   uint64_t bucket(uint64_t hash) {
     // Ex: with a 4 bits bucket on a 2 bytes size_t we want 1111 0000 0000 0000
     // So that's 10000 minus 1 shifted with 12 zeroes 1111 0000 0000 0000
-    const uint64_t bucketMask = (( 1UL << bucketBits ) - 1UL) << valueBits;
+    const uint64_t bucketMask = (( 1UL << getBucketBits() ) - 1UL) << getValueBits();
 
     // Get the most significant bits and shift that
     // For example on a 16-bit platform, with a 4 bit bucketMask (valueBits = 12)
     // The value 0110 0111 0101 0001 is first bit masked to 0110 0000 0000 0000
     // And right shifted by 12 bits, which gives 0110, bucket 6.
-    return (hash & bucketMask) >> valueBits;
+    return (hash & bucketMask) >> getValueBits();
   }
 
   HllRaw(uint8_t bucketBits, uint8_t *synopsis, uint32_t newHashSeed = MURMURHASH_DEFAULT_SEED) {
@@ -157,6 +260,35 @@ public:
     return hashValue;
   }
 
+  /**
+   * Adds n values at once. The values are hashed in chunks first and only then
+   * put in their buckets, so that hash functions with a vectorized
+   * hashBatch() can hash several values per instruction.
+   */
+  void addBatch(const T* values, size_t n) {
+    H hashFunction;
+    uint64_t hashes[HASH_CHUNK_SIZE];
+    uint8_t* __restrict__ synopsis_ = synopsis;
+
+    for (size_t offset = 0; offset < n; offset += HASH_CHUNK_SIZE) {
+      const size_t chunk = std::min(n - offset, HASH_CHUNK_SIZE);
+      hashFunction.hashBatch(values + offset, chunk, hashes, hashSeed);
+      for (size_t i = 0; i < chunk; ++i) {
+        const uint32_t dstBucket = bucket(hashes[i]);
+        synopsis_[dstBucket] = std::max(synopsis_[dstBucket], leftMostSetBit(hashes[i]));
+      }
+    }
+  }
+
+  // Same as addBatch() of values someone else already hashed, whatever the function
+  void addHashes(const uint64_t* hashes, size_t n) {
+    uint8_t* __restrict__ synopsis_ = synopsis;
+    for (size_t i = 0; i < n; ++i) {
+      const uint32_t dstBucket = bucket(hashes[i]);
+      synopsis_[dstBucket] = std::max(synopsis_[dstBucket], leftMostSetBit(hashes[i]));
+    }
+  }
+
   void add(const uint8_t otherSynopsis[]) {
     const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
     uint8_t* __restrict__ synopsis_ = synopsis;
@@ -167,7 +299,37 @@ public:
     }
   }
 
-  void add(const HllRaw<T>& other) {
+  /**
+   * Folds the registers of a synopsis of a higher precision into this one,
+   * giving the registers its values would have set at this precision. The
+   * 2^d registers j of the higher precision synopsis that share the bucket
+   * i = j >> d of this one saw the hashes whose d bits after the bucket bits
+   * of this precision are b = j - (i << d). For b > 0 the first set bit after
+   * the bucket bits is among them, at rank d - floor(log2(b)) whatever the
+   * register holds; for b = 0 it comes after them, at rank d + the register.
+   * So the register of i is d + the first of its group if it is set, or else
+   * d - k for the smallest k such that a register with b in [2^k, 2^(k+1))
+   * is set. Each range is checked with an OR over its registers.
+   */
+  void foldDown(const uint8_t* __restrict__ higher, uint8_t higherPrecision) {
+    uint8_t* __restrict__ synopsis_ = synopsis;
+    const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
+    const uint8_t d = higherPrecision - this->getBucketBits();
+    for (uint32_t i = 0; i < numberOfBucketsConst; ++i) {
+      const uint8_t* __restrict__ group = higher + (static_cast<size_t>(i) << d);
+      uint8_t value = group[0] != 0 ? group[0] + d : 0;
+      for (uint8_t k = 0; value == 0 && k < d; ++k) {
+        uint8_t any = 0;
+        for (uint32_t b = 1U << k; b < (2U << k); ++b) {
+          any |= group[b];
+        }
+        value = any != 0 ? d - k : 0;
+      }
+      synopsis_[i] = std::max(synopsis_[i], value);
+    }
+  }
+
+  void add(const HllRaw& other) {
     if (!(this->getNumberOfBuckets() == other.getNumberOfBuckets())) {
       throw SerializationError("Synopsis are in different format");
     }
@@ -180,7 +342,15 @@ public:
   }
 
   uint8_t getBucketBits() const {
-    return this->bucketBits;
+    return P != 0 ? P : this->bucketBits;
+  }
+
+  uint32_t getHashSeed() const {
+    return this->hashSeed;
+  }
+
+  uint8_t getValueBits() const {
+    return P != 0 ? 64 - P : this->valueBits;
   }
 
   uint8_t* getCurrentSynopsis() {
@@ -188,8 +358,7 @@ public:
   }
 
   uint64_t getNumberOfBuckets() const {
-    return countNumberOfBuckets(bucketBits);
-    //return this->numberOfBuckets;
+    return countNumberOfBuckets(getBucketBits());
   }
 
   uint64_t getNumberOfSetBuckets() const {
@@ -201,18 +370,36 @@ public:
   }
 
   uint64_t getDeserializedSynopsisSize() const {
-    return HllRaw<T,H>::countNumberOfBuckets(bucketBits);
+    return countNumberOfBuckets(getBucketBits());
   }
 
   static uint64_t getDeserializedSynopsisSize(uint8_t precision) {
-    return HllRaw<T,H>::countNumberOfBuckets(precision);
+    return countNumberOfBuckets(precision);
   }
 
   uint64_t getSerializedSynopsisSize(Format format) const {
     if (format == Format::SPARSE) {
       return getNumberOfSetBuckets() * 3;
+    } else if (format == Format::SPARSE_VARINT) {
+      return sparseVarintSize();
+    } else if (format == Format::ENTROPY) {
+      const RegisterHistogram histogram = this->histogram();
+      return RegisterEntropyCode::forCenter(RegisterEntropyCode::bestCenter(histogram)).encodedBytes(histogram);
+    } else if (format == Format::COMPACT_5BITS_EXCEPTIONS || format == Format::COMPACT_4BITS_EXCEPTIONS) {
+      const uint8_t base = *std::min_element(synopsis, synopsis + this->getNumberOfBuckets());
+      return getMaxSerializedSynopsisSize(denseFormat(format), getBucketBits()) + sparseVarintSize(exceptionThreshold(format, base));
     }
-    return HllRaw<T,H>::getMaxSerializedSynopsisSize(format, bucketBits);
+    return getMaxSerializedSynopsisSize(format, getBucketBits());
+  }
+
+  // Format of the registers that come before the exceptions
+  static Format denseFormat(Format exceptionsFormat) {
+    return exceptionsFormat == Format::COMPACT_5BITS_EXCEPTIONS ? Format::COMPACT_5BITS : Format::COMPACT_4BITS;
+  }
+
+  // Largest register the dense part of the format holds with the given base
+  static uint8_t exceptionThreshold(Format exceptionsFormat, uint8_t base) {
+    return base + (exceptionsFormat == Format::COMPACT_5BITS_EXCEPTIONS ? 31 : 15);
   }
 
   static uint64_t getMaxSerializedSynopsisSize(Format format, uint8_t precision) {
@@ -238,6 +425,17 @@ public:
       ret = (4 * numberOfBuckets) / 8;
     } else if(format == Format::SPARSE) {
       ret = numberOfBuckets * 3;
+    } else if(format == Format::SPARSE_VARINT) {
+      // every gap fits in as many bytes as the last bucket id
+      ret = sizeof(uint32_t) + numberOfBuckets * (varint_size(numberOfBuckets - 1) + 1);
+    } else if(format == Format::COMPACT_5BITS_EXCEPTIONS || format == Format::COMPACT_4BITS_EXCEPTIONS) {
+      ret = getMaxSerializedSynopsisSize(denseFormat(format), precision)
+        + getMaxSerializedSynopsisSize(Format::SPARSE_VARINT, precision);
+    } else if(format == Format::ENTROPY) {
+      ret = (numberOfBuckets * RegisterEntropyCode::MAX_CODE_LENGTH + 7) / 8;
+    } else if(format == Format::AUTO) {
+      // 6 bits always hold a register, anything picked instead is smaller
+      ret = getMaxSerializedSynopsisSize(Format::COMPACT_6BITS, precision);
     } else {
       throw SerializationError("Cannot get Maximum serialized size for format");
     }
@@ -253,6 +451,10 @@ public:
     return emptyBuckets;
   }
 
+  RegisterHistogram histogram() const {
+    return RegisterHistogram::of(synopsis, this->getNumberOfBuckets());
+  }
+
   void printBuckets() const {
     for (uint64_t i = 0; i < this->getNumberOfBuckets(); i++)
     {
@@ -276,13 +478,12 @@ public:
    *
    */
   uint64_t estimate() const {
-    double harmonicMean = 0.0;
+    return estimate(histogram());
+  }
+
+  uint64_t estimate(const RegisterHistogram& histogram) const {
     double alpha = getAlpha();
-    for (uint64_t i = 0; i < this->getNumberOfBuckets(); i++)
-    {
-        harmonicMean += fast_inv_pow2(synopsis[i]);
-    }
-    harmonicMean = this->getNumberOfBuckets() / harmonicMean;
+    double harmonicMean = this->getNumberOfBuckets() / histogram.harmonicSum();
     // std::llround returns a long long
     // note: other rounding functions return a floating point or shorter types
     uint64_t hllEstimate = std::llround(/*0.5 + */alpha * harmonicMean * this->getNumberOfBuckets());
@@ -291,21 +492,7 @@ public:
 
   double getAlpha() const {
     // Alpha computation (see paper)
-    switch (bucketBits) {
-      case 4:
-        return 0.673;
-      case 5:
-        return 0.697;
-      case 6:
-        return 0.709;
-      // since 11 and 14 are most likely cases, we make it computable in compile time
-      case 11:
-        return (0.7213 / (1.0 + (1.079 / (1<<11)))); //0.72092
-      case 14:
-        return (0.7213 / (1.0 + (1.079 / (1<<14)))); //0.721253
-      default:
-        return (0.7213 / (1.0 + (1.079 / static_cast<double>(getNumberOfBuckets()))));
-    }
+    return alphaConstants[betaDataIndex()];
   }
 
   double getBeta(uint64_t zInput) const {
@@ -328,24 +515,82 @@ public:
    * , it returns LogLog-Beta cardinality estimation
    */
   uint64_t betaEstimate() const {
-    double harmonicMean = 0.0;
-    double alpha = getAlpha();
+    return betaEstimate(histogram());
+  }
 
-    uint64_t numberOfZeroes = 0;
-    for (uint64_t i = 0; i < this->getNumberOfBuckets(); i++)
-    {
-      if (synopsis[i] == 0){
-        ++numberOfZeroes;
-      }
-      harmonicMean += fast_inv_pow2(synopsis[i]);
-    }
-    harmonicMean = this->getNumberOfBuckets() / (harmonicMean + getBeta(numberOfZeroes));
+  uint64_t betaEstimate(const RegisterHistogram& histogram) const {
+    double alpha = getAlpha();
+    uint64_t numberOfZeroes = histogram.emptyRegisters();
+    double harmonicMean = this->getNumberOfBuckets() / (histogram.harmonicSum() + getBeta(numberOfZeroes));
     // std::llround returns a long long
     // note: other rounding functions return a floating point or shorter types
     uint64_t hllEstimate = std::llround(alpha * harmonicMean * (getNumberOfBuckets() - numberOfZeroes) );
     return hllEstimate;
   }
 
+  /**
+   * Improved raw estimator from Ertl's "New cardinality estimation algorithms
+   * for HyperLogLog sketches" (https://arxiv.org/abs/1702.01284), section 3.
+   * It corrects the harmonic mean for both empty registers (sigma) and
+   * saturated ones (tau), so it is accurate over the whole range without
+   * empirical bias tables, linear counting or a threshold between the two:
+   *
+   * E = \alpha_\infty m^2 / (m \sigma(C_0 / m) + \sum_{k=1}^{q} C_k 2^{-k} + m \tau(1 - C_{q+1} / m) 2^{-q})
+   *
+   * with q = 64 - p the number of value bits and C_k the number of registers
+   * equal to k. The sum is evaluated by Horner's scheme from k = q down to 1.
+   */
+  uint64_t improvedEstimate() const {
+    return improvedEstimate(histogram());
+  }
+
+  uint64_t improvedEstimate(const RegisterHistogram& histogram) const {
+    const double m = this->getNumberOfBuckets();
+    const uint8_t q = getValueBits();
+    if (histogram.counts[0] == getNumberOfBuckets()) {
+      return 0;
+    }
+
+    double z = m * improvedTau(1.0 - histogram.counts[q + 1] / m);
+    for (int k = q; k >= 1; --k) {
+      z = 0.5 * (z + histogram.counts[k]);
+    }
+    z += m * improvedSigma(histogram.counts[0] / m);
+    // alpha_infinity = 1 / (2 ln 2)
+    return std::llround(m * m / (2.0 * std::log(2.0) * z));
+  }
+
+  // sigma(x) = x + sum_{k=1}^{inf} x^{2^k} 2^{k-1}, for x < 1
+  static double improvedSigma(double x) {
+    double y = 1.0;
+    double z = x;
+    double previous;
+    do {
+      x *= x;
+      previous = z;
+      z += x * y;
+      y += y;
+    } while (z != previous);
+    return z;
+  }
+
+  // tau(x) = (1 - x - sum_{k=1}^{inf} (1 - x^{2^{-k}})^2 2^{-k}) / 3
+  static double improvedTau(double x) {
+    if (x == 0.0 || x == 1.0) {
+      return 0.0;
+    }
+    double y = 1.0;
+    double z = 1.0 - x;
+    double previous;
+    do {
+      x = std::sqrt(x);
+      previous = z;
+      y *= 0.5;
+      z -= (1.0 - x) * (1.0 - x) * y;
+    } while (z != previous);
+    return z / 3.0;
+  }
+
   // Deserialize and add in one pass
   void fold8BitsSparse(const uint8_t* __restrict__ byteArray, uint16_t setBuckets, size_t length) {
     uint8_t* __restrict__ synopsis_ = this->synopsis;
@@ -378,6 +623,111 @@ public:
     return setBuckets;
   }
 
+  // Deserialize and add in one pass
+  void fold8BitsSparseVarint(const uint8_t* __restrict__ byteArray, size_t length) {
+    uint8_t* __restrict__ synopsis_ = this->synopsis;
+    uint32_t setBuckets;
+    if (length < sizeof(setBuckets)) {
+      throw SerializationError("Payload is not big enough for the number of buckets");
+    }
+    memcpy(&setBuckets, byteArray, sizeof(setBuckets));
+    const uint8_t* in = byteArray + sizeof(setBuckets);
+    const uint8_t* end = byteArray + length;
+    // each bucket takes at least 2 bytes, which bounds the loop whatever the count says
+    if (setBuckets > (length - sizeof(setBuckets)) / 2) {
+      throw SerializationError("Payload is not big enough for all advertised buckets");
+    }
+
+    uint32_t id = 0;
+    while (setBuckets-- > 0) {
+      uint32_t gap;
+      if (!read_varint(in, end, gap) || in == end) {
+        throw SerializationError("Payload is not big enough for all advertised buckets");
+      }
+      id += gap;
+      if (id >= this->getNumberOfBuckets()) {
+        throw SerializationError("Bucket id is not valid when decoding sparse");
+      }
+      synopsis_[id] = std::max(synopsis_[id], *in++);
+    }
+  }
+
+  // Deserialize and add in one pass, the decoded registers go nowhere else
+  void foldEntropy(const uint8_t* __restrict__ byteArray, uint8_t center, size_t length) {
+    if (center >= RegisterEntropyCode::NUMBER_OF_CENTERS) {
+      throw SerializationError("Entropy code is not valid");
+    }
+    if (!RegisterEntropyCode::forCenter(center).decodeFold(byteArray, length, this->synopsis, this->getNumberOfBuckets())) {
+      throw SerializationError("Payload is not big enough for all advertised buckets");
+    }
+  }
+
+  // center has to come from RegisterEntropyCode::bestCenter(), returns the number of bytes written
+  uint64_t serializeEntropy(uint8_t* __restrict__ byteArray, uint8_t center) const {
+    return RegisterEntropyCode::forCenter(center).encode(this->synopsis, this->getNumberOfBuckets(), byteArray);
+  }
+
+  /**
+   * Writes the number of buckets above threshold (the set ones by default),
+   * then for each of them the gap from the previous one (from 0 for the
+   * first) as a varint and its value. Returns the number of bytes written,
+   * sparseVarintSize(threshold).
+   */
+  uint64_t serialize8BitsSparseVarint(uint8_t* __restrict__ byteArray, uint8_t threshold = 0) const {
+    const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
+    const uint8_t* __restrict__ synopsis_ = this->synopsis;
+
+    uint32_t setBuckets = 0;
+    uint64_t bytes = sizeof(setBuckets);
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < numberOfBucketsConst; i += sizeof(uint64_t)) {
+      uint64_t registers;
+      memcpy(&registers, synopsis_ + i, sizeof(registers));
+      for (uint64_t above = registersAbove(registers, threshold); above != 0; above &= above - 1) {
+        const uint32_t id = i + __builtin_ctzll(above) / 8;
+        bytes += write_varint(byteArray + bytes, id - previous);
+        byteArray[bytes++] = synopsis_[id];
+        previous = id;
+        setBuckets++;
+      }
+    }
+    memcpy(byteArray, &setBuckets, sizeof(setBuckets));
+    return bytes;
+  }
+
+  // Exact size of serialize8BitsSparseVarint(), 8 registers at a time
+  uint64_t sparseVarintSize(uint8_t threshold = 0) const {
+    const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
+    const uint8_t* __restrict__ synopsis_ = this->synopsis;
+
+    uint64_t bytes = sizeof(uint32_t);
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < numberOfBucketsConst; i += sizeof(uint64_t)) {
+      uint64_t registers;
+      memcpy(&registers, synopsis_ + i, sizeof(registers));
+      // registers below threshold, the common case when this is worth calling, are skipped 8 at a time
+      for (uint64_t above = registersAbove(registers, threshold); above != 0; above &= above - 1) {
+        const uint32_t id = i + __builtin_ctzll(above) / 8;
+        bytes += varint_size(id - previous) + 1;
+        previous = id;
+      }
+    }
+    return bytes;
+  }
+
+  /**
+   * Sets the top bit of each byte of the result whose register in registers is
+   * above threshold (< 128), and no other bit. The low 7 bits of a register
+   * plus 127 - threshold carry into its top bit exactly when they are above
+   * threshold, and never into the next register; a register whose own top bit
+   * is set, which only a corrupted payload can bring, is above too.
+   */
+  static uint64_t registersAbove(uint64_t registers, uint8_t threshold) {
+    const uint64_t lowBits = 0x7f7f7f7f7f7f7f7fULL;
+    const uint64_t offset = (127 - threshold) * 0x0101010101010101ULL;
+    return (((registers & lowBits) + offset) | registers) & ~lowBits;
+  }
+
 
   // Deserialize and add in one pass
   void fold8Bits(const uint8_t* __restrict__ byteArray, size_t length) {
@@ -392,6 +742,47 @@ public:
     }
   }
 
+  /**
+   * fold8Bits(), fold6Bits(), fold5BitsWithBase() or fold4BitsWithBase() of
+   * n payloads at once, each holding all the registers of its format (the
+   * caller checks their length). Folding them one after the other streams the
+   * whole synopsis through the cache once per payload; instead, the synopsis
+   * is split in tiles of FOLD_MANY_TILE_SIZE registers that stay in L1 while
+   * the matching part of every payload is folded into them.
+   */
+  template<typename Unpack = ScalarUnpack>
+  void foldMany(const uint8_t* const* inputs, const Format* formats, const uint8_t* bases, size_t n) {
+    uint8_t* __restrict__ synopsis_ = this->synopsis;
+    const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
+    const uint32_t tileSize = numberOfBucketsConst < FOLD_MANY_TILE_SIZE ? numberOfBucketsConst : FOLD_MANY_TILE_SIZE;
+    for (uint32_t first = 0; first < numberOfBucketsConst; first += tileSize) {
+      uint8_t* __restrict__ tile = synopsis_ + first;
+      const uint32_t left = numberOfBucketsConst - first;
+      for (size_t k = 0; k < n; ++k) {
+        switch (formats[k]) {
+          case Format::NORMAL: {
+            const uint8_t* __restrict__ registers = inputs[k] + first;
+            for (uint32_t i = 0; i < tileSize; ++i) {
+              tile[i] = std::max(tile[i], registers[i]);
+            }
+            break;
+          }
+          case Format::COMPACT_6BITS:
+            unpack6Bits<Unpack>(tile, inputs[k] + first / 4 * 3, left / 4 * 3, tileSize);
+            break;
+          case Format::COMPACT_5BITS:
+            unpack5BitsWithBase<Unpack>(tile, inputs[k] + first / 8 * 5, bases[k], left / 8 * 5, tileSize);
+            break;
+          case Format::COMPACT_4BITS:
+            unpack4BitsWithBase<Unpack>(tile, inputs[k] + first / 2, bases[k], left / 2, tileSize);
+            break;
+          default:
+            throw SerializationError("foldMany() only folds the 8, 6, 5 and 4-bit formats");
+        }
+      }
+    }
+  }
+
   void serialize8Bits(uint8_t* __restrict__ byteArray) const {
     const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
     uint8_t* __restrict__ synopsis_ = this->synopsis;
@@ -425,7 +816,8 @@ public:
  * which could make the operation significantly slower.
  */
 
-  // Deserialize and add in one pass
+  // Deserialize and add in one pass, the registers Unpack doesn't do with the scalar loop
+  template<typename Unpack = ScalarUnpack>
   void fold6Bits(const uint8_t* __restrict__ byteArray, size_t length) {
     uint8_t* __restrict__ synopsis_ = this->synopsis;
     const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
@@ -435,8 +827,15 @@ public:
       throw SerializationError(err.c_str());
     }
 
+    unpack6Bits<Unpack>(synopsis_, byteArray, length, numberOfBucketsConst);
+  }
+
+  // fold6Bits() of numberOfRegisters registers, a multiple of 4, from the bytes that hold them
+  template<typename Unpack>
+  static void unpack6Bits(uint8_t* __restrict__ synopsis_, const uint8_t* __restrict__ byteArray, size_t length, uint32_t numberOfRegisters) {
+    const uint32_t unpacked = Unpack::fold6Bits(synopsis_, byteArray, length, numberOfRegisters);
     //note: LOOP VECTORIZED
-    for(uint32_t bgidx = 0; bgidx < numberOfBucketsConst/4; ++bgidx) {
+    for(uint32_t bgidx = unpacked/4; bgidx < numberOfRegisters/4; ++bgidx) {
       synopsis_[bgidx*4] = std::max(synopsis_[bgidx*4], (uint8_t)(byteArray[bgidx*3] >> 2));
       synopsis_[bgidx*4+1] = std::max(synopsis_[bgidx*4+1], (uint8_t)(((byteArray[bgidx*3] & 0x3) << 4) | (byteArray[bgidx*3+1] >> 4)));
       synopsis_[bgidx*4+2] = std::max(synopsis_[bgidx*4+2], (uint8_t)(((byteArray[bgidx*3+1] & 0xF) << 2) | (byteArray[bgidx*3+2] >> 6)));
@@ -444,6 +843,27 @@ public:
     }
   }
 
+  /**
+   * histogram() of the registers of the 6-bit format, from the bytes that
+   * hold them: they are unpacked HISTOGRAM_BLOCK_SIZE at a time into a block
+   * on the stack, which stays in L1, and counted there with Histogram, so
+   * that a serialized synopsis is estimated without a synopsis to unpack it
+   * into. length has to hold all of them.
+   */
+  template<typename Unpack, RegisterHistogram (*Histogram)(const uint8_t*, uint32_t)>
+  static RegisterHistogram histogram6Bits(const uint8_t* __restrict__ byteArray, uint32_t numberOfRegisters) {
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    uint8_t block[HISTOGRAM_BLOCK_SIZE];
+    const uint32_t blockSize = numberOfRegisters < HISTOGRAM_BLOCK_SIZE ? numberOfRegisters : HISTOGRAM_BLOCK_SIZE;
+    for (uint32_t offset = 0; offset < numberOfRegisters; offset += blockSize) {
+      memset(block, 0, blockSize);
+      unpack6Bits<Unpack>(block, byteArray + offset / 4 * 3, blockSize / 4 * 3, blockSize);
+      histogram.addCounts(Histogram(block, blockSize));
+    }
+    return histogram;
+  }
+
   void serialize6Bits(uint8_t* __restrict__ byteArray) const {
     //bgidx stands for bucket group index
     uint8_t* __restrict__ synopsis_ = this->synopsis;
@@ -469,7 +889,8 @@ public:
  * +--------+--------+--------+--------+--------+---//
  */
 
-  // Deserialize and add in one pass
+  // Deserialize and add in one pass, the registers Unpack doesn't do with the scalar loop
+  template<typename Unpack = ScalarUnpack>
   void fold5BitsWithBase(const uint8_t* __restrict__ byteArray, uint8_t base, size_t length) {
     uint8_t* __restrict__ synopsis_ = synopsis;
     const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
@@ -478,8 +899,16 @@ public:
       std::string err = std::string("Payload is not big enough for all advertised buckets [") + std::to_string(length) + " - " + std::to_string(maxExpectedSize) + "]";
       throw SerializationError(err.c_str());
     }
+    unpack5BitsWithBase<Unpack>(synopsis_, byteArray, base, length, numberOfBucketsConst);
+  }
+
+  // fold5BitsWithBase() of numberOfRegisters registers, a multiple of 8, from the bytes that hold them
+  template<typename Unpack>
+  static void unpack5BitsWithBase(uint8_t* __restrict__ synopsis_, const uint8_t* __restrict__ byteArray, uint8_t base, size_t length,
+                                  uint32_t numberOfRegisters) {
+    const uint32_t unpacked = Unpack::fold5BitsWithBase(synopsis_, byteArray, base, length, numberOfRegisters);
     // note: LOOP VECTORIZED
-    for(uint32_t bgidx = 0; bgidx < numberOfBucketsConst/8; ++bgidx) {
+    for(uint32_t bgidx = unpacked/8; bgidx < numberOfRegisters/8; ++bgidx) {
       synopsis_[bgidx*8]   = std::max(synopsis_[bgidx*8], (uint8_t) (base +   (byteArray[bgidx*5] >> 3)));
       synopsis_[bgidx*8+1] = std::max(synopsis_[bgidx*8+1], (uint8_t) (base + (((byteArray[bgidx*5]   & 0x07) << 2) | (byteArray[bgidx*5+1] >> 6))));
       synopsis_[bgidx*8+2] = std::max(synopsis_[bgidx*8+2], (uint8_t) (base +  ((byteArray[bgidx*5+1] & 0x3E) >> 1)));
@@ -491,9 +920,29 @@ public:
     }
   }
 
+  // Same as histogram6Bits() for the 5-bit format
+  template<typename Unpack, RegisterHistogram (*Histogram)(const uint8_t*, uint32_t)>
+  static RegisterHistogram histogram5BitsWithBase(const uint8_t* __restrict__ byteArray, uint8_t base, uint32_t numberOfRegisters) {
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    uint8_t block[HISTOGRAM_BLOCK_SIZE];
+    const uint32_t blockSize = numberOfRegisters < HISTOGRAM_BLOCK_SIZE ? numberOfRegisters : HISTOGRAM_BLOCK_SIZE;
+    for (uint32_t offset = 0; offset < numberOfRegisters; offset += blockSize) {
+      memset(block, 0, blockSize);
+      unpack5BitsWithBase<Unpack>(block, byteArray + offset / 8 * 5, base, blockSize / 8 * 5, blockSize);
+      histogram.addCounts(Histogram(block, blockSize));
+    }
+    return histogram;
+  }
+
   uint8_t serialize5BitsWithBase(uint8_t* __restrict__ byteArray) const {
     uint8_t base = *std::min_element(synopsis, synopsis + this->getNumberOfBuckets());
+    serialize5BitsWithBase(byteArray, base);
+    return base;
+  }
 
+  // base has to be the smallest register, e.g. from histogram().minValue()
+  void serialize5BitsWithBase(uint8_t* __restrict__ byteArray, uint8_t base) const {
     // we iterate over groups of 8 buckets
     const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
     uint8_t buckets[8];
@@ -514,7 +963,6 @@ public:
       byteArray[bgidx*5+3] = (buckets[4] << 7) | (buckets[5] << 2) | (buckets[6] >> 3);
       byteArray[bgidx*5+4] = (buckets[6] << 5) | (buckets[7]);
     }
-    return base;
   }
 
 /*
@@ -523,7 +971,8 @@ public:
  * +--------+--------+---//
  */
 
-  // Deserialize and add in one pass
+  // Deserialize and add in one pass, the registers Unpack doesn't do with the scalar loop
+  template<typename Unpack = ScalarUnpack>
   void fold4BitsWithBase(const uint8_t* __restrict__ byteArray, uint8_t base, size_t length) {
     uint8_t* __restrict__ synopsis_ = synopsis;
     const uint32_t numberOfBucketsConst = this->getNumberOfBuckets();
@@ -533,8 +982,16 @@ public:
       throw SerializationError(err.c_str());
     }
 
+    unpack4BitsWithBase<Unpack>(synopsis_, byteArray, base, length, numberOfBucketsConst);
+  }
+
+  // fold4BitsWithBase() of numberOfRegisters registers, a multiple of 2, from the bytes that hold them
+  template<typename Unpack>
+  static void unpack4BitsWithBase(uint8_t* __restrict__ synopsis_, const uint8_t* __restrict__ byteArray, uint8_t base, size_t length,
+                                  uint32_t numberOfRegisters) {
+    const uint32_t unpacked = Unpack::fold4BitsWithBase(synopsis_, byteArray, base, length, numberOfRegisters);
     // note: LOOP VECTORIZED
-    for(uint32_t bgidx = 0; bgidx < numberOfBucketsConst/2; ++bgidx) {
+    for(uint32_t bgidx = unpacked/2; bgidx < numberOfRegisters/2; ++bgidx) {
       synopsis_[bgidx*2]   = std::max(synopsis_[bgidx*2], (uint8_t) (base + (byteArray[bgidx] >> 4)));
       synopsis_[bgidx*2+1] = std::max(synopsis_[bgidx*2+1], (uint8_t) (base + (byteArray[bgidx] & 0x0f)));
     }
@@ -542,7 +999,12 @@ public:
 
   uint8_t serialize4BitsWithBase(uint8_t* __restrict__ byteArray) const {
     uint8_t base = *std::min_element(synopsis, synopsis + this->getNumberOfBuckets());
+    serialize4BitsWithBase(byteArray, base);
+    return base;
+  }
 
+  // base has to be the smallest register, e.g. from histogram().minValue()
+  void serialize4BitsWithBase(uint8_t* __restrict__ byteArray, uint8_t base) const {
     const uint8_t maxValIn4Bits = ((1<<4)-1); // max value fitting 4 bits
     // we iterate over pairs of buckets
 
@@ -559,8 +1021,138 @@ public:
 
       byteArray[bgidx] = (normBucket1 << 4) | normBucket2;
     }
-    return base;
   }
 };
 
+template<typename T, typename H, uint8_t P>
+constexpr double HllRaw<T, H, P>::betaConstants[][HllRaw<T, H, P>::nCoefficients];
+
+template<typename T, typename H, uint8_t P>
+constexpr double HllRaw<T, H, P>::alphaConstants[];
+
+/**
+ * Table of HllRaw's register loops instantiated for a fixed precision.
+ * Callers pick the entry for their precision once (e.g. in the UDx setup())
+ * and go through it for every block, so that the loops run with constant
+ * masks and trip counts without having to template the callers on precision.
+ */
+template<typename T, typename H = MurMurHash<T> >
+struct HllKernels {
+  uint8_t precision;
+
+  RegisterHistogram (*histogram)(const uint8_t* synopsis);
+  RegisterHistogram (*histogram6Bits)(const uint8_t* byteArray);
+  RegisterHistogram (*histogram5BitsWithBase)(const uint8_t* byteArray, uint8_t base);
+  // JointRegisterHistogram of the registers of two synopses of this precision
+  JointRegisterHistogram (*jointHistogram)(const uint8_t* synopsis, const uint8_t* other);
+  uint64_t (*estimate)(const uint8_t* synopsis);
+  uint64_t (*betaEstimate)(const uint8_t* synopsis);
+  uint32_t (*emptyBucketsCount)(const uint8_t* synopsis);
+  uint64_t (*getNumberOfSetBuckets)(const uint8_t* synopsis);
+  uint64_t (*sparseVarintSize)(const uint8_t* synopsis, uint8_t threshold);
+  void (*merge)(uint8_t* synopsis, const uint8_t* otherSynopsis);
+  void (*addBatch)(uint8_t* synopsis, const T* values, size_t n, uint32_t hashSeed);
+  void (*addHashes)(uint8_t* synopsis, const uint64_t* hashes, size_t n);
+
+  void (*fold8BitsSparse)(uint8_t* synopsis, const uint8_t* byteArray, uint16_t setBuckets, size_t length);
+  void (*fold8BitsSparseVarint)(uint8_t* synopsis, const uint8_t* byteArray, size_t length);
+  void (*fold8Bits)(uint8_t* synopsis, const uint8_t* byteArray, size_t length);
+  void (*fold6Bits)(uint8_t* synopsis, const uint8_t* byteArray, size_t length);
+  void (*fold5BitsWithBase)(uint8_t* synopsis, const uint8_t* byteArray, uint8_t base, size_t length);
+  void (*fold4BitsWithBase)(uint8_t* synopsis, const uint8_t* byteArray, uint8_t base, size_t length);
+  void (*foldEntropy)(uint8_t* synopsis, const uint8_t* byteArray, uint8_t center, size_t length);
+  void (*foldDown)(uint8_t* synopsis, const uint8_t* higher, uint8_t higherPrecision);
+  void (*foldMany)(uint8_t* synopsis, const uint8_t* const* inputs, const Format* formats, const uint8_t* bases, size_t n);
+
+  uint16_t (*serialize8BitsSparse)(const uint8_t* synopsis, uint8_t* byteArray);
+  uint64_t (*serialize8BitsSparseVarint)(const uint8_t* synopsis, uint8_t* byteArray, uint8_t threshold);
+  void (*serialize8Bits)(const uint8_t* synopsis, uint8_t* byteArray);
+  void (*serialize6Bits)(const uint8_t* synopsis, uint8_t* byteArray);
+  void (*serialize5BitsWithBase)(const uint8_t* synopsis, uint8_t* byteArray, uint8_t base);
+  void (*serialize4BitsWithBase)(const uint8_t* synopsis, uint8_t* byteArray, uint8_t base);
+  uint64_t (*serializeEntropy)(const uint8_t* synopsis, uint8_t* byteArray, uint8_t center);
+
+  /**
+   * Kernels of the given precision, compiled for the given instruction set.
+   * It defaults to the best one the CPU supports.
+   */
+  static const HllKernels& forPrecision(uint8_t precision, CpuIsa isa = hostCpuIsa());
+
+private:
+  template<CpuIsa I>
+  static const HllKernels* forIsa(uint8_t precision);
+};
+
+/**
+ * Thunks from HllKernels to HllRaw<T, H, P>, one set per instruction set I.
+ * Each set is stamped out by hll_kernels_isa.hpp with its own target attribute.
+ */
+template<typename T, typename H, uint8_t P, CpuIsa I>
+struct HllFixedPrecisionKernels;
+
+#define HLL_KERNELS_ISA CpuIsa::DEFAULT
+#define HLL_KERNELS_UNPACK ScalarUnpack
+#define HLL_KERNELS_HISTOGRAM of
+#define HLL_KERNELS_TARGET
+#include "hll_kernels_isa.hpp"
+
+#define HLL_KERNELS_ISA CpuIsa::SSE42
+#define HLL_KERNELS_UNPACK Ssse3Unpack
+#define HLL_KERNELS_HISTOGRAM of
+#define HLL_KERNELS_TARGET __target_isa__("sse4.2,popcnt") __attribute__((flatten))
+#include "hll_kernels_isa.hpp"
+
+#define HLL_KERNELS_ISA CpuIsa::AVX2
+#define HLL_KERNELS_UNPACK Avx2Unpack
+#define HLL_KERNELS_HISTOGRAM ofAvx2
+#define HLL_KERNELS_TARGET __target_isa__("avx2,bmi,bmi2,lzcnt,popcnt") __attribute__((flatten))
+#include "hll_kernels_isa.hpp"
+
+#define HLL_KERNELS_ISA CpuIsa::AVX512
+#define HLL_KERNELS_UNPACK Avx2Unpack
+#define HLL_KERNELS_HISTOGRAM ofAvx512
+#define HLL_KERNELS_TARGET __target_isa__("avx512f,avx512bw,avx512dq,avx512vl,avx2,bmi,bmi2,lzcnt,popcnt,prefer-vector-width=512") __attribute__((flatten))
+#include "hll_kernels_isa.hpp"
+
+template<typename T, typename H>
+template<CpuIsa I>
+const HllKernels<T, H>* HllKernels<T, H>::forIsa(uint8_t precision) {
+  // constant-initialized, so looking up the table costs nothing on the first call either
+  static const HllKernels<T, H> table[] = {
+    HllFixedPrecisionKernels<T, H, 4, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 5, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 6, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 7, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 8, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 9, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 10, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 11, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 12, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 13, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 14, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 15, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 16, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 17, I>::kernels(),
+    HllFixedPrecisionKernels<T, H, 18, I>::kernels()
+  };
+  return &table[precision - 4];
+}
+
+template<typename T, typename H>
+const HllKernels<T, H>& HllKernels<T, H>::forPrecision(uint8_t precision, CpuIsa isa) {
+  if (!(precision >= 4 && precision <= 18)) {
+    throw SerializationError("precision has to be between 4 and 18");
+  }
+  switch (isa) {
+    case CpuIsa::AVX512:
+      return *forIsa<CpuIsa::AVX512>(precision);
+    case CpuIsa::AVX2:
+      return *forIsa<CpuIsa::AVX2>(precision);
+    case CpuIsa::SSE42:
+      return *forIsa<CpuIsa::SSE42>(precision);
+    default:
+      return *forIsa<CpuIsa::DEFAULT>(precision);
+  }
+}
+
 #endif
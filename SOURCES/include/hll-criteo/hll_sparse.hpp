@@ -0,0 +1,337 @@
+#ifndef _HLL_SPARSE_H_
+#define _HLL_SPARSE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#include "hll_raw.hpp"
+#include "register_histogram.hpp"
+#include "../hll_utils.hpp"
+
+/**
+ * Sparse representation of HyperLogLog++ (Heule, Nunkesser, Hall, "HyperLogLog
+ * in Practice", section 5.3). It lives in the buffer of the dense registers, so
+ * that an intermediate aggregate can start sparse and become dense in place.
+ *
+ * Every hash is kept as one entry at precision PRECISION = 25: its bucket at
+ * that precision and the position of the leftmost 1 in the 39 remaining bits,
+ *
+ *   entry = index' << 6 | rho'
+ *
+ * from which the register of the hash at any precision p <= 25 follows. Sorted
+ * entries are stored as varint-encoded deltas after a small header. New entries
+ * are appended unsorted to a temporary area at the end of the buffer and merged
+ * into the list when it is full. When the list no longer leaves room for the
+ * next merge, the registers have to be made dense with toDense(). Neither
+ * allocates: both rewrite the buffer in place.
+ *
+ * +--------+------------------------//------+------//------+--------------------+
+ * | Header | varint deltas of sorted entries |     free     | unsorted uint32_t |
+ * +--------+------------------------//------+------//------+--------------------+
+ *  12 bytes                                                 2^p / 8 bytes
+ *
+ * Estimates of a sparse synopsis are taken at precision 25, but only while it
+ * is in memory: it is written with the registers at its own precision.
+ */
+class HllSparse {
+public:
+  static const uint8_t PRECISION = 25;
+  // below it the header and the temporary area leave little room for the list
+  static const uint8_t MIN_PRECISION = 8;
+  // values are hashed in chunks of this size before they are added
+  static const size_t HASH_CHUNK_SIZE = 64;
+
+  HllSparse(uint8_t precision, uint8_t* payload) : precision(precision), payload(payload) {}
+
+  void reset() {
+    memset(payload, 0, sizeof(Header));
+  }
+
+  static uint32_t entry(uint64_t hash) {
+    const uint64_t rest = hash << PRECISION;
+    const uint32_t rho = rest == 0 ? 64 - PRECISION + 1 : __builtin_clzll(rest) + 1;
+    return static_cast<uint32_t>(hash >> (64 - PRECISION)) << RHO_BITS | rho;
+  }
+
+  /**
+   * Returns false, leaving the entries as they are, when there is no room
+   * left for the entry. The caller then has to call toDense() and add it
+   * there.
+   */
+  bool add(uint32_t entry) {
+    // compact() needs MAX_VARINT_BYTES of room in the list per temporary entry
+    if (header().tmpEntries == tmpCapacity()
+        || header().listBytes + MAX_VARINT_BYTES * (header().tmpEntries + 1) > listCapacity()) {
+      compact();
+      if (header().listBytes + MAX_VARINT_BYTES * tmpCapacity() > listCapacity()) {
+        return false;
+      }
+    }
+    memcpy(tmpArea() + header().tmpEntries * sizeof(uint32_t), &entry, sizeof(uint32_t));
+    ++header().tmpEntries;
+    return true;
+  }
+
+  /**
+   * Checks that a sparse payload of the given length, e.g. an intermediate
+   * aggregate of another node, can be read without going out of bounds.
+   */
+  void validate(size_t length) const {
+    if (length < capacity()) {
+      throw SerializationError("Payload is not big enough for a sparse synopsis");
+    }
+    const Header& hdr = header();
+    if (hdr.listBytes > listCapacity() || hdr.tmpEntries > tmpCapacity()
+        || hdr.listBytes + MAX_VARINT_BYTES * hdr.tmpEntries > listCapacity()) {
+      throw SerializationError("Sparse synopsis header is not valid");
+    }
+  }
+
+  // Max of the registers and the ones of the entries, the registers being at the precision of the synopsis
+  void foldTo(uint8_t* __restrict__ registers) const {
+    forEachEntry([this, registers](uint32_t entry) {
+      const uint32_t idx = bucket(entry);
+      registers[idx] = std::max(registers[idx], value(entry));
+    });
+  }
+
+  // Calls f on every entry, in no particular order and possibly more than once per index'
+  template<typename F>
+  void forEachEntry(F f) const {
+    const uint8_t* in = list();
+    const uint8_t* end = in + header().listBytes;
+    uint32_t entry = 0;
+    while (in < end) {
+      uint32_t delta;
+      if (!read_varint(in, end, delta)) {
+        throw SerializationError("Sparse synopsis entry is not valid");
+      }
+      entry += delta;
+      if (entry >> (RHO_BITS + PRECISION) != 0) {
+        throw SerializationError("Sparse synopsis entry is not valid");
+      }
+      f(entry);
+    }
+    for (uint32_t i = 0; i < header().tmpEntries; ++i) {
+      uint32_t tmpEntry;
+      memcpy(&tmpEntry, tmpArea() + i * sizeof(uint32_t), sizeof(uint32_t));
+      if (tmpEntry >> (RHO_BITS + PRECISION) != 0) {
+        throw SerializationError("Sparse synopsis entry is not valid");
+      }
+      f(tmpEntry);
+    }
+  }
+
+  /**
+   * Turns the payload into the dense registers of the same entries, in place.
+   * Once the temporary area is merged, the list is written again from the
+   * start of the payload with one varint per set register, its gap to the
+   * previous one << 6 | its value. That takes no more bytes than the first
+   * entry of the register did, so it never catches up with the entries still
+   * to be read, and no more than the gap itself, so that the registers
+   * written from the last one down never reach a varint still to be read.
+   */
+  void toDense() {
+    compact();
+    uint8_t* out = payload;
+    uint32_t lastBucket = 0;
+    forEachRegister([&out, &lastBucket](uint32_t idx, uint8_t registerValue) {
+      out += write_varint(out, (idx - lastBucket) << RHO_BITS | registerValue);
+      lastBucket = idx;
+    });
+
+    uint32_t idx = lastBucket;
+    uint32_t zeroFrom = capacity();
+    const uint8_t* at = out;
+    while (at > payload) {
+      // varints end with the only byte below 0x80
+      const uint8_t* start = at - 1;
+      while (start > payload && start[-1] >= 0x80) {
+        --start;
+      }
+      uint32_t coded;
+      const uint8_t* in = start;
+      read_varint(in, at, coded);
+      memset(payload + idx + 1, 0, zeroFrom - idx - 1);
+      payload[idx] = coded & RHO_MASK;
+      zeroFrom = idx;
+      idx -= coded >> RHO_BITS;
+      at = start;
+    }
+    memset(payload, 0, zeroFrom);
+  }
+
+  // Histogram of the registers toDense() would give
+  RegisterHistogram histogram() {
+    compact();
+    RegisterHistogram histogram;
+    histogram.reset(capacity());
+    uint32_t setRegisters = 0;
+    forEachRegister([&histogram, &setRegisters](uint32_t, uint8_t registerValue) {
+      ++histogram.counts[RegisterHistogram::bin(registerValue)];
+      ++setRegisters;
+    });
+    histogram.counts[0] = capacity() - setRegisters;
+    return histogram;
+  }
+
+  /**
+   * Linear counting over the 2^25 buckets of the entries. Far below 2^25
+   * distinct values, which the sparse list never reaches, it is almost exact.
+   */
+  uint64_t estimate() {
+    compact();
+    const double m = 1UL << PRECISION;
+    const double setBuckets = header().listEntries;
+    return std::llround(m * std::log(m / (m - setBuckets)));
+  }
+
+private:
+  static const uint8_t RHO_BITS = 6;
+  static const uint32_t RHO_MASK = (1 << RHO_BITS) - 1;
+  static const uint32_t MAX_VARINT_BYTES = 5;
+
+  struct Header {
+    uint32_t listEntries;
+    uint32_t listBytes;
+    uint32_t tmpEntries;
+  } __packed__;
+
+  uint8_t precision;
+  uint8_t* payload;
+
+  Header& header() {
+    return *reinterpret_cast<Header*>(payload);
+  }
+
+  const Header& header() const {
+    return *reinterpret_cast<const Header*>(payload);
+  }
+
+  uint32_t capacity() const {
+    return 1U << precision;
+  }
+
+  uint32_t tmpCapacity() const {
+    return capacity() / 8 / sizeof(uint32_t);
+  }
+
+  uint32_t listCapacity() const {
+    return capacity() - sizeof(Header) - tmpCapacity() * sizeof(uint32_t);
+  }
+
+  uint8_t* list() const {
+    return payload + sizeof(Header);
+  }
+
+  uint8_t* tmpArea() const {
+    return payload + capacity() - tmpCapacity() * sizeof(uint32_t);
+  }
+
+  uint32_t bucket(uint32_t entry) const {
+    return entry >> (RHO_BITS + PRECISION - precision);
+  }
+
+  // register of the entry at the precision of the synopsis
+  uint8_t value(uint32_t entry) const {
+    const uint8_t extraBits = PRECISION - precision;
+    const uint32_t extra = (entry >> RHO_BITS) & ((1U << extraBits) - 1);
+    if (extra != 0) {
+      return __builtin_clz(extra) - (32 - extraBits) + 1;
+    }
+    return extraBits + (entry & RHO_MASK);
+  }
+
+  // Reads the entry after entry in the list, returns false at its end
+  static bool nextListEntry(const uint8_t*& in, const uint8_t* end, uint32_t& entry) {
+    if (in == end) {
+      return false;
+    }
+    uint32_t delta;
+    if (!read_varint(in, end, delta) || (entry + delta) >> (RHO_BITS + PRECISION) != 0) {
+      throw SerializationError("Sparse synopsis entry is not valid");
+    }
+    entry += delta;
+    return true;
+  }
+
+  /**
+   * Calls f(bucket, value) on every set register, by increasing bucket, from
+   * the list alone: compact() first. f is only called once the list has been
+   * read past the entries of the register.
+   */
+  template<typename F>
+  void forEachRegister(F f) const {
+    const uint8_t* in = list();
+    const uint8_t* const end = in + header().listBytes;
+    uint32_t entry = 0;
+    bool more = nextListEntry(in, end, entry);
+    while (more) {
+      const uint32_t idx = bucket(entry);
+      uint8_t registerValue = value(entry);
+      while ((more = nextListEntry(in, end, entry)) && bucket(entry) == idx) {
+        registerValue = std::max(registerValue, value(entry));
+      }
+      f(idx, registerValue);
+    }
+  }
+
+  /**
+   * Merges the temporary area into the list, in place: the list is moved to
+   * the end of the room it has and the merged entries are written from its
+   * start. An entry of the temporary area adds at most MAX_VARINT_BYTES to
+   * the list, the others take no more bytes than they did, and add() keeps
+   * that much room per entry, so the merged entries never catch up with the
+   * ones still to be read.
+   */
+  void compact() {
+    Header& hdr = header();
+    uint32_t* tmp = reinterpret_cast<uint32_t*>(tmpArea());
+    const uint32_t* const tmpEnd = tmp + hdr.tmpEntries;
+    std::sort(tmp, tmp + hdr.tmpEntries);
+    if (hdr.tmpEntries > 0 && tmpEnd[-1] >> (RHO_BITS + PRECISION) != 0) {
+      throw SerializationError("Sparse synopsis entry is not valid");
+    }
+
+    const uint32_t room = listCapacity() - hdr.listBytes;
+    memmove(list() + room, list(), hdr.listBytes);
+    const uint8_t* in = list() + room;
+    const uint8_t* const end = in + hdr.listBytes;
+    uint32_t listEntry = 0;
+    bool listLeft = nextListEntry(in, end, listEntry);
+
+    uint8_t* out = list();
+    uint32_t count = 0;
+    uint32_t previous = 0;
+    uint32_t pending = 0;
+    bool hasPending = false;
+    while (listLeft || tmp != tmpEnd) {
+      uint32_t next;
+      if (listLeft && (tmp == tmpEnd || listEntry <= *tmp)) {
+        next = listEntry;
+        listLeft = nextListEntry(in, end, listEntry);
+      } else {
+        next = *tmp++;
+      }
+      // equal indexes come one after the other, the last one has the largest rho'
+      if (hasPending && pending >> RHO_BITS != next >> RHO_BITS) {
+        out += write_varint(out, pending - previous);
+        previous = pending;
+        ++count;
+      }
+      pending = next;
+      hasPending = true;
+    }
+    if (hasPending) {
+      out += write_varint(out, pending - previous);
+      ++count;
+    }
+    hdr.listEntries = count;
+    hdr.listBytes = out - list();
+    hdr.tmpEntries = 0;
+  }
+};
+
+#endif
@@ -7,10 +7,39 @@
 #define HLL_ARRAY_SIZE_PARAMETER_NAME "hllLeadingBits"
 #define HLL_ARRAY_SIZE_DEFAULT_VALUE 12
 #define HLL_ARRAY_SIZE_MIN_VALUE 1
-#define HLL_ARRAY_SIZE_MAX_VALUE 16
+#define HLL_ARRAY_SIZE_MAX_VALUE 18
 
 #define HLL_BITS_PER_BUCKET_PARAMETER_NAME "bitsPerBucket"
 #define HLL_BITS_PER_BUCKET_DEFAULT_VALUE 6
+// bitsPerBucket value asking for the smallest format that keeps every register
+#define HLL_BITS_PER_BUCKET_AUTO_VALUE 0
+// bitsPerBucket value asking for the entropy coded format, about 3 bits per bucket, slower to fold
+#define HLL_BITS_PER_BUCKET_ENTROPY_VALUE 3
+
+#define HLL_CHECKSUM_PARAMETER_NAME "checksum"
+#define HLL_CHECKSUM_DEFAULT_VALUE false
+
+// One of the HashFunction names: murmur, xxh3 or mix64
+#define HLL_HASH_FUNCTION_PARAMETER_NAME "hashFunction"
+#define HLL_HASH_FUNCTION_DEFAULT_VALUE "murmur"
+
+// Number of rows of the sliding window of HllRollingDistinctCount, 0 for a running count
+#define HLL_WINDOW_ROWS_PARAMETER_NAME "windowRows"
+#define HLL_WINDOW_ROWS_DEFAULT_VALUE 0
+#define HLL_WINDOW_ROWS_MAX_VALUE 1000
+// The window takes (windowRows + 2) * (2^hllLeadingBits + 24) bytes per function instance, reused
+// from one partition to the next: windowRows is also bounded to keep it below this, 253 rows at 18 bits
+#define HLL_WINDOW_BUFFER_MAX_BYTES (64 << 20)
+
+// Number of rows between two estimates of HllRunningCount
+#define HLL_EMIT_EVERY_PARAMETER_NAME "emitEvery"
+#define HLL_EMIT_EVERY_DEFAULT_VALUE 1
+
+// Number of rows read from a block before they are added to the synopsis at once
+#define HLL_ADD_BATCH_SIZE 1024
+
+// Number of synopses read from a block before they are folded into the synopsis at once
+#define HLL_FOLD_BATCH_SIZE 64
 
 using namespace Vertica;
 using HLL = Hll<uint64_t>;
@@ -18,6 +47,53 @@ using HLL = Hll<uint64_t>;
 
 Format formatCodeToEnum(uint8_t f);
 int readSubStreamBits(ServerInterface &srvInterface);
+const HllKernels<uint64_t>& selectKernels(int hllLeadingBits);
 Format readSerializationFormat(ServerInterface &srvInterface);
+bool readChecksum(ServerInterface &srvInterface);
+const HashFunction& readHashFunction(ServerInterface &srvInterface);
+uint32_t readWindowRows(ServerInterface &srvInterface, uint8_t precision);
+vint readEmitEvery(ServerInterface &srvInterface);
+const char* formatName(Format format);
+
+/**
+ * Folds the synopses of the first column of reader, a BlockReader or the
+ * MultipleIntermediateAggs of combine(), from its current row to the last,
+ * HLL_FOLD_BATCH_SIZE at a time with Hll::foldMany(). foldScratch holds
+ * getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE) bytes allocated in
+ * setup(), for the synopses of a higher precision (see Hll::setFoldScratch()).
+ */
+template<typename Reader>
+void foldAll(HllView<uint64_t>& hll, Reader& reader, uint8_t* foldScratch) {
+  hll.setFoldScratch(foldScratch, HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
+  const uint8_t* synopses[HLL_FOLD_BATCH_SIZE];
+  size_t lengths[HLL_FOLD_BATCH_SIZE];
+  size_t count = 0;
+  do {
+    synopses[count] = reinterpret_cast<const uint8_t *>(reader.getStringRef(0).data());
+    lengths[count++] = reader.getStringRef(0).length();
+    if (count == HLL_FOLD_BATCH_SIZE) {
+      hll.foldMany(synopses, lengths, count);
+      count = 0;
+    }
+  } while (reader.next());
+  hll.foldMany(synopses, lengths, count);
+}
+
+/**
+ * Number of synopses an aggregate function instance wrote in each format.
+ * It goes to the UDx log when the instance is destroyed, which shows what
+ * bitsPerBucket=0 ends up picking for a query.
+ */
+class FormatCounter {
+  static const size_t NUMBER_OF_FORMATS = static_cast<size_t>(Format::AUTO) + 1;
+  vint counts[NUMBER_OF_FORMATS] = {};
+
+public:
+  void count(Format format) {
+    ++counts[static_cast<size_t>(format)];
+  }
+
+  void log(ServerInterface &srvInterface, const char* functionName) const;
+};
 
 #endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+#ifndef _HLL_WINDOW_H_
+#define _HLL_WINDOW_H_
+
+#include <stdint.h>
+
+#include "hll.hpp"
+
+/**
+ * Union of the last rows synopses of a sequence, e.g. the daily synopses of
+ * a 7 or 30-day window, as it slides one synopsis at a time. It is the
+ * two-stack queue of sliding window aggregation: the older synopses of the
+ * window (the front) hold the union of themselves and of every newer one of
+ * the front, the newer ones (the back) are kept as they are, along with their
+ * union. The union of the window is that of the oldest synopsis of the front
+ * and of the back. When the oldest synopsis of the window leaves it and the
+ * front is empty, the back becomes the front, its synopses turned into those
+ * unions in place, newest first. Each synopsis is folded into the back once
+ * and into an older one once, and an estimate takes the union of two of them,
+ * however large the window, instead of the whole window being folded again
+ * for every row.
+ *
+ * All synopses live in a buffer of getBufferSize() the caller allocates, as
+ * dense registers of the same precision, the payloads of a higher precision
+ * folded down as fold() does. rows = 0 is a window that never slides, the
+ * running union from the first synopsis.
+ *
+ * +------+--------+---------------------//-------------------+
+ * | back | result | rows synopses, a ring from the oldest one |
+ * +------+--------+---------------------//-------------------+
+ */
+template<typename T, typename H = MurMurHash<T> >
+class HllWindow {
+
+  const HllKernels<T, H>* kernels;
+  uint8_t* buffer;
+  size_t synopsisSize;
+  uint32_t rows;
+  // index in the ring of the oldest synopsis of the window
+  uint32_t oldest;
+  uint32_t size;
+  // the size oldest synopses of the window that are in the front
+  uint32_t frontSize;
+  uint8_t* foldScratch;
+  size_t foldScratchLength;
+
+  Hll<T, H> synopsis(uint8_t* payload) {
+    Hll<T, H> hll(*kernels, payload);
+    hll.setFoldScratch(foldScratch, foldScratchLength);
+    return hll;
+  }
+
+  Hll<T, H> back() {
+    return synopsis(buffer);
+  }
+
+  Hll<T, H> result() {
+    return synopsis(buffer + synopsisSize);
+  }
+
+  // i-th synopsis of the window, from the oldest one
+  Hll<T, H> slot(uint32_t i) {
+    return synopsis(buffer + (2 + (oldest + i) % rows) * synopsisSize);
+  }
+
+  // The back becomes the front, each of its synopses the union of itself and the newer ones
+  void flip() {
+    for (uint32_t i = size - 1; i > 0; --i) {
+      slot(i - 1).add(slot(i));
+    }
+    frontSize = size;
+    back().reset();
+  }
+
+public:
+  static size_t getBufferSize(uint8_t precision, uint32_t rows) {
+    return (2 + rows) * Hll<T, H>::getMaxDeserializedBufferSize(precision);
+  }
+
+  // Largest rows whose getBufferSize() at the given precision is at most bufferSize
+  static uint32_t getMaxRows(uint8_t precision, size_t bufferSize) {
+    const size_t synopses = bufferSize / Hll<T, H>::getMaxDeserializedBufferSize(precision);
+    return synopses < 2 ? 0 : synopses - 2;
+  }
+
+  HllWindow(const HllKernels<T, H>& kernels, uint8_t* buffer, uint32_t rows) :
+    kernels(&kernels),
+    buffer(buffer),
+    synopsisSize(Hll<T, H>::getMaxDeserializedBufferSize(kernels.precision)),
+    rows(rows),
+    oldest(0),
+    size(0),
+    frontSize(0),
+    foldScratch(nullptr),
+    foldScratchLength(0) {}
+
+  // Scratch for the synopses of a higher precision pushed into the window, see Hll::setFoldScratch()
+  void setFoldScratch(uint8_t* buffer, size_t length) {
+    foldScratch = buffer;
+    foldScratchLength = length;
+  }
+
+  // Empties the window, e.g. at the start of a partition
+  void reset() {
+    oldest = 0;
+    size = 0;
+    frontSize = 0;
+    back().reset();
+  }
+
+  /**
+   * Adds the next synopsis in a payload serialize() wrote, nullptr for a row
+   * without one, which still takes its place in the window. The oldest
+   * synopsis leaves the window if it is full.
+   */
+  void push(const uint8_t* byteArray, size_t length) {
+    if (rows == 0) {
+      if (byteArray != nullptr) {
+        back().fold(byteArray, length);
+      }
+      return;
+    }
+    if (size == rows) {
+      if (frontSize == 0) {
+        flip();
+      }
+      oldest = (oldest + 1) % rows;
+      --size;
+      --frontSize;
+    }
+    Hll<T, H> newest = slot(size++);
+    newest.reset();
+    if (byteArray != nullptr) {
+      newest.fold(byteArray, length);
+      back().add(newest);
+    }
+  }
+
+  // Estimate of the union of the synopses in the window, written to the result synopsis of the buffer
+  uint64_t approximateCountDistinct() {
+    if (frontSize == 0) {
+      return back().approximateCountDistinct();
+    }
+    Hll<T, H> windowUnion = result();
+    windowUnion.reset();
+    windowUnion.add(slot(0));
+    windowUnion.add(back());
+    return windowUnion.approximateCountDistinct();
+  }
+};
+
+#endif
@@ -0,0 +1,485 @@
+#ifndef _JOINT_ESTIMATE_H_
+#define _JOINT_ESTIMATE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "register_histogram.hpp"
+#include "../hll_utils.hpp"
+
+/**
+ * Counts of the register pairs of two synopses A and B of the same precision,
+ * by value and by how the two registers compare: for each relation, the
+ * registers of A holding k in first and the registers of B holding k in
+ * second. The histograms of A, B and their union all derive from it.
+ */
+struct JointRegisterHistogram {
+  static const uint8_t MAX_VALUE = RegisterHistogram::MAX_VALUE;
+  static const uint8_t EQUAL = 0;
+  static const uint8_t FIRST_ABOVE = 1;
+  static const uint8_t FIRST_BELOW = 2;
+
+  uint32_t first[3][MAX_VALUE + 1];
+  uint32_t second[3][MAX_VALUE + 1];
+  uint32_t numberOfRegisters;
+
+  /**
+   * One pass over both synopses. The relation of a pair indexes the tables,
+   * so that it takes no branch; equal pairs are counted in second as well,
+   * where nothing reads them.
+   */
+  static JointRegisterHistogram of(const uint8_t* __restrict__ synopsis, const uint8_t* __restrict__ other,
+                                   uint32_t numberOfRegisters) {
+    JointRegisterHistogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    histogram.numberOfRegisters = numberOfRegisters;
+    for (uint32_t i = 0; i < numberOfRegisters; ++i) {
+      const uint8_t k1 = RegisterHistogram::bin(synopsis[i]);
+      const uint8_t k2 = RegisterHistogram::bin(other[i]);
+      const uint8_t relation = (k1 > k2) * FIRST_ABOVE + (k1 < k2) * FIRST_BELOW;
+      ++histogram.first[relation][k1];
+      ++histogram.second[relation][k2];
+    }
+    return histogram;
+  }
+
+#if defined(__x86_64__)
+  /**
+   * Same as of(), a block of at most 4 KB of both synopses at a time, as
+   * RegisterHistogram::ofAvx2() does: the block is scanned once for its
+   * smallest and largest register, then once per value k in between, 32
+   * pairs at a time. The registers of A holding k, those of them whose
+   * register of B is k as well and those whose register of B is below it,
+   * and the same for B, give all six counts of k. Registers are binned with
+   * a min first, so that they compare as they do in of().
+   */
+  __target_isa__("avx2")
+  static JointRegisterHistogram ofAvx2(const uint8_t* __restrict__ synopsis, const uint8_t* __restrict__ other,
+                                       uint32_t numberOfRegisters) {
+    if (numberOfRegisters < sizeof(__m256i)) {
+      return of(synopsis, other, numberOfRegisters);
+    }
+    JointRegisterHistogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    histogram.numberOfRegisters = numberOfRegisters;
+    const __m256i maxValue = _mm256_set1_epi8(MAX_VALUE);
+    // each byte lane counts up to 128 matches, they are summed once per block
+    const uint32_t BLOCK_SIZE = 128 * sizeof(__m256i);
+    for (uint32_t offset = 0; offset < numberOfRegisters; offset += BLOCK_SIZE) {
+      const uint32_t vectors = std::min(numberOfRegisters - offset, BLOCK_SIZE) / sizeof(__m256i);
+      const __m256i* firstBlock = reinterpret_cast<const __m256i*>(synopsis + offset);
+      const __m256i* secondBlock = reinterpret_cast<const __m256i*>(other + offset);
+
+      __m256i low = _mm256_set1_epi8(-1);
+      __m256i high = _mm256_setzero_si256();
+      for (uint32_t i = 0; i < vectors; ++i) {
+        const __m256i a = _mm256_loadu_si256(firstBlock + i);
+        const __m256i b = _mm256_loadu_si256(secondBlock + i);
+        low = _mm256_min_epu8(low, _mm256_min_epu8(a, b));
+        high = _mm256_max_epu8(high, _mm256_max_epu8(a, b));
+      }
+      uint8_t lows[sizeof(__m256i)], highs[sizeof(__m256i)];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(lows), _mm256_min_epu8(low, maxValue));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(highs), _mm256_min_epu8(high, maxValue));
+      const uint8_t lowest = *std::min_element(lows, lows + sizeof(lows));
+      const uint8_t highest = *std::max_element(highs, highs + sizeof(highs));
+
+      for (uint8_t k = lowest; k <= highest; ++k) {
+        const __m256i key = _mm256_set1_epi8(k);
+        // x < k is min(x, k - 1) == x, and nothing is below 0
+        const __m256i belowKey = _mm256_set1_epi8(k - 1);
+        const __m256i anyBelow = _mm256_set1_epi8(k == 0 ? 0 : -1);
+        __m256i firstEqual = _mm256_setzero_si256();
+        __m256i secondEqual = _mm256_setzero_si256();
+        __m256i bothEqual = _mm256_setzero_si256();
+        __m256i firstAbove = _mm256_setzero_si256();
+        __m256i secondAbove = _mm256_setzero_si256();
+        for (uint32_t i = 0; i < vectors; ++i) {
+          const __m256i a = _mm256_min_epu8(_mm256_loadu_si256(firstBlock + i), maxValue);
+          const __m256i b = _mm256_min_epu8(_mm256_loadu_si256(secondBlock + i), maxValue);
+          const __m256i aIsKey = _mm256_cmpeq_epi8(a, key);
+          const __m256i bIsKey = _mm256_cmpeq_epi8(b, key);
+          const __m256i aBelow = _mm256_and_si256(anyBelow, _mm256_cmpeq_epi8(_mm256_min_epu8(a, belowKey), a));
+          const __m256i bBelow = _mm256_and_si256(anyBelow, _mm256_cmpeq_epi8(_mm256_min_epu8(b, belowKey), b));
+          firstEqual = _mm256_sub_epi8(firstEqual, aIsKey);
+          secondEqual = _mm256_sub_epi8(secondEqual, bIsKey);
+          bothEqual = _mm256_sub_epi8(bothEqual, _mm256_and_si256(aIsKey, bIsKey));
+          firstAbove = _mm256_sub_epi8(firstAbove, _mm256_and_si256(aIsKey, bBelow));
+          secondAbove = _mm256_sub_epi8(secondAbove, _mm256_and_si256(bIsKey, aBelow));
+        }
+        addCounts(histogram, k, sumBytes(firstEqual), sumBytes(secondEqual), sumBytes(bothEqual),
+                  sumBytes(firstAbove), sumBytes(secondAbove));
+      }
+    }
+    return histogram;
+  }
+
+  /**
+   * Same as ofAvx2(), 64 pairs at a time: the comparisons are masks, which
+   * compare unsigned bytes directly, counted with popcnt.
+   */
+  __target_isa__("avx512f,avx512bw,avx2,popcnt")
+  static JointRegisterHistogram ofAvx512(const uint8_t* __restrict__ synopsis, const uint8_t* __restrict__ other,
+                                         uint32_t numberOfRegisters) {
+    if (numberOfRegisters < sizeof(__m512i)) {
+      return ofAvx2(synopsis, other, numberOfRegisters);
+    }
+    JointRegisterHistogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    histogram.numberOfRegisters = numberOfRegisters;
+    const __m512i maxValue = _mm512_set1_epi8(MAX_VALUE);
+    const uint32_t BLOCK_SIZE = 128 * sizeof(__m512i);
+    for (uint32_t offset = 0; offset < numberOfRegisters; offset += BLOCK_SIZE) {
+      const uint32_t vectors = std::min(numberOfRegisters - offset, BLOCK_SIZE) / sizeof(__m512i);
+      const uint8_t* firstBlock = synopsis + offset;
+      const uint8_t* secondBlock = other + offset;
+
+      __m512i low = _mm512_set1_epi8(-1);
+      __m512i high = _mm512_setzero_si512();
+      for (uint32_t i = 0; i < vectors; ++i) {
+        const __m512i a = _mm512_loadu_si512(firstBlock + i * sizeof(__m512i));
+        const __m512i b = _mm512_loadu_si512(secondBlock + i * sizeof(__m512i));
+        low = _mm512_min_epu8(low, _mm512_min_epu8(a, b));
+        high = _mm512_max_epu8(high, _mm512_max_epu8(a, b));
+      }
+      uint8_t lows[sizeof(__m512i)], highs[sizeof(__m512i)];
+      _mm512_storeu_si512(lows, _mm512_min_epu8(low, maxValue));
+      _mm512_storeu_si512(highs, _mm512_min_epu8(high, maxValue));
+      const uint8_t lowest = *std::min_element(lows, lows + sizeof(lows));
+      const uint8_t highest = *std::max_element(highs, highs + sizeof(highs));
+
+      for (uint8_t k = lowest; k <= highest; ++k) {
+        const __m512i key = _mm512_set1_epi8(k);
+        uint32_t firstEqual = 0, secondEqual = 0, bothEqual = 0, firstAbove = 0, secondAbove = 0;
+        for (uint32_t i = 0; i < vectors; ++i) {
+          const __m512i a = _mm512_min_epu8(_mm512_loadu_si512(firstBlock + i * sizeof(__m512i)), maxValue);
+          const __m512i b = _mm512_min_epu8(_mm512_loadu_si512(secondBlock + i * sizeof(__m512i)), maxValue);
+          const __mmask64 aIsKey = _mm512_cmpeq_epi8_mask(a, key);
+          const __mmask64 bIsKey = _mm512_cmpeq_epi8_mask(b, key);
+          firstEqual += _mm_popcnt_u64(aIsKey);
+          secondEqual += _mm_popcnt_u64(bIsKey);
+          bothEqual += _mm_popcnt_u64(aIsKey & bIsKey);
+          firstAbove += _mm_popcnt_u64(aIsKey & _mm512_cmplt_epu8_mask(b, key));
+          secondAbove += _mm_popcnt_u64(bIsKey & _mm512_cmplt_epu8_mask(a, key));
+        }
+        addCounts(histogram, k, firstEqual, secondEqual, bothEqual, firstAbove, secondAbove);
+      }
+    }
+    return histogram;
+  }
+#endif
+
+  RegisterHistogram firstHistogram() const {
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    for (uint32_t k = 0; k <= MAX_VALUE; ++k) {
+      histogram.counts[k] = first[EQUAL][k] + first[FIRST_ABOVE][k] + first[FIRST_BELOW][k];
+    }
+    return histogram;
+  }
+
+  RegisterHistogram secondHistogram() const {
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    for (uint32_t k = 0; k <= MAX_VALUE; ++k) {
+      histogram.counts[k] = second[EQUAL][k] + second[FIRST_ABOVE][k] + second[FIRST_BELOW][k];
+    }
+    return histogram;
+  }
+
+  // Histogram of the registers of the union, the larger of each pair
+  RegisterHistogram unionHistogram() const {
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    for (uint32_t k = 0; k <= MAX_VALUE; ++k) {
+      histogram.counts[k] = first[EQUAL][k] + first[FIRST_ABOVE][k] + second[FIRST_BELOW][k];
+    }
+    return histogram;
+  }
+
+private:
+#if defined(__x86_64__)
+  // Sum of the 32 byte counts
+  __target_isa__("avx2")
+  static uint32_t sumBytes(__m256i counts) {
+    uint64_t sums[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums), _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+    return sums[0] + sums[1] + sums[2] + sums[3];
+  }
+#endif
+
+  /**
+   * Counts of value k from the registers of A and of B holding it, the pairs
+   * where both do and those where the other register is below it.
+   */
+  static void addCounts(JointRegisterHistogram& histogram, uint8_t k, uint32_t firstEqual, uint32_t secondEqual,
+                        uint32_t bothEqual, uint32_t firstAbove, uint32_t secondAbove) {
+    histogram.first[EQUAL][k] += bothEqual;
+    histogram.first[FIRST_ABOVE][k] += firstAbove;
+    histogram.first[FIRST_BELOW][k] += firstEqual - bothEqual - firstAbove;
+    histogram.second[EQUAL][k] += bothEqual;
+    histogram.second[FIRST_BELOW][k] += secondAbove;
+    histogram.second[FIRST_ABOVE][k] += secondEqual - bothEqual - secondAbove;
+  }
+};
+
+/**
+ * Cardinalities of A \ B, B \ A and A ∩ B that JointEstimate gives for two
+ * synopses A and B.
+ */
+struct JointCardinality {
+  uint64_t firstOnly;
+  uint64_t secondOnly;
+  uint64_t both;
+};
+
+/**
+ * Ertl's joint maximum likelihood estimate of the cardinalities of A \ B,
+ * B \ A and A ∩ B from the registers of A and B ([New cardinality estimation
+ * algorithms for HyperLogLog sketches](https://arxiv.org/abs/1702.01284)).
+ * In the Poisson model the values of each part go to each
+ * register at rates a, b and x (the cardinality over the number of
+ * registers), and a register of a part at rate r is at most k with
+ * probability F_r(k) = exp(-r 2^-k), for k from 0 to q = 64 - p, and 1 for
+ * k = q + 1. The register of A is the larger of those of A \ B and A ∩ B,
+ * that of B the larger of those of B \ A and A ∩ B, so a pair of registers
+ * (k1, k2) has the probability
+ *
+ *   k1 < k2:  P_{a+x}(k1) P_b(k2)
+ *   k1 > k2:  P_a(k1) P_{b+x}(k2)
+ *   k1 = k2:  F_a(k) F_b(k) F_x(k) - F_a(k-1) F_b(k) F_x(k-1)
+ *             - F_a(k) F_b(k-1) F_x(k-1) + F_a(k-1) F_b(k-1) F_x(k-1)
+ *
+ * with P_r(k) = F_r(k) - F_r(k-1), and the log-likelihood only depends on
+ * the counts of JointRegisterHistogram. It is maximized over the logarithms
+ * of the rates, which keeps them positive, by Newton's method damped as in
+ * Levenberg-Marquardt, from the estimate that inclusion-exclusion gives.
+ * Unlike inclusion-exclusion, which takes the difference of estimates each
+ * as large as the union, it uses how the registers of A and B compare, and
+ * its estimate of A ∩ B is never negative.
+ */
+class JointEstimate {
+public:
+  static JointCardinality estimate(const JointRegisterHistogram& histogram, uint8_t precision,
+                                   double firstOnly, double secondOnly, double both) {
+    JointCardinality cardinality = {0, 0, 0};
+    if (histogram.first[JointRegisterHistogram::EQUAL][0] == histogram.numberOfRegisters) {
+      return cardinality;
+    }
+    const JointEstimate likelihood(histogram, precision);
+    const double m = histogram.numberOfRegisters;
+    // a part inclusion-exclusion finds empty starts at half a value, the optimum may still be 0
+    double logRates[3] = {
+      std::log(std::max(firstOnly, 0.5) / m),
+      std::log(std::max(secondOnly, 0.5) / m),
+      std::log(std::max(both, 0.5) / m)
+    };
+    likelihood.maximize(logRates);
+    cardinality.firstOnly = std::llround(m * std::exp(logRates[0]));
+    cardinality.secondOnly = std::llround(m * std::exp(logRates[1]));
+    cardinality.both = std::llround(m * std::exp(logRates[2]));
+    return cardinality;
+  }
+
+private:
+  static const uint32_t MAX_ITERATIONS = 200;
+
+  /**
+   * A probability of the model as a sum of up to 4 terms
+   * sign * exp(-(c[0] a + c[1] b + c[2] x)), and the number of register
+   * pairs it is the probability of.
+   */
+  struct Term {
+    uint32_t count;
+    uint8_t size;
+    double sign[4];
+    double c[4][3];
+
+    void add(double sign, double ca, double cb, double cx) {
+      this->sign[size] = sign;
+      c[size][0] = ca;
+      c[size][1] = cb;
+      c[size][2] = cx;
+      ++size;
+    }
+  };
+
+  // at most 5 terms per register value
+  Term terms[5 * (JointRegisterHistogram::MAX_VALUE + 1)];
+  uint32_t numberOfTerms;
+
+  JointEstimate(const JointRegisterHistogram& histogram, uint8_t precision) : numberOfTerms(0) {
+    const uint8_t q = 64 - precision;
+    for (uint32_t k = 0; k <= JointRegisterHistogram::MAX_VALUE; ++k) {
+      // F_r(k) = exp(-r w), the last register value holds everything above q
+      const double w = k <= q ? std::ldexp(1.0, -static_cast<int>(k)) : 0.0;
+      // F_r(k - 1) = exp(-r previous), and 0 for k = 0
+      const double previous = std::ldexp(1.0, 1 - static_cast<int>(k));
+      const bool first = k == 0;
+
+      // k1 < k2: A at rate a + x, B \ A at rate b. k1 > k2: A \ B at rate a, B at rate b + x
+      addDifference(histogram.first[JointRegisterHistogram::FIRST_BELOW][k], first, w, previous, 1, 0, 1);
+      addDifference(histogram.second[JointRegisterHistogram::FIRST_BELOW][k], first, w, previous, 0, 1, 0);
+      addDifference(histogram.first[JointRegisterHistogram::FIRST_ABOVE][k], first, w, previous, 1, 0, 0);
+      addDifference(histogram.second[JointRegisterHistogram::FIRST_ABOVE][k], first, w, previous, 0, 1, 1);
+
+      const uint32_t equal = histogram.first[JointRegisterHistogram::EQUAL][k];
+      if (equal != 0) {
+        Term& term = terms[numberOfTerms++];
+        term.count = equal;
+        term.size = 0;
+        term.add(1.0, w, w, w);
+        if (!first) {
+          term.add(-1.0, previous, w, previous);
+          term.add(-1.0, w, previous, previous);
+          term.add(1.0, previous, previous, previous);
+        }
+      }
+    }
+  }
+
+  /**
+   * Term of P_r(k) = F_r(k) - F_r(k-1) for the rate r that is the sum of the
+   * rates of the given parts.
+   */
+  void addDifference(uint32_t count, bool first, double w, double previous, double inA, double inB, double inX) {
+    if (count == 0) {
+      return;
+    }
+    Term& term = terms[numberOfTerms++];
+    term.count = count;
+    term.size = 0;
+    term.add(1.0, inA * w, inB * w, inX * w);
+    if (!first) {
+      term.add(-1.0, inA * previous, inB * previous, inX * previous);
+    }
+  }
+
+  /**
+   * Log-likelihood at the given log rates, and its gradient and Hessian with
+   * respect to them. False where a probability comes out as 0 or less, which
+   * rounding brings far from the optimum.
+   */
+  bool evaluate(const double (&logRates)[3], double& value, double (&gradient)[3], double (&hessian)[3][3]) const {
+    const double rates[3] = {std::exp(logRates[0]), std::exp(logRates[1]), std::exp(logRates[2])};
+    value = 0.0;
+    double g[3] = {0.0, 0.0, 0.0};
+    double h[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+    for (uint32_t t = 0; t < numberOfTerms; ++t) {
+      const Term& term = terms[t];
+      double p = 0.0;
+      double dp[3] = {0.0, 0.0, 0.0};
+      double d2p[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+      for (uint8_t j = 0; j < term.size; ++j) {
+        const double e = term.sign[j] * std::exp(-(term.c[j][0] * rates[0] + term.c[j][1] * rates[1] + term.c[j][2] * rates[2]));
+        p += e;
+        for (int i = 0; i < 3; ++i) {
+          dp[i] -= term.c[j][i] * e;
+          for (int l = 0; l < 3; ++l) {
+            d2p[i][l] += term.c[j][i] * term.c[j][l] * e;
+          }
+        }
+      }
+      if (!(p > 0.0)) {
+        return false;
+      }
+      value += term.count * std::log(p);
+      for (int i = 0; i < 3; ++i) {
+        g[i] += term.count * dp[i] / p;
+        for (int l = 0; l < 3; ++l) {
+          h[i][l] += term.count * (d2p[i][l] / p - dp[i] * dp[l] / (p * p));
+        }
+      }
+    }
+    // chain rule to the log rates
+    for (int i = 0; i < 3; ++i) {
+      gradient[i] = g[i] * rates[i];
+      for (int l = 0; l < 3; ++l) {
+        hessian[i][l] = h[i][l] * rates[i] * rates[l];
+      }
+      hessian[i][i] += gradient[i];
+    }
+    return true;
+  }
+
+  void maximize(double (&logRates)[3]) const {
+    double value, gradient[3], hessian[3][3];
+    if (!evaluate(logRates, value, gradient, hessian)) {
+      return;
+    }
+    double damping = 1e-3;
+    for (uint32_t iteration = 0; iteration < MAX_ITERATIONS; ++iteration) {
+      // (damping I - H) step = gradient, the Newton step when damping is 0
+      double system[3][4];
+      for (int i = 0; i < 3; ++i) {
+        for (int l = 0; l < 3; ++l) {
+          system[i][l] = -hessian[i][l] + (i == l ? damping * (1.0 + std::fabs(hessian[i][i])) : 0.0);
+        }
+        system[i][3] = gradient[i];
+      }
+      double step[3];
+      if (!solve(system, step)) {
+        damping *= 10.0;
+        continue;
+      }
+
+      const double candidate[3] = {logRates[0] + step[0], logRates[1] + step[1], logRates[2] + step[2]};
+      double candidateValue, candidateGradient[3], candidateHessian[3][3];
+      if (evaluate(candidate, candidateValue, candidateGradient, candidateHessian) && candidateValue >= value) {
+        const double change = std::max(std::fabs(step[0]), std::max(std::fabs(step[1]), std::fabs(step[2])));
+        memcpy(logRates, candidate, sizeof(candidate));
+        value = candidateValue;
+        memcpy(gradient, candidateGradient, sizeof(gradient));
+        memcpy(hessian, candidateHessian, sizeof(hessian));
+        damping = std::max(damping * 0.1, 1e-12);
+        if (change < 1e-9) {
+          return;
+        }
+      } else {
+        damping *= 10.0;
+        if (damping > 1e12) {
+          return;
+        }
+      }
+    }
+  }
+
+  // Gaussian elimination with partial pivoting of a 3x3 system, false if it is singular
+  static bool solve(double (&system)[3][4], double (&solution)[3]) {
+    for (int column = 0; column < 3; ++column) {
+      int pivot = column;
+      for (int row = column + 1; row < 3; ++row) {
+        if (std::fabs(system[row][column]) > std::fabs(system[pivot][column])) {
+          pivot = row;
+        }
+      }
+      if (!(std::fabs(system[pivot][column]) > 0.0)) {
+        return false;
+      }
+      for (int l = 0; l < 4; ++l) {
+        std::swap(system[column][l], system[pivot][l]);
+      }
+      for (int row = column + 1; row < 3; ++row) {
+        const double factor = system[row][column] / system[column][column];
+        for (int l = column; l < 4; ++l) {
+          system[row][l] -= factor * system[column][l];
+        }
+      }
+    }
+    for (int row = 2; row >= 0; --row) {
+      double sum = system[row][3];
+      for (int l = row + 1; l < 3; ++l) {
+        sum -= system[row][l] * solution[l];
+      }
+      solution[row] = sum / system[row][row];
+    }
+    return true;
+  }
+};
+
+#endif
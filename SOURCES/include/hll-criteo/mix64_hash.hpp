@@ -0,0 +1,107 @@
+#ifndef _MIX64_HASH_H_
+#define _MIX64_HASH_H_
+
+#include <cstddef>
+#include <stdint.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "../hll_utils.hpp"
+#include "murmur_hash.hpp"
+
+template<typename T>
+class Mix64Hash : public Hash<T> {};
+
+/**
+ * The finalizer of SplitMix64 (Stafford's Mix13) of the value xor'ed with the
+ * seed spread over 64 bits: two multiplies where MurMurHash takes four. It is
+ * a bijection of the 64-bit values, so distinct BIGINTs never collide.
+ */
+template<>
+class Mix64Hash<uint64_t> final : public Hash<uint64_t> {
+  public:
+    static const uint8_t ID = 3;
+
+    uint64_t operator()(uint64_t value, uint32_t seed = MURMURHASH_DEFAULT_SEED) const override {
+      return hash(value, seed);
+    }
+
+    // Same hashes as operator(), 8 (AVX-512) or 4 (AVX2) values at a time when the CPU supports it
+    void hashBatch(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed = MURMURHASH_DEFAULT_SEED) const {
+      static const HashBatchFunction hashBatchForCpu = selectHashBatch();
+      hashBatchForCpu(values, n, hashes, seed);
+    }
+
+    static inline uint64_t hash(uint64_t value, uint32_t seed) {
+      uint64_t z = value ^ (seed * GOLDEN_GAMMA);
+      z = (z ^ (z >> 30)) * M1;
+      z = (z ^ (z >> 27)) * M2;
+      return z ^ (z >> 31);
+    }
+
+  private:
+    typedef void (*HashBatchFunction)(const uint64_t*, size_t, uint64_t*, uint32_t);
+
+    static const uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15;
+    static const uint64_t M1 = 0xbf58476d1ce4e5b9;
+    static const uint64_t M2 = 0x94d049bb133111eb;
+
+    static void hashBatchScalar(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed) {
+      for (size_t i = 0; i < n; ++i) {
+        hashes[i] = hash(values[i], seed);
+      }
+    }
+
+#if defined(__x86_64__)
+    __target_isa__("avx2")
+    static void hashBatchAvx2(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed) {
+      const __m256i key = _mm256_set1_epi64x(seed * GOLDEN_GAMMA);
+      const __m256i m1l = _mm256_set1_epi64x(M1 & 0xffffffff);
+      const __m256i m1h = _mm256_set1_epi64x(M1 >> 32);
+      const __m256i m2l = _mm256_set1_epi64x(M2 & 0xffffffff);
+      const __m256i m2h = _mm256_set1_epi64x(M2 >> 32);
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+        __m256i z = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), key);
+        z = mullo64Avx2(_mm256_xor_si256(z, _mm256_srli_epi64(z, 30)), m1l, m1h);
+        z = mullo64Avx2(_mm256_xor_si256(z, _mm256_srli_epi64(z, 27)), m2l, m2h);
+        z = _mm256_xor_si256(z, _mm256_srli_epi64(z, 31));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(hashes + i), z);
+      }
+      hashBatchScalar(values + i, n - i, hashes + i, seed);
+    }
+
+    __target_isa__("avx512f,avx512dq")
+    static void hashBatchAvx512(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed) {
+      const __m512i key = _mm512_set1_epi64(seed * GOLDEN_GAMMA);
+      const __m512i m1 = _mm512_set1_epi64(M1);
+      const __m512i m2 = _mm512_set1_epi64(M2);
+      // the zero-masking shift, as in MurMurHash<uint64_t>::hashBatchAvx512()
+      const __mmask8 ALL_LANES = 0xff;
+      size_t i = 0;
+      for (; i + 8 <= n; i += 8) {
+        __m512i z = _mm512_xor_si512(_mm512_loadu_si512(values + i), key);
+        z = _mm512_mullo_epi64(_mm512_xor_si512(z, _mm512_maskz_srli_epi64(ALL_LANES, z, 30)), m1);
+        z = _mm512_mullo_epi64(_mm512_xor_si512(z, _mm512_maskz_srli_epi64(ALL_LANES, z, 27)), m2);
+        z = _mm512_xor_si512(z, _mm512_maskz_srli_epi64(ALL_LANES, z, 31));
+        _mm512_storeu_si512(hashes + i, z);
+      }
+      hashBatchScalar(values + i, n - i, hashes + i, seed);
+    }
+#endif
+
+    static HashBatchFunction selectHashBatch() {
+#if defined(__x86_64__)
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+        return hashBatchAvx512;
+      }
+      if (__builtin_cpu_supports("avx2")) {
+        return hashBatchAvx2;
+      }
+#endif
+      return hashBatchScalar;
+    }
+};
+
+#endif
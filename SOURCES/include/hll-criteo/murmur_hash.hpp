@@ -1,21 +1,67 @@
 #ifndef _MURMUR_HASH_H_
 #define _MURMUR_HASH_H_
 
+#include <cstddef>
+#include <stdint.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "../hll_utils.hpp"
+
 static const uint32_t MURMURHASH_DEFAULT_SEED = 27072015;
 
+#if defined(__x86_64__)
+// AVX2 has no 64-bit multiply: with a = ah.2^32 + al and b = bh.2^32 + bl,
+// a * b mod 2^64 = al * bl + ((ah * bl + al * bh) << 32).
+__target_isa__("avx2")
+static inline __m256i mullo64Avx2(__m256i a, __m256i bl, __m256i bh) {
+  const __m256i low = _mm256_mul_epu32(a, bl);
+  const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), bl), _mm256_mul_epu32(a, bh));
+  return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+#endif
+
 template <typename T>
 class Hash {
   public:
+    // Recorded in the header of the synopses built with it, 0 for the ones that don't say
+    static const uint8_t ID = 0;
+
     virtual uint64_t operator()(T value, uint32_t seed = MURMURHASH_DEFAULT_SEED) const = 0;
+
+    /**
+     * Hashes n values into hashes. Hash functions that can do better than one
+     * value at a time hide this with their own hashBatch().
+     */
+    void hashBatch(const T* values, size_t n, uint64_t* hashes, uint32_t seed = MURMURHASH_DEFAULT_SEED) const {
+      for (size_t i = 0; i < n; ++i) {
+        hashes[i] = (*this)(values[i], seed);
+      }
+    }
 };
 
 template<typename T>
 class MurMurHash : public Hash<T> {};
 
 template<>
-class MurMurHash<uint64_t> : public Hash<uint64_t>{
+class MurMurHash<uint64_t> final : public Hash<uint64_t>{
   public:
+    static const uint8_t ID = 1;
+
     uint64_t operator()(uint64_t value, uint32_t seed = MURMURHASH_DEFAULT_SEED) const override {
+      return hash(value, seed);
+    }
+
+    /**
+     * Same hashes as operator(), computed 8 (AVX-512) or 4 (AVX2) values at a
+     * time when the CPU we run on supports it.
+     */
+    void hashBatch(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed = MURMURHASH_DEFAULT_SEED) const {
+      static const HashBatchFunction hashBatchForCpu = selectHashBatch();
+      hashBatchForCpu(values, n, hashes, seed);
+    }
+
+    static inline uint64_t hash(uint64_t value, uint32_t seed) {
       const uint64_t m = 0xc6a4a7935bd1e995;
       const int r = 47;
       uint64_t h = seed ^ (sizeof(uint64_t) * m);
@@ -31,14 +77,88 @@ class MurMurHash<uint64_t> : public Hash<uint64_t>{
       h ^= h >> r;
       return h;
     }
+
+  private:
+    typedef void (*HashBatchFunction)(const uint64_t*, size_t, uint64_t*, uint32_t);
+
+    static void hashBatchScalar(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed) {
+      for (size_t i = 0; i < n; ++i) {
+        hashes[i] = hash(values[i], seed);
+      }
+    }
+
+#if defined(__x86_64__)
+    __target_isa__("avx2")
+    static void hashBatchAvx2(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed) {
+      const uint64_t m = 0xc6a4a7935bd1e995;
+      const uint64_t mm = m * m;
+      const __m256i ml = _mm256_set1_epi64x(m & 0xffffffff);
+      const __m256i mh = _mm256_set1_epi64x(m >> 32);
+      const __m256i mml = _mm256_set1_epi64x(mm & 0xffffffff);
+      const __m256i mmh = _mm256_set1_epi64x(mm >> 32);
+      const __m256i h0 = _mm256_set1_epi64x(seed ^ (sizeof(uint64_t) * m));
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+        __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        k = mullo64Avx2(k, ml, mh);
+        k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 47));
+        k = mullo64Avx2(k, ml, mh);
+        __m256i h = mullo64Avx2(_mm256_xor_si256(h0, k), mml, mmh);
+        h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 47));
+        h = mullo64Avx2(h, ml, mh);
+        h = _mm256_xor_si256(h, _mm256_srli_epi64(h, 47));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(hashes + i), h);
+      }
+      hashBatchScalar(values + i, n - i, hashes + i, seed);
+    }
+
+    __target_isa__("avx512f,avx512dq")
+    static void hashBatchAvx512(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed) {
+      const uint64_t m = 0xc6a4a7935bd1e995;
+      const __m512i vm = _mm512_set1_epi64(m);
+      const __m512i vmm = _mm512_set1_epi64(m * m);
+      const __m512i h0 = _mm512_set1_epi64(seed ^ (sizeof(uint64_t) * m));
+      // the zero-masking shift, as the unmasked one trips -Wmaybe-uninitialized in GCC 12 headers
+      const __mmask8 ALL_LANES = 0xff;
+      size_t i = 0;
+      for (; i + 8 <= n; i += 8) {
+        __m512i k = _mm512_loadu_si512(values + i);
+        k = _mm512_mullo_epi64(k, vm);
+        k = _mm512_xor_si512(k, _mm512_maskz_srli_epi64(ALL_LANES, k, 47));
+        k = _mm512_mullo_epi64(k, vm);
+        __m512i h = _mm512_mullo_epi64(_mm512_xor_si512(h0, k), vmm);
+        h = _mm512_xor_si512(h, _mm512_maskz_srli_epi64(ALL_LANES, h, 47));
+        h = _mm512_mullo_epi64(h, vm);
+        h = _mm512_xor_si512(h, _mm512_maskz_srli_epi64(ALL_LANES, h, 47));
+        _mm512_storeu_si512(hashes + i, h);
+      }
+      hashBatchScalar(values + i, n - i, hashes + i, seed);
+    }
+#endif
+
+    static HashBatchFunction selectHashBatch() {
+#if defined(__x86_64__)
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+        return hashBatchAvx512;
+      }
+      if (__builtin_cpu_supports("avx2")) {
+        return hashBatchAvx2;
+      }
+#endif
+      return hashBatchScalar;
+    }
 };
 
 template<>
-class MurMurHash<uint32_t> : public Hash<uint32_t>{
+class MurMurHash<uint32_t> final : public Hash<uint32_t>{
   public:
+    // the same hashes as MurMurHash<uint64_t> of the widened values
+    static const uint8_t ID = MurMurHash<uint64_t>::ID;
+
     uint64_t operator()(uint32_t value, uint32_t seed = MURMURHASH_DEFAULT_SEED) const override {
-      return MurMurHash<uint64_t>()(static_cast<uint64_t>(value), seed);
+      return MurMurHash<uint64_t>::hash(static_cast<uint64_t>(value), seed);
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,260 @@
+#ifndef _REGISTER_HISTOGRAM_H_
+#define _REGISTER_HISTOGRAM_H_
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "../hll_utils.hpp"
+
+/**
+ * Number of registers of a synopsis holding each value 0..64. The estimators,
+ * the number of set registers and the base of the 4 and 5-bit formats all
+ * derive from it, so a synopsis only has to be read once to get all of them.
+ */
+struct RegisterHistogram {
+  // a register holds at most 64 - precision + 1
+  static const uint8_t MAX_VALUE = 64;
+
+  uint32_t counts[MAX_VALUE + 1];
+  uint32_t numberOfRegisters;
+
+  /**
+   * One pass over the registers, 8 at a time. Consecutive registers are
+   * counted in four separate tables, otherwise two registers with the same
+   * value (the common case) make each increment wait for the store of the
+   * previous one. The tables have a slot for every byte value, so that
+   * values above MAX_VALUE, which only a corrupted payload can bring, need no
+   * check in the loop: they are counted as MAX_VALUE at the end.
+   */
+  static RegisterHistogram of(const uint8_t* __restrict__ synopsis, uint32_t numberOfRegisters) {
+    uint32_t split[4][256];
+    memset(split, 0, sizeof(split));
+    // registers come in powers of two, at least 16 of them
+    for (uint32_t i = 0; i < numberOfRegisters; i += sizeof(uint64_t)) {
+      uint64_t registers;
+      memcpy(&registers, synopsis + i, sizeof(registers));
+      ++split[0][registers & 0xff];
+      ++split[1][(registers >> 8) & 0xff];
+      ++split[2][(registers >> 16) & 0xff];
+      ++split[3][(registers >> 24) & 0xff];
+      ++split[0][(registers >> 32) & 0xff];
+      ++split[1][(registers >> 40) & 0xff];
+      ++split[2][(registers >> 48) & 0xff];
+      ++split[3][registers >> 56];
+    }
+
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    for (uint32_t k = 0; k < 256; ++k) {
+      histogram.counts[bin(k)] += split[0][k] + split[1][k] + split[2][k] + split[3][k];
+    }
+    return histogram;
+  }
+
+  /**
+   * Same as of() for the registers of the 4-bit format, counted where they
+   * are packed rather than unpacked into a synopsis first: the bytes are
+   * counted as they are, 2 registers each, and only split into their
+   * registers once per byte value at the end. It takes less than unpacking
+   * them with vector instructions and counting those.
+   */
+  static RegisterHistogram of4BitsWithBase(const uint8_t* __restrict__ packed, uint8_t base, uint32_t numberOfRegisters) {
+    uint32_t split[4][256];
+    memset(split, 0, sizeof(split));
+    // 16 registers at least, in 8 bytes
+    for (uint32_t i = 0; i < numberOfRegisters / 2; i += sizeof(uint64_t)) {
+      uint64_t pairs;
+      memcpy(&pairs, packed + i, sizeof(pairs));
+      ++split[0][pairs & 0xff];
+      ++split[1][(pairs >> 8) & 0xff];
+      ++split[2][(pairs >> 16) & 0xff];
+      ++split[3][(pairs >> 24) & 0xff];
+      ++split[0][(pairs >> 32) & 0xff];
+      ++split[1][(pairs >> 40) & 0xff];
+      ++split[2][(pairs >> 48) & 0xff];
+      ++split[3][pairs >> 56];
+    }
+
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    for (uint32_t k = 0; k < 256; ++k) {
+      const uint32_t count = split[0][k] + split[1][k] + split[2][k] + split[3][k];
+      histogram.counts[binAbove(base, k >> 4)] += count;
+      histogram.counts[binAbove(base, k & 0x0f)] += count;
+    }
+    return histogram;
+  }
+
+#if defined(__x86_64__)
+  /**
+   * Same as of(), a block of at most 4 KB at a time: the block is scanned once
+   * for its smallest and largest register, then once per value in between,
+   * counting the registers equal to it 32 at a time. The block stays in L1
+   * and registers concentrate on a few values around log2(n/m), so it takes
+   * a fraction of the scalar loop.
+   */
+  __target_isa__("avx2")
+  static RegisterHistogram ofAvx2(const uint8_t* __restrict__ synopsis, uint32_t numberOfRegisters) {
+    if (numberOfRegisters < sizeof(__m256i)) {
+      return of(synopsis, numberOfRegisters);
+    }
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    // each byte lane counts up to 128 matches, they are summed once per block
+    const uint32_t BLOCK_SIZE = 128 * sizeof(__m256i);
+    for (uint32_t offset = 0; offset < numberOfRegisters; offset += BLOCK_SIZE) {
+      const uint32_t blockSize = std::min(numberOfRegisters - offset, BLOCK_SIZE);
+      const uint8_t* block = synopsis + offset;
+      const uint32_t vectors = blockSize / sizeof(__m256i);
+
+      __m256i low = _mm256_set1_epi8(-1);
+      __m256i high = _mm256_setzero_si256();
+      for (uint32_t i = 0; i < vectors; ++i) {
+        const __m256i registers = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block) + i);
+        low = _mm256_min_epu8(low, registers);
+        high = _mm256_max_epu8(high, registers);
+      }
+      uint8_t lows[sizeof(__m256i)], highs[sizeof(__m256i)];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(lows), low);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(highs), high);
+      const uint8_t first = *std::min_element(lows, lows + sizeof(lows));
+      const uint8_t last = std::min<uint8_t>(*std::max_element(highs, highs + sizeof(highs)), MAX_VALUE - 1);
+
+      uint32_t counted = 0;
+      for (uint8_t k = first; k <= last; ++k) {
+        const __m256i key = _mm256_set1_epi8(k);
+        __m256i matches = _mm256_setzero_si256();
+        for (uint32_t i = 0; i < vectors; ++i) {
+          const __m256i registers = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block) + i);
+          matches = _mm256_sub_epi8(matches, _mm256_cmpeq_epi8(registers, key));
+        }
+        uint64_t sums[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums), _mm256_sad_epu8(matches, _mm256_setzero_si256()));
+        const uint32_t count = sums[0] + sums[1] + sums[2] + sums[3];
+        histogram.counts[k] += count;
+        counted += count;
+      }
+      // everything above MAX_VALUE - 1
+      histogram.counts[MAX_VALUE] += blockSize - counted;
+    }
+    return histogram;
+  }
+
+  /**
+   * Same as ofAvx2(), 64 registers at a time: the matches of a value are a
+   * mask and counted with popcnt.
+   */
+  __target_isa__("avx512f,avx512bw,avx2,popcnt")
+  static RegisterHistogram ofAvx512(const uint8_t* __restrict__ synopsis, uint32_t numberOfRegisters) {
+    if (numberOfRegisters < sizeof(__m512i)) {
+      return ofAvx2(synopsis, numberOfRegisters);
+    }
+    RegisterHistogram histogram;
+    histogram.reset(numberOfRegisters);
+    const uint32_t BLOCK_SIZE = 128 * sizeof(__m512i);
+    for (uint32_t offset = 0; offset < numberOfRegisters; offset += BLOCK_SIZE) {
+      const uint32_t blockSize = std::min(numberOfRegisters - offset, BLOCK_SIZE);
+      const uint8_t* block = synopsis + offset;
+      const uint32_t vectors = blockSize / sizeof(__m512i);
+
+      __m512i low = _mm512_set1_epi8(-1);
+      __m512i high = _mm512_setzero_si512();
+      for (uint32_t i = 0; i < vectors; ++i) {
+        const __m512i registers = _mm512_loadu_si512(block + i * sizeof(__m512i));
+        low = _mm512_min_epu8(low, registers);
+        high = _mm512_max_epu8(high, registers);
+      }
+      uint8_t lows[sizeof(__m512i)], highs[sizeof(__m512i)];
+      _mm512_storeu_si512(lows, low);
+      _mm512_storeu_si512(highs, high);
+      const uint8_t first = *std::min_element(lows, lows + sizeof(lows));
+      const uint8_t last = std::min<uint8_t>(*std::max_element(highs, highs + sizeof(highs)), MAX_VALUE - 1);
+
+      uint32_t counted = 0;
+      for (uint8_t k = first; k <= last; ++k) {
+        const __m512i key = _mm512_set1_epi8(k);
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < vectors; ++i) {
+          count += _mm_popcnt_u64(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(block + i * sizeof(__m512i)), key));
+        }
+        histogram.counts[k] += count;
+        counted += count;
+      }
+      histogram.counts[MAX_VALUE] += blockSize - counted;
+    }
+    return histogram;
+  }
+#endif
+
+  void reset(uint32_t numberOfRegisters) {
+    memset(counts, 0, sizeof(counts));
+    this->numberOfRegisters = numberOfRegisters;
+  }
+
+  // Adds the counts of a histogram of part of the registers
+  void addCounts(const RegisterHistogram& part) {
+    for (uint32_t k = 0; k <= MAX_VALUE; ++k) {
+      counts[k] += part.counts[k];
+    }
+  }
+
+  static uint8_t bin(uint8_t value) {
+    return value < MAX_VALUE ? value : MAX_VALUE;
+  }
+
+  // bin() of the register a packed format holds as code above base
+  static uint8_t binAbove(uint8_t base, uint32_t code) {
+    return std::min<uint32_t>(base + code, MAX_VALUE);
+  }
+
+  uint32_t emptyRegisters() const {
+    return counts[0];
+  }
+
+  uint32_t setRegisters() const {
+    return numberOfRegisters - counts[0];
+  }
+
+  // number of registers holding more than value
+  uint32_t registersAbove(uint8_t value) const {
+    uint32_t count = 0;
+    for (uint32_t k = value + 1; k <= MAX_VALUE; ++k) {
+      count += counts[k];
+    }
+    return count;
+  }
+
+  uint8_t minValue() const {
+    uint8_t k = 0;
+    while (k < MAX_VALUE && counts[k] == 0) {
+      ++k;
+    }
+    return k;
+  }
+
+  uint8_t maxValue() const {
+    uint8_t k = MAX_VALUE;
+    while (k > 0 && counts[k] == 0) {
+      --k;
+    }
+    return k;
+  }
+
+  /**
+   * sum_{j=1}^m{2^{-M[j]}}, the denominator of the raw HLL estimate. Adding
+   * the smallest terms first keeps them from being absorbed by the large ones.
+   */
+  double harmonicSum() const {
+    double sum = 0.0;
+    for (int k = MAX_VALUE; k >= 0; --k) {
+      sum += counts[k] * fast_inv_pow2(k);
+    }
+    return sum;
+  }
+};
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef _REGISTER_UNPACK_H_
+#define _REGISTER_UNPACK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "../hll_utils.hpp"
+
+/**
+ * Unpacking of the 6, 5 and 4-bit formats into a synopsis, taking the max of
+ * each register with the one already there. HllRaw's folds hand the
+ * registers over to one of the structs below, which unpack as many as they
+ * can with vector instructions and return how many they did; the scalar loop
+ * of HllRaw takes care of the rest. The vector loops never read past length.
+ *
+ * ScalarUnpack does none of them, for the baseline kernels: GCC vectorizes
+ * the scalar loops for SSE2 already.
+ */
+struct ScalarUnpack {
+  static uint32_t fold6Bits(uint8_t*, const uint8_t*, size_t, uint32_t) {
+    return 0;
+  }
+
+  static uint32_t fold5BitsWithBase(uint8_t*, const uint8_t*, uint8_t, size_t, uint32_t) {
+    return 0;
+  }
+
+  static uint32_t fold4BitsWithBase(uint8_t*, const uint8_t*, uint8_t, size_t, uint32_t) {
+    return 0;
+  }
+};
+
+#if defined(__x86_64__)
+/**
+ * pshufb copies the two bytes each register of a group straddles into a
+ * 16-bit lane, big-endian first, and pmulhuw by 2^(16 - shift) shifts each
+ * lane by its own amount. The lanes are masked to the width of a register,
+ * packed back to bytes, rebased and max'ed into the synopsis: 16 registers
+ * from 12 bytes for 6 bits, from 10 bytes for 5 bits. The 4-bit format
+ * needs no shuffle, only its nibbles interleaved: 32 registers from 16 bytes.
+ */
+struct Ssse3Unpack {
+  __target_isa__("ssse3")
+  static uint32_t fold6Bits(uint8_t* __restrict__ synopsis, const uint8_t* __restrict__ byteArray, size_t length,
+                            uint32_t numberOfRegisters) {
+    // registers 0..3 of a group of 3 bytes start at bits 0, 6, 12 and 18
+    const __m128i firstGroups = _mm_setr_epi8(1, 0, 1, 0, 2, 1, 3, 2, 4, 3, 4, 3, 5, 4, 6, 5);
+    const __m128i nextGroups = _mm_add_epi8(firstGroups, _mm_set1_epi8(6));
+    const __m128i shifts = _mm_setr_epi16(1 << 6, 1 << 12, 1 << 10, 1 << 8, 1 << 6, 1 << 12, 1 << 10, 1 << 8);
+    const __m128i mask = _mm_set1_epi16(0x3f);
+    uint32_t i = 0;
+    for (; i + 16 <= numberOfRegisters && i / 4 * 3 + sizeof(__m128i) <= length; i += 16) {
+      const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(byteArray + i / 4 * 3));
+      const __m128i low = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(bytes, firstGroups), shifts), mask);
+      const __m128i high = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(bytes, nextGroups), shifts), mask);
+      __m128i* registers = reinterpret_cast<__m128i*>(synopsis + i);
+      _mm_storeu_si128(registers, _mm_max_epu8(_mm_loadu_si128(registers), _mm_packus_epi16(low, high)));
+    }
+    return i;
+  }
+
+  __target_isa__("ssse3")
+  static uint32_t fold5BitsWithBase(uint8_t* __restrict__ synopsis, const uint8_t* __restrict__ byteArray, uint8_t base,
+                                    size_t length, uint32_t numberOfRegisters) {
+    // registers 0..7 of a group of 5 bytes start at bits 0, 5, 10, ... 35
+    const __m128i firstGroup = _mm_setr_epi8(1, 0, 1, 0, 2, 1, 2, 1, 3, 2, 4, 3, 4, 3, -1, 4);
+    const __m128i nextGroup = _mm_setr_epi8(6, 5, 6, 5, 7, 6, 7, 6, 8, 7, 9, 8, 9, 8, -1, 9);
+    const __m128i shifts = _mm_setr_epi16(1 << 5, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+    const __m128i mask = _mm_set1_epi16(0x1f);
+    const __m128i bases = _mm_set1_epi8(base);
+    uint32_t i = 0;
+    for (; i + 16 <= numberOfRegisters && i / 8 * 5 + sizeof(__m128i) <= length; i += 16) {
+      const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(byteArray + i / 8 * 5));
+      const __m128i low = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(bytes, firstGroup), shifts), mask);
+      const __m128i high = _mm_and_si128(_mm_mulhi_epu16(_mm_shuffle_epi8(bytes, nextGroup), shifts), mask);
+      const __m128i values = _mm_add_epi8(_mm_packus_epi16(low, high), bases);
+      __m128i* registers = reinterpret_cast<__m128i*>(synopsis + i);
+      _mm_storeu_si128(registers, _mm_max_epu8(_mm_loadu_si128(registers), values));
+    }
+    return i;
+  }
+
+  __target_isa__("ssse3")
+  static uint32_t fold4BitsWithBase(uint8_t* __restrict__ synopsis, const uint8_t* __restrict__ byteArray, uint8_t base,
+                                    size_t length, uint32_t numberOfRegisters) {
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i bases = _mm_set1_epi8(base);
+    uint32_t i = 0;
+    for (; i + 32 <= numberOfRegisters && i / 2 + sizeof(__m128i) <= length; i += 32) {
+      const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(byteArray + i / 2));
+      const __m128i high = _mm_add_epi8(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask), bases);
+      const __m128i low = _mm_add_epi8(_mm_and_si128(bytes, mask), bases);
+      __m128i* registers = reinterpret_cast<__m128i*>(synopsis + i);
+      _mm_storeu_si128(registers, _mm_max_epu8(_mm_loadu_si128(registers), _mm_unpacklo_epi8(high, low)));
+      _mm_storeu_si128(registers + 1, _mm_max_epu8(_mm_loadu_si128(registers + 1), _mm_unpackhi_epi8(high, low)));
+    }
+    return i;
+  }
+};
+
+/**
+ * Same as Ssse3Unpack, 32 registers at a time. pshufb and packuswb work
+ * within each 128-bit half, so each half is loaded with the bytes of 16
+ * registers.
+ */
+struct Avx2Unpack {
+  __target_isa__("avx2")
+  static __m256i loadHalves(const uint8_t* low, const uint8_t* high) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low))),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(high)), 1);
+  }
+
+  __target_isa__("avx2")
+  static uint32_t fold6Bits(uint8_t* __restrict__ synopsis, const uint8_t* __restrict__ byteArray, size_t length,
+                            uint32_t numberOfRegisters) {
+    const __m256i firstGroups = _mm256_setr_epi8(1, 0, 1, 0, 2, 1, 3, 2, 4, 3, 4, 3, 5, 4, 6, 5,
+                                                 1, 0, 1, 0, 2, 1, 3, 2, 4, 3, 4, 3, 5, 4, 6, 5);
+    const __m256i nextGroups = _mm256_add_epi8(firstGroups, _mm256_set1_epi8(6));
+    const __m256i shifts = _mm256_setr_epi16(1 << 6, 1 << 12, 1 << 10, 1 << 8, 1 << 6, 1 << 12, 1 << 10, 1 << 8,
+                                             1 << 6, 1 << 12, 1 << 10, 1 << 8, 1 << 6, 1 << 12, 1 << 10, 1 << 8);
+    const __m256i mask = _mm256_set1_epi16(0x3f);
+    uint32_t i = 0;
+    for (; i + 32 <= numberOfRegisters && i / 4 * 3 + 12 + sizeof(__m128i) <= length; i += 32) {
+      const uint8_t* bytes_ = byteArray + i / 4 * 3;
+      const __m256i bytes = loadHalves(bytes_, bytes_ + 12);
+      const __m256i low = _mm256_and_si256(_mm256_mulhi_epu16(_mm256_shuffle_epi8(bytes, firstGroups), shifts), mask);
+      const __m256i high = _mm256_and_si256(_mm256_mulhi_epu16(_mm256_shuffle_epi8(bytes, nextGroups), shifts), mask);
+      __m256i* registers = reinterpret_cast<__m256i*>(synopsis + i);
+      _mm256_storeu_si256(registers, _mm256_max_epu8(_mm256_loadu_si256(registers), _mm256_packus_epi16(low, high)));
+    }
+    return i + Ssse3Unpack::fold6Bits(synopsis + i, byteArray + i / 4 * 3, length - i / 4 * 3, numberOfRegisters - i);
+  }
+
+  __target_isa__("avx2")
+  static uint32_t fold5BitsWithBase(uint8_t* __restrict__ synopsis, const uint8_t* __restrict__ byteArray, uint8_t base,
+                                    size_t length, uint32_t numberOfRegisters) {
+    const __m256i firstGroup = _mm256_setr_epi8(1, 0, 1, 0, 2, 1, 2, 1, 3, 2, 4, 3, 4, 3, -1, 4,
+                                                1, 0, 1, 0, 2, 1, 2, 1, 3, 2, 4, 3, 4, 3, -1, 4);
+    const __m256i nextGroup = _mm256_setr_epi8(6, 5, 6, 5, 7, 6, 7, 6, 8, 7, 9, 8, 9, 8, -1, 9,
+                                               6, 5, 6, 5, 7, 6, 7, 6, 8, 7, 9, 8, 9, 8, -1, 9);
+    const __m256i shifts = _mm256_setr_epi16(1 << 5, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8,
+                                             1 << 5, 1 << 10, 1 << 7, 1 << 12, 1 << 9, 1 << 6, 1 << 11, 1 << 8);
+    const __m256i mask = _mm256_set1_epi16(0x1f);
+    const __m256i bases = _mm256_set1_epi8(base);
+    uint32_t i = 0;
+    for (; i + 32 <= numberOfRegisters && i / 8 * 5 + 10 + sizeof(__m128i) <= length; i += 32) {
+      const uint8_t* bytes_ = byteArray + i / 8 * 5;
+      const __m256i bytes = loadHalves(bytes_, bytes_ + 10);
+      const __m256i low = _mm256_and_si256(_mm256_mulhi_epu16(_mm256_shuffle_epi8(bytes, firstGroup), shifts), mask);
+      const __m256i high = _mm256_and_si256(_mm256_mulhi_epu16(_mm256_shuffle_epi8(bytes, nextGroup), shifts), mask);
+      const __m256i values = _mm256_add_epi8(_mm256_packus_epi16(low, high), bases);
+      __m256i* registers = reinterpret_cast<__m256i*>(synopsis + i);
+      _mm256_storeu_si256(registers, _mm256_max_epu8(_mm256_loadu_si256(registers), values));
+    }
+    return i + Ssse3Unpack::fold5BitsWithBase(synopsis + i, byteArray + i / 8 * 5, base, length - i / 8 * 5,
+                                              numberOfRegisters - i);
+  }
+
+  // Each byte widened to a 16-bit lane holds its two registers, high nibble first
+  __target_isa__("avx2")
+  static uint32_t fold4BitsWithBase(uint8_t* __restrict__ synopsis, const uint8_t* __restrict__ byteArray, uint8_t base,
+                                    size_t length, uint32_t numberOfRegisters) {
+    const __m256i mask = _mm256_set1_epi16(0x0f0f);
+    const __m256i bases = _mm256_set1_epi8(base);
+    uint32_t i = 0;
+    for (; i + 32 <= numberOfRegisters && i / 2 + sizeof(__m128i) <= length; i += 32) {
+      const __m256i bytes = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(byteArray + i / 2)));
+      const __m256i nibbles = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi16(bytes, 4), _mm256_slli_epi16(bytes, 8)), mask);
+      __m256i* registers = reinterpret_cast<__m256i*>(synopsis + i);
+      _mm256_storeu_si256(registers, _mm256_max_epu8(_mm256_loadu_si256(registers), _mm256_add_epi8(nibbles, bases)));
+    }
+    return i;
+  }
+};
+#endif
+
+#endif
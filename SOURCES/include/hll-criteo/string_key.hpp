@@ -0,0 +1,25 @@
+#ifndef _STRING_KEY_H_
+#define _STRING_KEY_H_
+
+#include <cstddef>
+#include <stdint.h>
+
+#include "murmur3_hash.hpp"
+#include "murmur_hash.hpp"
+
+/**
+ * 64-bit key of a string or binary value, for Hll<uint64_t> to count like any
+ * BIGINT: the first half of its MurmurHash3_x64_128. Hll hashes the keys again
+ * with its own hash function and seed, so that the synopsis only depends on
+ * those, and two distinct values share a key with probability 2^-64.
+ */
+class StringKey {
+  public:
+    static uint64_t of(const char* data, size_t length) {
+      uint64_t hash[2];
+      MurmurHash3_x64_128(data, static_cast<int>(length), MURMURHASH_DEFAULT_SEED, hash);
+      return hash[0];
+    }
+};
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef _XXH3_HASH_H_
+#define _XXH3_HASH_H_
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include "murmur_hash.hpp"
+
+// The default secret of XXH3, pseudorandom bytes taken from FARSH
+static const uint8_t XXH3_SECRET[192] = {
+  0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+  0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+  0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+  0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+  0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+  0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+  0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+  0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+  0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+  0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+  0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+  0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+/**
+ * The 64-bit XXH3 of xxHash 0.8 (https://github.com/Cyan4973/xxHash, BSD 2-clause),
+ * with the default secret: XXH3_64bits_withSeed() of 8-byte values, and
+ * XXH3_64bits() of byte strings. Only the scalar code paths, which give the
+ * same hashes as the vectorized ones of the reference implementation; strings
+ * are reduced to 64-bit keys with it, and these are short enough for the
+ * scalar loop to be as fast.
+ */
+class Xxh3 {
+  public:
+    static uint64_t hash64(uint64_t value, uint64_t seed) {
+      // the 4 to 8 bytes path, on the little-endian bytes of value
+      seed ^= static_cast<uint64_t>(__builtin_bswap32(static_cast<uint32_t>(seed))) << 32;
+      const uint64_t bitflip = (readLE64(XXH3_SECRET + 8) ^ readLE64(XXH3_SECRET + 16)) - seed;
+      const uint64_t input64 = (value >> 32) + (value << 32);
+      return rrmxmx(input64 ^ bitflip, sizeof(uint64_t));
+    }
+
+    static uint64_t hashBytes(const uint8_t* input, size_t length) {
+      if (length <= 16) {
+        return hash0to16(input, length);
+      }
+      if (length <= 128) {
+        return hash17to128(input, length);
+      }
+      if (length <= MIDSIZE_MAX) {
+        return hash129to240(input, length);
+      }
+      return hashLong(input, length);
+    }
+
+  private:
+    static const size_t SECRET_SIZE = 192;
+    static const size_t SECRET_SIZE_MIN = 136;
+    static const size_t MIDSIZE_MAX = 240;
+    static const size_t STRIPE_LEN = 64;
+    static const size_t SECRET_CONSUME_RATE = 8;
+    static const size_t ACC_NB = STRIPE_LEN / sizeof(uint64_t);
+
+    static const uint32_t PRIME32_1 = 0x9E3779B1U;
+    static const uint32_t PRIME32_2 = 0x85EBCA77U;
+    static const uint32_t PRIME32_3 = 0xC2B2AE3DU;
+    static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+    static const uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+    static const uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+    // little-endian loads, as everywhere else in the synopsis code
+    static inline uint32_t readLE32(const uint8_t* p) {
+      uint32_t value;
+      memcpy(&value, p, sizeof(value));
+      return value;
+    }
+
+    static inline uint64_t readLE64(const uint8_t* p) {
+      uint64_t value;
+      memcpy(&value, p, sizeof(value));
+      return value;
+    }
+
+    static inline uint64_t rotl64(uint64_t value, int bits) {
+      return (value << bits) | (value >> (64 - bits));
+    }
+
+    static inline uint64_t mul128Fold64(uint64_t lhs, uint64_t rhs) {
+      const unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+      return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+    }
+
+    static inline uint64_t xxh64Avalanche(uint64_t hash) {
+      hash ^= hash >> 33;
+      hash *= PRIME64_2;
+      hash ^= hash >> 29;
+      hash *= PRIME64_3;
+      hash ^= hash >> 32;
+      return hash;
+    }
+
+    static inline uint64_t avalanche(uint64_t hash) {
+      hash ^= hash >> 37;
+      hash *= PRIME_MX1;
+      hash ^= hash >> 32;
+      return hash;
+    }
+
+    static inline uint64_t rrmxmx(uint64_t hash, uint64_t length) {
+      hash ^= rotl64(hash, 49) ^ rotl64(hash, 24);
+      hash *= PRIME_MX2;
+      hash ^= (hash >> 35) + length;
+      hash *= PRIME_MX2;
+      return hash ^ (hash >> 28);
+    }
+
+    static inline uint64_t hash0to16(const uint8_t* input, size_t length) {
+      if (length > 8) {
+        const uint64_t low = readLE64(input) ^ (readLE64(XXH3_SECRET + 24) ^ readLE64(XXH3_SECRET + 32));
+        const uint64_t high = readLE64(input + length - 8) ^ (readLE64(XXH3_SECRET + 40) ^ readLE64(XXH3_SECRET + 48));
+        return avalanche(length + __builtin_bswap64(low) + high + mul128Fold64(low, high));
+      }
+      if (length >= 4) {
+        const uint64_t input64 = readLE32(input + length - 4) + (static_cast<uint64_t>(readLE32(input)) << 32);
+        return rrmxmx(input64 ^ (readLE64(XXH3_SECRET + 8) ^ readLE64(XXH3_SECRET + 16)), length);
+      }
+      if (length > 0) {
+        const uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) | (static_cast<uint32_t>(input[length >> 1]) << 24)
+                                | static_cast<uint32_t>(input[length - 1]) | (static_cast<uint32_t>(length) << 8);
+        return xxh64Avalanche(combined ^ (readLE32(XXH3_SECRET) ^ readLE32(XXH3_SECRET + 4)));
+      }
+      return xxh64Avalanche(readLE64(XXH3_SECRET + 56) ^ readLE64(XXH3_SECRET + 64));
+    }
+
+    static inline uint64_t mix16B(const uint8_t* input, const uint8_t* secret) {
+      return mul128Fold64(readLE64(input) ^ readLE64(secret), readLE64(input + 8) ^ readLE64(secret + 8));
+    }
+
+    static inline uint64_t hash17to128(const uint8_t* input, size_t length) {
+      uint64_t acc = length * PRIME64_1;
+      if (length > 32) {
+        if (length > 64) {
+          if (length > 96) {
+            acc += mix16B(input + 48, XXH3_SECRET + 96);
+            acc += mix16B(input + length - 64, XXH3_SECRET + 112);
+          }
+          acc += mix16B(input + 32, XXH3_SECRET + 64);
+          acc += mix16B(input + length - 48, XXH3_SECRET + 80);
+        }
+        acc += mix16B(input + 16, XXH3_SECRET + 32);
+        acc += mix16B(input + length - 32, XXH3_SECRET + 48);
+      }
+      acc += mix16B(input, XXH3_SECRET);
+      acc += mix16B(input + length - 16, XXH3_SECRET + 16);
+      return avalanche(acc);
+    }
+
+    static uint64_t hash129to240(const uint8_t* input, size_t length) {
+      uint64_t acc = length * PRIME64_1;
+      for (size_t i = 0; i < 8; ++i) {
+        acc += mix16B(input + 16 * i, XXH3_SECRET + 16 * i);
+      }
+      acc = avalanche(acc);
+      uint64_t accEnd = mix16B(input + length - 16, XXH3_SECRET + SECRET_SIZE_MIN - 17);
+      for (size_t i = 8; i < length / 16; ++i) {
+        accEnd += mix16B(input + 16 * i, XXH3_SECRET + 16 * (i - 8) + 3);
+      }
+      return avalanche(acc + accEnd);
+    }
+
+    static inline void accumulate512(uint64_t* acc, const uint8_t* input, const uint8_t* secret) {
+      for (size_t lane = 0; lane < ACC_NB; ++lane) {
+        const uint64_t data = readLE64(input + lane * 8);
+        const uint64_t key = data ^ readLE64(secret + lane * 8);
+        acc[lane ^ 1] += data;
+        acc[lane] += static_cast<uint64_t>(static_cast<uint32_t>(key)) * (key >> 32);
+      }
+    }
+
+    static inline void accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+      for (size_t n = 0; n < stripes; ++n) {
+        accumulate512(acc, input + n * STRIPE_LEN, secret + n * SECRET_CONSUME_RATE);
+      }
+    }
+
+    static inline void scramble(uint64_t* acc, const uint8_t* secret) {
+      for (size_t lane = 0; lane < ACC_NB; ++lane) {
+        uint64_t value = acc[lane];
+        value ^= value >> 47;
+        value ^= readLE64(secret + lane * 8);
+        acc[lane] = value * PRIME32_1;
+      }
+    }
+
+    static uint64_t hashLong(const uint8_t* input, size_t length) {
+      uint64_t acc[ACC_NB] = { PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1 };
+      const size_t stripesPerBlock = (SECRET_SIZE - STRIPE_LEN) / SECRET_CONSUME_RATE;
+      const size_t blockLength = STRIPE_LEN * stripesPerBlock;
+      const size_t blocks = (length - 1) / blockLength;
+      for (size_t n = 0; n < blocks; ++n) {
+        accumulate(acc, input + n * blockLength, XXH3_SECRET, stripesPerBlock);
+        scramble(acc, XXH3_SECRET + SECRET_SIZE - STRIPE_LEN);
+      }
+      const size_t stripes = ((length - 1) - blockLength * blocks) / STRIPE_LEN;
+      accumulate(acc, input + blocks * blockLength, XXH3_SECRET, stripes);
+      accumulate512(acc, input + length - STRIPE_LEN, XXH3_SECRET + SECRET_SIZE - STRIPE_LEN - 7);
+
+      uint64_t result = length * PRIME64_1;
+      for (size_t i = 0; i < 4; ++i) {
+        result += mul128Fold64(acc[2 * i] ^ readLE64(XXH3_SECRET + 11 + 16 * i), acc[2 * i + 1] ^ readLE64(XXH3_SECRET + 11 + 16 * i + 8));
+      }
+      return avalanche(result);
+    }
+};
+
+template<typename T>
+class Xxh3Hash : public Hash<T> {};
+
+template<>
+class Xxh3Hash<uint64_t> final : public Hash<uint64_t> {
+  public:
+    static const uint8_t ID = 2;
+
+    uint64_t operator()(uint64_t value, uint32_t seed = MURMURHASH_DEFAULT_SEED) const override {
+      return hash(value, seed);
+    }
+
+    void hashBatch(const uint64_t* values, size_t n, uint64_t* hashes, uint32_t seed = MURMURHASH_DEFAULT_SEED) const {
+      for (size_t i = 0; i < n; ++i) {
+        hashes[i] = hash(values[i], seed);
+      }
+    }
+
+    static inline uint64_t hash(uint64_t value, uint32_t seed) {
+      return Xxh3::hash64(value, seed);
+    }
+};
+
+#endif
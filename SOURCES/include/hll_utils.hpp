@@ -5,6 +5,8 @@
 
 #define __packed__ __attribute__((packed))
 #define __const_fun__ __attribute__((const))
+// Compiles a function for the given instruction set, whatever -march the file is built with
+#define __target_isa__(isa) __attribute__((target(isa)))
 
 
 // c.f. https://en.wikipedia.org/wiki/Double-precision_floating-point_format
@@ -20,5 +22,44 @@ static inline __const_fun__ double fast_inv_pow2(const uint8_t pow) {
   return res.d;
 }
 
+// Bytes LEB128 takes for value: 7 bits per byte, the high bit set on all but the last
+static inline __const_fun__ uint32_t varint_size(uint32_t value) {
+  uint32_t bytes = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++bytes;
+  }
+  return bytes;
+}
+
+static inline uint32_t write_varint(uint8_t* out, uint32_t value) {
+  uint32_t bytes = 0;
+  while (value >= 0x80) {
+    out[bytes++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  out[bytes++] = static_cast<uint8_t>(value);
+  return bytes;
+}
+
+/*
+ * Reads a varint at in and moves in past it. Returns false if it runs past end
+ * or doesn't fit in 32 bits, which only a corrupted payload can bring.
+ */
+static inline bool read_varint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+  value = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (in == end) {
+      return false;
+    }
+    const uint8_t byte = *in++;
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return true;
+    }
+  }
+  return false;
+}
+
 
 #endif
@@ -9,18 +9,83 @@ AS LANGUAGE 'C++'
 NAME 'HllCreateSynopsisFactory' 
 LIBRARY HllLib;
 
+CREATE OR REPLACE AGGREGATE FUNCTION HllCreateSynopsis
+AS LANGUAGE 'C++'
+NAME 'HllCreateSynopsisVarcharFactory'
+LIBRARY HllLib;
+
+CREATE OR REPLACE AGGREGATE FUNCTION HllCreateSynopsis
+AS LANGUAGE 'C++'
+NAME 'HllCreateSynopsisVarbinaryFactory'
+LIBRARY HllLib;
+
 GRANT EXECUTE ON AGGREGATE FUNCTION HllCreateSynopsis(BIGINT) TO PUBLIC;
+GRANT EXECUTE ON AGGREGATE FUNCTION HllCreateSynopsis(VARCHAR) TO PUBLIC;
+GRANT EXECUTE ON AGGREGATE FUNCTION HllCreateSynopsis(VARBINARY) TO PUBLIC;
 
 CREATE OR REPLACE AGGREGATE FUNCTION HllDistinctCount
 AS LANGUAGE 'C++'
 NAME 'HllDistinctCountFactory'
 LIBRARY HllLib;
 
+CREATE OR REPLACE AGGREGATE FUNCTION HllImprovedDistinctCount
+AS LANGUAGE 'C++'
+NAME 'HllImprovedDistinctCountFactory'
+LIBRARY HllLib;
+
 CREATE OR REPLACE AGGREGATE FUNCTION HllCombine
 AS LANGUAGE 'C++'
 NAME 'HllCombineFactory'
 LIBRARY HllLib;
 
 GRANT EXECUTE ON AGGREGATE FUNCTION HllDistinctCount(VARBINARY) TO PUBLIC;
+GRANT EXECUTE ON AGGREGATE FUNCTION HllImprovedDistinctCount(VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE FUNCTION HllEstimate
+AS LANGUAGE 'C++'
+NAME 'HllEstimateFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON FUNCTION HllEstimate(VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE FUNCTION HllUnionCount
+AS LANGUAGE 'C++'
+NAME 'HllUnionCountFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON FUNCTION HllUnionCount(VARBINARY, VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE FUNCTION HllIntersectCount
+AS LANGUAGE 'C++'
+NAME 'HllIntersectCountFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON FUNCTION HllIntersectCount(VARBINARY, VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE ANALYTIC FUNCTION HllRollingDistinctCount
+AS LANGUAGE 'C++'
+NAME 'HllRollingDistinctCountFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON ANALYTIC FUNCTION HllRollingDistinctCount(VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE TRANSFORM FUNCTION HllRunningCount
+AS LANGUAGE 'C++'
+NAME 'HllRunningCountFactory'
+LIBRARY HllLib;
+
+CREATE OR REPLACE TRANSFORM FUNCTION HllRunningCount
+AS LANGUAGE 'C++'
+NAME 'HllRunningCountVarcharFactory'
+LIBRARY HllLib;
+
+CREATE OR REPLACE TRANSFORM FUNCTION HllRunningCount
+AS LANGUAGE 'C++'
+NAME 'HllRunningCountVarbinaryFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON TRANSFORM FUNCTION HllRunningCount(BIGINT) TO PUBLIC;
+GRANT EXECUTE ON TRANSFORM FUNCTION HllRunningCount(VARCHAR) TO PUBLIC;
+GRANT EXECUTE ON TRANSFORM FUNCTION HllRunningCount(VARBINARY) TO PUBLIC;
 
 
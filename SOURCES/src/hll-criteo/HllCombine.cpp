@@ -13,23 +13,35 @@ class HllCombine : public AggregateFunction
 {
 
   vint hllLeadingBits;
+  const HllKernels<uint64_t> *kernels;
+  uint8_t* foldScratch;
   Format format;
+  bool checksum;
+  FormatCounter formatCounter;
 
 public:
 
   virtual void setup(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
     this -> hllLeadingBits = readSubStreamBits(srvInterface);
+    this -> kernels = &selectKernels(hllLeadingBits);
+    this -> foldScratch = vt_allocArray(srvInterface.allocator, uint8_t,
+      HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
     this -> format = readSerializationFormat(srvInterface);
+    this -> checksum = readChecksum(srvInterface);
+  }
+
+  virtual void destroy(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
+    formatCounter.log(srvInterface, "HllCombine");
   }
 
   virtual void initAggregate(ServerInterface &srvInterface, IntermediateAggs &aggs)
    {
     try
     {
-      size_t maxSize = Hll<uint64_t>::getMaxDeserializedBufferSize(hllLeadingBits);
+      size_t maxSize = HllView<uint64_t>::getMaxDeserializedBufferSize(hllLeadingBits);
       aggs.getStringRef(0).alloc(maxSize);
-      Hll<uint64_t> hll = Hll<uint64_t>::wrapRawBuffer(
-        hllLeadingBits,
+      HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+        *kernels,
         reinterpret_cast<uint8_t *>(aggs.getStringRef(0).data()),
         aggs.getTypeMetaData().getColumnType(0).getStringLength()
       );
@@ -46,17 +58,12 @@ public:
                  IntermediateAggs &aggs)
   {
     try {
-      Hll<uint64_t> hll = Hll<uint64_t>::wrapRawBuffer(
-        hllLeadingBits,
+      HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+        *kernels,
         reinterpret_cast<uint8_t *>(aggs.getStringRef(0).data()),
         aggs.getTypeMetaData().getColumnType(0).getStringLength()
       );
-      do {
-        hll.fold(
-          reinterpret_cast<const uint8_t *>(argReader.getStringRef(0).data()),
-          argReader.getStringRef(0).length()
-        );
-      } while (argReader.next());
+      foldAll(hll, argReader, foldScratch);
     } catch(SerializationError& e) {
       vt_report_error(0, e.what());
     }
@@ -67,17 +74,12 @@ public:
                        MultipleIntermediateAggs &aggsOther)
   {
     try {
-      Hll<uint64_t> hll = Hll<uint64_t>::wrapRawBuffer(
-        hllLeadingBits,
+      HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+        *kernels,
         reinterpret_cast<uint8_t *>(aggs.getStringRef(0).data()),
         aggs.getTypeMetaData().getColumnType(0).getStringLength()
       );
-      do {
-        hll.fold(
-          reinterpret_cast<const uint8_t *>(aggsOther.getStringRef(0).data()),
-          aggsOther.getStringRef(0).length()
-        );
-      } while (aggsOther.next());
+      foldAll(hll, aggsOther, foldScratch);
     } catch(SerializationError& e) {
       vt_report_error(0, e.what());
     }
@@ -88,24 +90,21 @@ public:
                          IntermediateAggs &aggs)
   {
     try {
-      Hll<uint64_t> hll = Hll<uint64_t>::wrapRawBuffer(
-        hllLeadingBits,
+      HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+        *kernels,
         reinterpret_cast<uint8_t *>(aggs.getStringRef(0).data()),
         aggs.getTypeMetaData().getColumnType(0).getStringLength()
       );
-      if (hll.isBetterSerializedSparse()) {
-        resWriter.getStringRef().alloc(hll.getSerializedBufferSize(Format::SPARSE));
-        hll.serialize(
-          reinterpret_cast<uint8_t *>(resWriter.getStringRef().data()),
-          Format::SPARSE
-        );
-      } else {
-        resWriter.getStringRef().alloc(hll.getSerializedBufferSize(format));
-        hll.serialize(
-          reinterpret_cast<uint8_t *>(resWriter.getStringRef().data()),
-          format
-        );
-      }
+      hll.setChecksum(checksum);
+      const RegisterHistogram histogram = hll.histogram();
+      const Format outputFormat = hll.serializationFormat(format, histogram);
+      formatCounter.count(outputFormat);
+      resWriter.getStringRef().alloc(hll.getSerializedBufferSize(outputFormat, histogram));
+      hll.serialize(
+        reinterpret_cast<uint8_t *>(resWriter.getStringRef().data()),
+        outputFormat,
+        histogram
+      );
 
       resWriter.next();
     } catch(SerializationError& e) {
@@ -125,7 +124,7 @@ class HllCombineFactory : public AggregateFunctionFactory
                                     SizedColumnTypes &intermediateTypeMetaData)
   {
     uint8_t precision = readSubStreamBits(srvInterface);
-    intermediateTypeMetaData.addVarbinary(Hll<uint64_t>::getMaxDeserializedBufferSize(precision) + sizeof(HLLHdr));
+    intermediateTypeMetaData.addVarbinary(HllView<uint64_t>::getMaxDeserializedBufferSize(precision) + sizeof(HLLHdr));
   }
 
 
@@ -143,7 +142,7 @@ class HllCombineFactory : public AggregateFunctionFactory
   {
     Format format = readSerializationFormat(srvInterface);
     uint8_t precision = readSubStreamBits(srvInterface);
-    outputTypes.addVarbinary(Hll<uint64_t>::getMaxSerializedBufferSize(format, precision));
+    outputTypes.addVarbinary(HllView<uint64_t>::getMaxSerializedBufferSize(format, precision));
   }
 
   virtual AggregateFunction *createAggregateFunction(ServerInterface &srvInterface)
@@ -164,6 +163,9 @@ class HllCombineFactory : public AggregateFunctionFactory
 
     props.comment = "Serialization/deserialization bits per bucket";
     parameterTypes.addInt(HLL_BITS_PER_BUCKET_PARAMETER_NAME, props);
+
+    props.comment = "Whether the synopsis carries a checksum of its payload";
+    parameterTypes.addBool(HLL_CHECKSUM_PARAMETER_NAME, props);
   }
 };
 
@@ -13,26 +13,46 @@ class HllCreateSynopsis : public AggregateFunction
 {
 
   vint hllLeadingBits;
+  const HllKernels<uint64_t> *kernels;
+  uint8_t* foldScratch;
   Format format;
+  bool checksum;
+  const HashFunction *hashFunction;
+  // VARCHAR or VARBINARY values, counted by the key of their hash function
+  bool stringInput;
+  FormatCounter formatCounter;
 
 public:
 
   virtual void setup(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
+    this -> stringInput = argTypes.getColumnType(0).isStringType();
     this -> hllLeadingBits = readSubStreamBits(srvInterface);
+    this -> kernels = &selectKernels(hllLeadingBits);
+    this -> foldScratch = vt_allocArray(srvInterface.allocator, uint8_t,
+      HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
     this -> format = readSerializationFormat(srvInterface);
+    this -> checksum = readChecksum(srvInterface);
+    this -> hashFunction = &readHashFunction(srvInterface);
+  }
+
+  virtual void destroy(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
+    formatCounter.log(srvInterface, "HllCreateSynopsis");
   }
 
   virtual void initAggregate(ServerInterface &srvInterface, IntermediateAggs &aggs)
   {
     try {
-      size_t maxSize = Hll<uint64_t>::getMaxDeserializedBufferSize(hllLeadingBits);
+      size_t maxSize = HllView<uint64_t>::getMaxDeserializedBufferSize(hllLeadingBits, true);
       aggs.getStringRef(0).alloc(maxSize);
-      Hll<uint64_t> hll = Hll<uint64_t>::wrapRawBuffer(
-        hllLeadingBits,
+      HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+        *kernels,
         reinterpret_cast<uint8_t *>(aggs.getStringRef(0).data()),
         aggs.getTypeMetaData().getColumnType(0).getStringLength()
       );
-      hll.reset();
+      // most groups see few values: start sparse rather than clearing 2^p registers
+      hll.resetSparse();
+      // and the dense ones need no pass over their registers for the format and its base in terminate()
+      hll.trackHistogram();
     } catch (std::exception &e)
     {
       vt_report_error(0, "Exception while initializing intermediate aggregates: [%s] [%d]", e.what(), hllLeadingBits);
@@ -44,36 +64,62 @@ public:
                  IntermediateAggs &aggs)
   {
     try {
-      Hll<uint64_t> hll = Hll<uint64_t>::wrapRawBuffer(
-        hllLeadingBits,
+      HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+        *kernels,
         reinterpret_cast<uint8_t *>(aggs.getStringRef(0).data()),
         aggs.getTypeMetaData().getColumnType(0).getStringLength()
       );
-      do {
-        const vint &currentValue = argReader.getIntRef(0);
-        hll.add(currentValue);
-      } while (argReader.next());
+      uint64_t values[HLL_ADD_BATCH_SIZE];
+      uint64_t hashes[HLL_ADD_BATCH_SIZE];
+      size_t count = 0;
+      if (stringInput) {
+        // the keys are computed from the block in place, and NULLs aren't counted as in COUNT(DISTINCT)
+        do {
+          const VString& value = argReader.getStringRef(0);
+          if (value.isNull()) {
+            continue;
+          }
+          values[count++] = hashFunction->key(value.data(), value.length());
+          if (count == HLL_ADD_BATCH_SIZE) {
+            addBatch(hll, values, hashes, count);
+            count = 0;
+          }
+        } while (argReader.next());
+      } else {
+        do {
+          if (argReader.getIntRef(0) == vint_null) {
+            continue;
+          }
+          values[count++] = argReader.getIntRef(0);
+          if (count == HLL_ADD_BATCH_SIZE) {
+            addBatch(hll, values, hashes, count);
+            count = 0;
+          }
+        } while (argReader.next());
+      }
+      addBatch(hll, values, hashes, count);
     } catch(SerializationError& e) {
       vt_report_error(0, e.what());
     }
   }
 
+  // Hashes count values with the hash function of the hashFunction parameter and adds them
+  void addBatch(HllView<uint64_t>& hll, const uint64_t* values, uint64_t* hashes, size_t count) {
+    hashFunction->hashBatch(values, count, hashes, hll.getHashSeed());
+    hll.addHashes(hashes, count, hashFunction->id);
+  }
+
   virtual void combine(ServerInterface &srvInterface,
                        IntermediateAggs &aggs,
                        MultipleIntermediateAggs &aggsOther)
   {
     try {
-      Hll<uint64_t> hll = Hll<uint64_t>::wrapRawBuffer(
-        hllLeadingBits,
+      HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+        *kernels,
         reinterpret_cast<uint8_t *>(aggs.getStringRef(0).data()),
         aggs.getTypeMetaData().getColumnType(0).getStringLength()
       );
-      do {
-        hll.fold(
-          reinterpret_cast<const uint8_t *>(aggsOther.getStringRef(0).data()),
-          aggsOther.getStringRef(0).length()
-        );
-      } while (aggsOther.next());
+      foldAll(hll, aggsOther, foldScratch);
     } catch(SerializationError& e) {
       vt_report_error(0, e.what());
     }
@@ -84,24 +130,22 @@ public:
                          IntermediateAggs &aggs)
   {
     try {
-      Hll<uint64_t> hll = Hll<uint64_t>::wrapRawBuffer(
-        hllLeadingBits,
+      HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+        *kernels,
         reinterpret_cast<uint8_t *>(aggs.getStringRef(0).data()),
         aggs.getTypeMetaData().getColumnType(0).getStringLength()
       );
-      if (hll.isBetterSerializedSparse()) {
-        resWriter.getStringRef().alloc(hll.getSerializedBufferSize(Format::SPARSE));
-        hll.serialize(
-          reinterpret_cast<uint8_t *>(resWriter.getStringRef().data()),
-          Format::SPARSE
-        );
-      } else {
-        resWriter.getStringRef().alloc(hll.getSerializedBufferSize(format));
-        hll.serialize(
-          reinterpret_cast<uint8_t *>(resWriter.getStringRef().data()),
-          format
-          );
-      }
+      hll.toDense();
+      hll.setChecksum(checksum);
+      const RegisterHistogram histogram = hll.histogram();
+      const Format outputFormat = hll.serializationFormat(format, histogram);
+      formatCounter.count(outputFormat);
+      resWriter.getStringRef().alloc(hll.getSerializedBufferSize(outputFormat, histogram));
+      hll.serialize(
+        reinterpret_cast<uint8_t *>(resWriter.getStringRef().data()),
+        outputFormat,
+        histogram
+      );
 
       resWriter.next();
     } catch(SerializationError& e) {
@@ -121,7 +165,7 @@ class HllCreateSynopsisFactory : public AggregateFunctionFactory
                                     SizedColumnTypes &intermediateTypeMetaData)
   {
     uint8_t precision = readSubStreamBits(srvInterface);
-    intermediateTypeMetaData.addVarbinary(Hll<uint64_t>::getMaxDeserializedBufferSize(precision));
+    intermediateTypeMetaData.addVarbinary(HllView<uint64_t>::getMaxDeserializedBufferSize(precision, true));
   }
 
 
@@ -139,7 +183,7 @@ class HllCreateSynopsisFactory : public AggregateFunctionFactory
   {
     Format format = readSerializationFormat(srvInterface);
     uint8_t precision = readSubStreamBits(srvInterface);
-    outputTypes.addVarbinary(Hll<uint64_t>::getMaxSerializedBufferSize(format, precision));
+    outputTypes.addVarbinary(HllView<uint64_t>::getMaxSerializedBufferSize(format, precision));
   }
 
   virtual AggregateFunction *createAggregateFunction(ServerInterface &srvInterface)
@@ -160,8 +204,39 @@ class HllCreateSynopsisFactory : public AggregateFunctionFactory
 
     props.comment = "Serialization/deserialization bits per bucket";
     parameterTypes.addInt(HLL_BITS_PER_BUCKET_PARAMETER_NAME, props);
+
+    props.comment = "Whether the synopsis carries a checksum of its payload";
+    parameterTypes.addBool(HLL_CHECKSUM_PARAMETER_NAME, props);
+
+    props.comment = "Hash function of the values: murmur, xxh3 or mix64";
+    parameterTypes.addVarchar(16, HLL_HASH_FUNCTION_PARAMETER_NAME, props);
   }
 
 };
 
+// The same function over VARCHAR and VARBINARY values, installed under the same name
+class HllCreateSynopsisVarcharFactory : public HllCreateSynopsisFactory
+{
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addVarchar();
+    returnType.addVarbinary();
+  }
+};
+
+class HllCreateSynopsisVarbinaryFactory : public HllCreateSynopsisFactory
+{
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addVarbinary();
+    returnType.addVarbinary();
+  }
+};
+
 RegisterFactory(HllCreateSynopsisFactory);
+RegisterFactory(HllCreateSynopsisVarcharFactory);
+RegisterFactory(HllCreateSynopsisVarbinaryFactory);
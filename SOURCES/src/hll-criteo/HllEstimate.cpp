@@ -0,0 +1,94 @@
+#include "Vertica.h"
+#include "hll-criteo/hll.hpp"
+#include "hll-criteo/hll_vertica.hpp"
+
+/**
+ * HllDistinctCount of a single synopsis, as a scalar function: each synopsis
+ * is estimated from its own bytes with Hll::histogramOf(), at the precision
+ * in its header (hllLeadingBits for the synopses that don't record it), with
+ * neither an intermediate aggregate nor a GROUP BY for every row.
+ */
+class HllEstimate : public ScalarFunction
+{
+
+  vint hllLeadingBits;
+  // registers for the payloads histogramOf() has to fold, of the largest precision
+  uint8_t* scratch;
+
+public:
+
+  virtual void setup(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
+    this -> hllLeadingBits = readSubStreamBits(srvInterface);
+    this -> scratch = vt_allocArray(srvInterface.allocator, uint8_t,
+      HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
+  }
+
+  virtual void processBlock(ServerInterface &srvInterface,
+                            BlockReader &argReader,
+                            BlockWriter &resWriter)
+  {
+    try {
+      do {
+        const VString& synopsis = argReader.getStringRef(0);
+        if (synopsis.isNull()) {
+          resWriter.setNull();
+        } else {
+          const uint8_t* byteArray = reinterpret_cast<const uint8_t *>(synopsis.data());
+          const uint8_t precision = HllView<uint64_t>::precisionOf(byteArray, synopsis.length(), hllLeadingBits);
+          HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+            selectKernels(precision),
+            scratch,
+            HllView<uint64_t>::getMaxDeserializedBufferSize(precision)
+          );
+          resWriter.setInt(hll.approximateCountDistinct(hll.histogramOf(byteArray, synopsis.length())));
+        }
+        resWriter.next();
+      } while (argReader.next());
+    } catch(SerializationError& e) {
+      vt_report_error(0, e.what());
+    }
+  }
+};
+
+
+class HllEstimateFactory : public ScalarFunctionFactory
+{
+public:
+  HllEstimateFactory() {
+    vol = IMMUTABLE;
+    strict = STRICT;
+  }
+
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addVarbinary();
+    returnType.addInt();
+  }
+
+  virtual void getReturnType(ServerInterface &srvInterface,
+                             const SizedColumnTypes &argTypes,
+                             SizedColumnTypes &returnType)
+  {
+    returnType.addInt();
+  }
+
+  virtual ScalarFunction *createScalarFunction(ServerInterface &srvInterface)
+  {
+    return vt_createFuncObject<HllEstimate>(srvInterface.allocator);
+  }
+
+  virtual void getParameterType(ServerInterface &srvInterface,
+                                SizedColumnTypes &parameterTypes)
+  {
+    SizedColumnTypes::Properties props;
+    props.required = false;
+    props.canBeNull = false;
+    props.comment = "Precision bits of the synopses that don't record it";
+    parameterTypes.addInt(HLL_ARRAY_SIZE_PARAMETER_NAME, props);
+  }
+
+};
+
+RegisterFactory(HllEstimateFactory);
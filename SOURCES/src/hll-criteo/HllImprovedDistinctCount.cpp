@@ -0,0 +1,7 @@
+#include "hll-criteo/hll_distinct_count.hpp"
+
+class HllImprovedDistinctCountFactory : public DistinctCountFactory<&HllView<uint64_t>::approximateCountDistinct_improved>
+{
+};
+
+RegisterFactory(HllImprovedDistinctCountFactory);
@@ -0,0 +1,114 @@
+#include <algorithm>
+
+#include "Vertica.h"
+#include "hll-criteo/hll.hpp"
+#include "hll-criteo/hll_vertica.hpp"
+
+/**
+ * Estimate of the intersection of two synopses, as a scalar function. Each
+ * is folded into registers of the lower of their precisions, and the
+ * intersection comes from Hll::jointEstimate(), the maximum likelihood
+ * estimate given how their registers compare, rather than from the
+ * difference of HllDistinctCount of each and of their union, whose error is
+ * that of the union and can even make it negative.
+ */
+class HllIntersectCount : public ScalarFunction
+{
+
+  vint hllLeadingBits;
+  // registers of each synopsis, of the largest precision
+  uint8_t* firstScratch;
+  uint8_t* secondScratch;
+  // registers of the synopsis of the higher precision, see Hll::setFoldScratch()
+  uint8_t* foldScratch;
+
+public:
+
+  virtual void setup(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
+    this -> hllLeadingBits = readSubStreamBits(srvInterface);
+    const size_t size = HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE);
+    this -> firstScratch = vt_allocArray(srvInterface.allocator, uint8_t, size);
+    this -> secondScratch = vt_allocArray(srvInterface.allocator, uint8_t, size);
+    this -> foldScratch = vt_allocArray(srvInterface.allocator, uint8_t, size);
+  }
+
+  virtual void processBlock(ServerInterface &srvInterface,
+                            BlockReader &argReader,
+                            BlockWriter &resWriter)
+  {
+    try {
+      do {
+        const VString& first = argReader.getStringRef(0);
+        const VString& second = argReader.getStringRef(1);
+        if (first.isNull() || second.isNull()) {
+          resWriter.setNull();
+        } else {
+          const uint8_t* firstArray = reinterpret_cast<const uint8_t *>(first.data());
+          const uint8_t* secondArray = reinterpret_cast<const uint8_t *>(second.data());
+          const uint8_t precision = std::min(
+            HllView<uint64_t>::precisionOf(firstArray, first.length(), hllLeadingBits),
+            HllView<uint64_t>::precisionOf(secondArray, second.length(), hllLeadingBits));
+          const HllKernels<uint64_t>& kernels = selectKernels(precision);
+          const size_t size = HllView<uint64_t>::getMaxDeserializedBufferSize(precision);
+          HllView<uint64_t> firstHll = HllView<uint64_t>::wrapRawBuffer(kernels, firstScratch, size);
+          HllView<uint64_t> secondHll = HllView<uint64_t>::wrapRawBuffer(kernels, secondScratch, size);
+          const size_t foldScratchSize = HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE);
+          firstHll.setFoldScratch(foldScratch, foldScratchSize);
+          secondHll.setFoldScratch(foldScratch, foldScratchSize);
+          firstHll.reset();
+          firstHll.fold(firstArray, first.length());
+          secondHll.reset();
+          secondHll.fold(secondArray, second.length());
+          resWriter.setInt(firstHll.jointEstimate(secondHll).both);
+        }
+        resWriter.next();
+      } while (argReader.next());
+    } catch(SerializationError& e) {
+      vt_report_error(0, e.what());
+    }
+  }
+};
+
+
+class HllIntersectCountFactory : public ScalarFunctionFactory
+{
+public:
+  HllIntersectCountFactory() {
+    vol = IMMUTABLE;
+    strict = STRICT;
+  }
+
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addVarbinary();
+    argTypes.addVarbinary();
+    returnType.addInt();
+  }
+
+  virtual void getReturnType(ServerInterface &srvInterface,
+                             const SizedColumnTypes &argTypes,
+                             SizedColumnTypes &returnType)
+  {
+    returnType.addInt();
+  }
+
+  virtual ScalarFunction *createScalarFunction(ServerInterface &srvInterface)
+  {
+    return vt_createFuncObject<HllIntersectCount>(srvInterface.allocator);
+  }
+
+  virtual void getParameterType(ServerInterface &srvInterface,
+                                SizedColumnTypes &parameterTypes)
+  {
+    SizedColumnTypes::Properties props;
+    props.required = false;
+    props.canBeNull = false;
+    props.comment = "Precision bits of the synopses that don't record it";
+    parameterTypes.addInt(HLL_ARRAY_SIZE_PARAMETER_NAME, props);
+  }
+
+};
+
+RegisterFactory(HllIntersectCountFactory);
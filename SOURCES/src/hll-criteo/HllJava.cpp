@@ -48,12 +48,12 @@ extern "C" int compact(char* arr, char* output) {
   hll.reset();
   hll.fold(reinterpret_cast<uint8_t*>(arr), bufferSize);
 
-  if (hll.isBetterSerializedSparse()) {
+  if (hll.isBetterSerializedSparse(format)) {
     hll.serialize(
       reinterpret_cast<uint8_t *>(output),
-      Format::SPARSE
+      Format::SPARSE_VARINT
     );
-    return hll.getSerializedBufferSize(Format::SPARSE);
+    return hll.getSerializedBufferSize(Format::SPARSE_VARINT);
   } else {
     hll.serialize(
       reinterpret_cast<uint8_t*>(output),
@@ -0,0 +1,99 @@
+#include "Vertica.h"
+#include "hll-criteo/hll.hpp"
+#include "hll-criteo/hll_vertica.hpp"
+#include "hll-criteo/hll_window.hpp"
+
+/**
+ * HllDistinctCount over a sliding window of rows, as an analytic function:
+ * for every row of a partition, in the order of its ORDER BY, the estimate of
+ * the union of the synopses of the windowRows rows up to it (of every row up
+ * to it for windowRows=0). With one synopsis per day, it gives the rolling
+ * 7 or 30-day uniques without a self-join and a HllCombine per window.
+ * HllWindow keeps the window, so that a row takes a few folds whatever its
+ * size, in a buffer allocated once for all partitions.
+ */
+class HllRollingDistinctCount : public AnalyticFunction
+{
+
+  vint hllLeadingBits;
+  uint32_t windowRows;
+  const HllKernels<uint64_t> *kernels;
+  uint8_t* buffer;
+  // registers for the synopses of a higher precision to fold, see Hll::setFoldScratch()
+  uint8_t* foldScratch;
+
+public:
+
+  virtual void setup(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
+    this -> hllLeadingBits = readSubStreamBits(srvInterface);
+    this -> windowRows = readWindowRows(srvInterface, hllLeadingBits);
+    this -> kernels = &selectKernels(hllLeadingBits);
+    this -> buffer = vt_allocArray(srvInterface.allocator, uint8_t,
+      HllWindow<uint64_t>::getBufferSize(hllLeadingBits, windowRows));
+    this -> foldScratch = vt_allocArray(srvInterface.allocator, uint8_t,
+      HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
+  }
+
+  virtual void processPartition(ServerInterface &srvInterface,
+                                AnalyticPartitionReader &inputReader,
+                                AnalyticPartitionWriter &outputWriter)
+  {
+    try {
+      HllWindow<uint64_t> window(*kernels, buffer, windowRows);
+      window.setFoldScratch(foldScratch, HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
+      window.reset();
+      do {
+        const VString& synopsis = inputReader.getStringRef(0);
+        if (synopsis.isNull()) {
+          window.push(nullptr, 0);
+        } else {
+          window.push(reinterpret_cast<const uint8_t *>(synopsis.data()), synopsis.length());
+        }
+        outputWriter.setInt(0, window.approximateCountDistinct());
+        outputWriter.next();
+      } while (inputReader.next());
+    } catch(SerializationError& e) {
+      vt_report_error(0, e.what());
+    }
+  }
+};
+
+
+class HllRollingDistinctCountFactory : public AnalyticFunctionFactory
+{
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addVarbinary();
+    returnType.addInt();
+  }
+
+  virtual void getReturnType(ServerInterface &srvInterface,
+                             const SizedColumnTypes &inputTypes,
+                             SizedColumnTypes &outputTypes)
+  {
+    outputTypes.addInt();
+  }
+
+  virtual AnalyticFunction *createAnalyticFunction(ServerInterface &srvInterface)
+  {
+    return vt_createFuncObject<HllRollingDistinctCount>(srvInterface.allocator);
+  }
+
+  virtual void getParameterType(ServerInterface &srvInterface,
+                                SizedColumnTypes &parameterTypes)
+  {
+    SizedColumnTypes::Properties props;
+    props.required = false;
+    props.canBeNull = false;
+    props.comment = "Precision bits";
+    parameterTypes.addInt(HLL_ARRAY_SIZE_PARAMETER_NAME, props);
+
+    props.comment = "Number of rows of the window, 0 for every row from the start of the partition";
+    parameterTypes.addInt(HLL_WINDOW_ROWS_PARAMETER_NAME, props);
+  }
+
+};
+
+RegisterFactory(HllRollingDistinctCountFactory);
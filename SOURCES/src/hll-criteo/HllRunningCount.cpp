@@ -0,0 +1,155 @@
+#include "Vertica.h"
+#include "hll-criteo/hll.hpp"
+#include "hll-criteo/hll_vertica.hpp"
+
+/**
+ * Running distinct count of the values of a partition, as a transform
+ * function: in the order of its ORDER BY, every emitEvery rows and after the
+ * last one, the number of rows so far and the estimate of their distinct
+ * values. The values go into a single synopsis that keeps its histogram (see
+ * Hll::trackHistogram()) up to date as registers grow, so that an estimate
+ * takes a few operations instead of a pass over the registers, and "uniques
+ * to date" needs no HllCreateSynopsis over every prefix.
+ */
+class HllRunningCount : public TransformFunction
+{
+
+  vint hllLeadingBits;
+  vint emitEvery;
+  const HllKernels<uint64_t> *kernels;
+  const HashFunction *hashFunction;
+  // VARCHAR or VARBINARY values, counted by the key of their hash function
+  bool stringInput;
+  uint8_t* buffer;
+
+public:
+
+  virtual void setup(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
+    this -> stringInput = argTypes.getColumnType(0).isStringType();
+    this -> hllLeadingBits = readSubStreamBits(srvInterface);
+    this -> emitEvery = readEmitEvery(srvInterface);
+    this -> kernels = &selectKernels(hllLeadingBits);
+    this -> hashFunction = &readHashFunction(srvInterface);
+    this -> buffer = vt_allocArray(srvInterface.allocator, uint8_t,
+      HllView<uint64_t>::getMaxDeserializedBufferSize(hllLeadingBits, true));
+  }
+
+  virtual void processPartition(ServerInterface &srvInterface,
+                                PartitionReader &inputReader,
+                                PartitionWriter &outputWriter)
+  {
+    try {
+      HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+        *kernels,
+        buffer,
+        HllView<uint64_t>::getMaxDeserializedBufferSize(hllLeadingBits, true)
+      );
+      hll.reset();
+      hll.trackHistogram();
+      uint64_t values[HLL_ADD_BATCH_SIZE];
+      uint64_t hashes[HLL_ADD_BATCH_SIZE];
+      size_t count = 0;
+      vint rows = 0;
+      bool more;
+      do {
+        // NULLs aren't counted, as in COUNT(DISTINCT), but they are rows
+        if (stringInput) {
+          const VString& value = inputReader.getStringRef(0);
+          if (!value.isNull()) {
+            values[count++] = hashFunction->key(value.data(), value.length());
+          }
+        } else if (inputReader.getIntRef(0) != vint_null) {
+          values[count++] = inputReader.getIntRef(0);
+        }
+        ++rows;
+        more = inputReader.next();
+        const bool emit = rows % emitEvery == 0 || !more;
+        if (count == HLL_ADD_BATCH_SIZE || emit) {
+          hashFunction->hashBatch(values, count, hashes, hll.getHashSeed());
+          hll.addHashes(hashes, count, hashFunction->id);
+          count = 0;
+        }
+        if (emit) {
+          outputWriter.setInt(0, rows);
+          outputWriter.setInt(1, hll.approximateCountDistinct());
+          outputWriter.next();
+        }
+      } while (more);
+    } catch(SerializationError& e) {
+      vt_report_error(0, e.what());
+    }
+  }
+};
+
+
+class HllRunningCountFactory : public TransformFunctionFactory
+{
+
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addInt();
+    returnType.addInt();
+    returnType.addInt();
+  }
+
+  virtual void getReturnType(ServerInterface &srvInterface,
+                             const SizedColumnTypes &inputTypes,
+                             SizedColumnTypes &outputTypes)
+  {
+    outputTypes.addInt("row_count");
+    outputTypes.addInt("distinct_count");
+  }
+
+  virtual TransformFunction *createTransformFunction(ServerInterface &srvInterface)
+  {
+    return vt_createFuncObject<HllRunningCount>(srvInterface.allocator);
+  }
+
+  virtual void getParameterType(ServerInterface &srvInterface,
+                                SizedColumnTypes &parameterTypes)
+  {
+    SizedColumnTypes::Properties props;
+    props.required = false;
+    props.canBeNull = false;
+    props.comment = "Precision bits";
+    parameterTypes.addInt(HLL_ARRAY_SIZE_PARAMETER_NAME, props);
+
+    props.comment = "Number of rows between two estimates";
+    parameterTypes.addInt(HLL_EMIT_EVERY_PARAMETER_NAME, props);
+
+    props.comment = "Hash function of the values: murmur, xxh3 or mix64";
+    parameterTypes.addVarchar(16, HLL_HASH_FUNCTION_PARAMETER_NAME, props);
+  }
+
+};
+
+// The same function over VARCHAR and VARBINARY values, installed under the same name
+class HllRunningCountVarcharFactory : public HllRunningCountFactory
+{
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addVarchar();
+    returnType.addInt();
+    returnType.addInt();
+  }
+};
+
+class HllRunningCountVarbinaryFactory : public HllRunningCountFactory
+{
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addVarbinary();
+    returnType.addInt();
+    returnType.addInt();
+  }
+};
+
+RegisterFactory(HllRunningCountFactory);
+RegisterFactory(HllRunningCountVarcharFactory);
+RegisterFactory(HllRunningCountVarbinaryFactory);
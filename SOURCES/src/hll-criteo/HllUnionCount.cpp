@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "Vertica.h"
+#include "hll-criteo/hll.hpp"
+#include "hll-criteo/hll_vertica.hpp"
+
+/**
+ * Estimate of the union of two synopses, as a scalar function: both are folded
+ * with Hll::foldMany() into registers of the lower of their precisions, in a
+ * single pass over them, and estimated from there. It takes the place of a
+ * HllCombine over two rows for each pair of steps of a funnel.
+ */
+class HllUnionCount : public ScalarFunction
+{
+
+  vint hllLeadingBits;
+  // registers of the union, of the largest precision
+  uint8_t* scratch;
+  // registers of the synopsis of the higher precision, see Hll::setFoldScratch()
+  uint8_t* foldScratch;
+
+public:
+
+  virtual void setup(ServerInterface& srvInterface, const SizedColumnTypes& argTypes) {
+    this -> hllLeadingBits = readSubStreamBits(srvInterface);
+    this -> scratch = vt_allocArray(srvInterface.allocator, uint8_t,
+      HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
+    this -> foldScratch = vt_allocArray(srvInterface.allocator, uint8_t,
+      HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
+  }
+
+  virtual void processBlock(ServerInterface &srvInterface,
+                            BlockReader &argReader,
+                            BlockWriter &resWriter)
+  {
+    try {
+      do {
+        const VString& first = argReader.getStringRef(0);
+        const VString& second = argReader.getStringRef(1);
+        if (first.isNull() || second.isNull()) {
+          resWriter.setNull();
+        } else {
+          const uint8_t* byteArrays[2] = {
+            reinterpret_cast<const uint8_t *>(first.data()),
+            reinterpret_cast<const uint8_t *>(second.data())
+          };
+          const size_t lengths[2] = {first.length(), second.length()};
+          const uint8_t precision = std::min(
+            HllView<uint64_t>::precisionOf(byteArrays[0], lengths[0], hllLeadingBits),
+            HllView<uint64_t>::precisionOf(byteArrays[1], lengths[1], hllLeadingBits));
+          HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(
+            selectKernels(precision),
+            scratch,
+            HllView<uint64_t>::getMaxDeserializedBufferSize(precision)
+          );
+          hll.reset();
+          hll.setFoldScratch(foldScratch, HllView<uint64_t>::getMaxDeserializedBufferSize(HLL_ARRAY_SIZE_MAX_VALUE));
+          hll.foldMany(byteArrays, lengths, 2);
+          resWriter.setInt(hll.approximateCountDistinct());
+        }
+        resWriter.next();
+      } while (argReader.next());
+    } catch(SerializationError& e) {
+      vt_report_error(0, e.what());
+    }
+  }
+};
+
+
+class HllUnionCountFactory : public ScalarFunctionFactory
+{
+public:
+  HllUnionCountFactory() {
+    vol = IMMUTABLE;
+    strict = STRICT;
+  }
+
+  virtual void getPrototype(ServerInterface &srvInterface,
+                            ColumnTypes &argTypes,
+                            ColumnTypes &returnType)
+  {
+    argTypes.addVarbinary();
+    argTypes.addVarbinary();
+    returnType.addInt();
+  }
+
+  virtual void getReturnType(ServerInterface &srvInterface,
+                             const SizedColumnTypes &argTypes,
+                             SizedColumnTypes &returnType)
+  {
+    returnType.addInt();
+  }
+
+  virtual ScalarFunction *createScalarFunction(ServerInterface &srvInterface)
+  {
+    return vt_createFuncObject<HllUnionCount>(srvInterface.allocator);
+  }
+
+  virtual void getParameterType(ServerInterface &srvInterface,
+                                SizedColumnTypes &parameterTypes)
+  {
+    SizedColumnTypes::Properties props;
+    props.required = false;
+    props.canBeNull = false;
+    props.comment = "Precision bits of the synopses that don't record it";
+    parameterTypes.addInt(HLL_ARRAY_SIZE_PARAMETER_NAME, props);
+  }
+
+};
+
+RegisterFactory(HllUnionCountFactory);
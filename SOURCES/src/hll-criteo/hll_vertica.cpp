@@ -1,6 +1,9 @@
+#include <sstream>
+
 #include "Vertica.h"
 #include "hll-criteo/hll_raw.hpp"
 #include "hll-criteo/hll_vertica.hpp"
+#include "hll-criteo/hll_window.hpp"
 
 Format formatCodeToEnum(uint8_t f) {
   Format ret = Format::NORMAL;
@@ -12,6 +15,10 @@ Format formatCodeToEnum(uint8_t f) {
     ret = Format::COMPACT_6BITS;
   else if(f == 8)
     ret = Format::NORMAL;
+  else if(f == HLL_BITS_PER_BUCKET_AUTO_VALUE)
+    ret = Format::AUTO;
+  else if(f == HLL_BITS_PER_BUCKET_ENTROPY_VALUE)
+    ret = Format::ENTROPY;
   else
     vt_report_error(0, "Number of bits per bucket is not recognized: %d", f);
   return ret;
@@ -35,15 +42,32 @@ int readSubStreamBits(ServerInterface &srvInterface) {
   return hllLeadingBits;
 }
 
+// Looks up the instruction set of the node when Vertica loads the library,
+// so that every HllKernels lookup afterwards uses the same one
+static const CpuIsa LIBRARY_CPU_ISA = hostCpuIsa();
+
+/**
+ * Picks the register loops specialized for the given precision. UDAFs call
+ * this once in setup() and then use the same kernels for every block.
+ */
+const HllKernels<uint64_t>& selectKernels(int hllLeadingBits) {
+  if (hllLeadingBits < 4 || hllLeadingBits > 18) {
+    vt_report_error(2, "Provided value of the %s parameter is not supported. HyperLogLog precision has to be between 4 and 18",
+      HLL_ARRAY_SIZE_PARAMETER_NAME);
+  }
+  return HllKernels<uint64_t>::forPrecision(hllLeadingBits, LIBRARY_CPU_ISA);
+}
+
 Format readSerializationFormat(ServerInterface &srvInterface) {
   Format format;
   ParamReader paramReader = srvInterface.getParamReader();
 
   if(paramReader.containsParameter(HLL_BITS_PER_BUCKET_PARAMETER_NAME)) {
     int formatInt = paramReader.getIntRef(HLL_BITS_PER_BUCKET_PARAMETER_NAME);
-    if(formatInt != 4 && formatInt != 5 && formatInt != 6 && formatInt != 8) {
-      vt_report_error(2, "Provided value of the %s parameter is not supported. The value should be equal to 4,5,6 or 8",
-        HLL_BITS_PER_BUCKET_PARAMETER_NAME);
+    if(formatInt != 4 && formatInt != 5 && formatInt != 6 && formatInt != 8 && formatInt != HLL_BITS_PER_BUCKET_AUTO_VALUE
+        && formatInt != HLL_BITS_PER_BUCKET_ENTROPY_VALUE) {
+      vt_report_error(2, "Provided value of the %s parameter is not supported. The value should be equal to 4,5,6,8, %d for the smallest lossless one or %d for the entropy coded one",
+        HLL_BITS_PER_BUCKET_PARAMETER_NAME, HLL_BITS_PER_BUCKET_AUTO_VALUE, HLL_BITS_PER_BUCKET_ENTROPY_VALUE);
     }
     format = formatCodeToEnum(formatInt);
   } else {
@@ -53,3 +77,81 @@ Format readSerializationFormat(ServerInterface &srvInterface) {
   }
   return format;
 }
+
+bool readChecksum(ServerInterface &srvInterface) {
+  ParamReader paramReader = srvInterface.getParamReader();
+  if (paramReader.containsParameter(HLL_CHECKSUM_PARAMETER_NAME)) {
+    return paramReader.getBoolRef(HLL_CHECKSUM_PARAMETER_NAME) == vbool_true;
+  }
+  return HLL_CHECKSUM_DEFAULT_VALUE;
+}
+
+const HashFunction& readHashFunction(ServerInterface &srvInterface) {
+  ParamReader paramReader = srvInterface.getParamReader();
+  if (!paramReader.containsParameter(HLL_HASH_FUNCTION_PARAMETER_NAME)) {
+    return *HashFunction::forName(HLL_HASH_FUNCTION_DEFAULT_VALUE);
+  }
+  const std::string name = paramReader.getStringRef(HLL_HASH_FUNCTION_PARAMETER_NAME).str();
+  const HashFunction* hashFunction = HashFunction::forName(name);
+  if (hashFunction == nullptr) {
+    vt_report_error(2, "Provided value of the %s parameter is not supported. The value should be murmur, xxh3 or mix64",
+      HLL_HASH_FUNCTION_PARAMETER_NAME);
+  }
+  return *hashFunction;
+}
+
+uint32_t readWindowRows(ServerInterface &srvInterface, uint8_t precision) {
+  ParamReader paramReader = srvInterface.getParamReader();
+  if (!paramReader.containsParameter(HLL_WINDOW_ROWS_PARAMETER_NAME)) {
+    return HLL_WINDOW_ROWS_DEFAULT_VALUE;
+  }
+  const vint windowRows = paramReader.getIntRef(HLL_WINDOW_ROWS_PARAMETER_NAME);
+  const vint maxRows = std::min<vint>(HLL_WINDOW_ROWS_MAX_VALUE,
+    HllWindow<uint64_t>::getMaxRows(precision, HLL_WINDOW_BUFFER_MAX_BYTES));
+  if (windowRows < 0 || windowRows > maxRows) {
+    vt_report_error(2, "Provided value of the %s parameter is not supported. The value should be between 0 and %d, inclusive, for %s=%d",
+      HLL_WINDOW_ROWS_PARAMETER_NAME, (int)maxRows, HLL_ARRAY_SIZE_PARAMETER_NAME, precision);
+  }
+  return windowRows;
+}
+
+vint readEmitEvery(ServerInterface &srvInterface) {
+  ParamReader paramReader = srvInterface.getParamReader();
+  if (!paramReader.containsParameter(HLL_EMIT_EVERY_PARAMETER_NAME)) {
+    return HLL_EMIT_EVERY_DEFAULT_VALUE;
+  }
+  const vint emitEvery = paramReader.getIntRef(HLL_EMIT_EVERY_PARAMETER_NAME);
+  if (emitEvery < 1) {
+    vt_report_error(2, "Provided value of the %s parameter is not supported. The value should be at least 1",
+      HLL_EMIT_EVERY_PARAMETER_NAME);
+  }
+  return emitEvery;
+}
+
+const char* formatName(Format format) {
+  switch(format) {
+    case Format::NORMAL: return "8 bits";
+    case Format::COMPACT_6BITS: return "6 bits";
+    case Format::COMPACT_5BITS: return "5 bits";
+    case Format::COMPACT_4BITS: return "4 bits";
+    case Format::SPARSE: return "sparse";
+    case Format::SPARSE_VARINT: return "sparse varint";
+    case Format::COMPACT_5BITS_EXCEPTIONS: return "5 bits with exceptions";
+    case Format::COMPACT_4BITS_EXCEPTIONS: return "4 bits with exceptions";
+    case Format::ENTROPY: return "entropy coded";
+    case Format::AUTO: return "auto";
+  }
+  return "unknown";
+}
+
+void FormatCounter::log(ServerInterface &srvInterface, const char* functionName) const {
+  std::ostringstream counts;
+  for (size_t i = 0; i < NUMBER_OF_FORMATS; ++i) {
+    if (this->counts[i] != 0) {
+      counts << " " << formatName(static_cast<Format>(i)) << ": " << this->counts[i];
+    }
+  }
+  if (!counts.str().empty()) {
+    srvInterface.log("%s synopses per format:%s", functionName, counts.str().c_str());
+  }
+}
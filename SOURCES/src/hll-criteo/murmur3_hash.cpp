@@ -7,7 +7,7 @@
 // compile and run any of them on any platform, but your performance with the
 // non-native version will be less than optimal.
 
-#include "murmur3_hash.hpp"
+#include "hll-criteo/murmur3_hash.hpp"
 
 //-----------------------------------------------------------------------------
 // Platform-specific functions and macros
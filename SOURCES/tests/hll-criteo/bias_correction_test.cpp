@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
@@ -166,3 +168,33 @@ TEST_F(BiasCorrectionTest, TestFixedPrecisionEstimate) {
   }
 
 }
+
+/**
+ * The bias is the mean of the biases of the 6 raw estimates closest to the
+ * given one; check the window scan against sorting all of them by distance.
+ */
+TEST_F(BiasCorrectionTest, TestBiasIsMeanOfNearestNeighbors) {
+  for(uint8_t precision = BiasCorrectedEstimate::MIN_PRECISION;
+              precision <= BiasCorrectedEstimate::MAX_PRECISION;
+              ++precision) {
+    const BiasCorrectedEstimate::Table& table = BiasCorrectedEstimate::table(precision);
+    uint64_t threshold = 5 * (1 << precision);
+    uint64_t step = std::max<uint64_t>(1, threshold / 5000);
+    for(uint64_t rawEstimate = 0; rawEstimate < threshold; rawEstimate += step) {
+      std::vector<std::pair<double, uint32_t>> neighbors;
+      for(uint32_t idx = 0; idx < table.size; ++idx) {
+        neighbors.push_back(std::make_pair(std::fabs(table.rawEstimates[idx] - rawEstimate), idx));
+      }
+      std::sort(neighbors.begin(), neighbors.end());
+      double expected = .0;
+      for(uint32_t idx = 0; idx < BiasCorrectedEstimate::NEIGHBORS; ++idx) {
+        expected += table.biases[neighbors[idx].second];
+      }
+      expected /= BiasCorrectedEstimate::NEIGHBORS;
+
+      ASSERT_NEAR(expected, BiasCorrectedEstimate::kNeighborsInterpolationBias(rawEstimate, precision),
+                  1e-9 * std::max(1., std::fabs(expected)))
+        << "precision " << (int)precision << ", raw estimate " << rawEstimate;
+    }
+  }
+}
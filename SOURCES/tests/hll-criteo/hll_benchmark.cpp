@@ -1,6 +1,10 @@
+#include <chrono>
 #include <iostream>
+#include <limits>
 #include <fstream>
+#include <vector>
 #include "hll-criteo/hll.hpp"
+#include "hll-criteo/string_key.hpp"
 #include "optionparser.h"
 
 using namespace option;
@@ -12,7 +16,7 @@ using namespace std;
 
 
 enum  optionIndex {
-  UNKNOWN, HELP, MAX_CARDINALITY, MIN_CARDINALITY, REPEAT_COUNT, OUT_FILE
+  UNKNOWN, HELP, MAX_CARDINALITY, MIN_CARDINALITY, REPEAT_COUNT, OUT_FILE, MODE, ITERATIONS
 };
 const option::Descriptor usage[] =
 {
@@ -27,6 +31,10 @@ const option::Descriptor usage[] =
     "  \tOutput file to save results" },
   { REPEAT_COUNT, 0, "-r", "repeat", Arg::Optional, "  -r[<arg>], \t--repeat[=<arg>]"
     "  \tRepeat test N times, changing hash distribution each time. Default is 10" },
+  { MODE, 0, "-m", "mode", Arg::Optional, "  -m[<arg>], \t--mode[=<arg>]"
+    "  \tBenchmark to run: accuracy (default), construct, wrap, kernels, batch, strings, hashes, formats, estimate, running, unpack or foldmany." },
+  { ITERATIONS, 0, "-n", "iterations", Arg::Optional, "  -n[<arg>], \t--iterations[=<arg>]"
+    "  \tNumber of iterations of the micro benchmarks, default is 10000000." },
   { 0, 0, 0, 0, 0, 0 }
 };
 
@@ -41,11 +49,491 @@ int64_t getOutputStep(int64_t realCardinality) {
   return std::pow(10, nDigitsMinusOne - 2);
 }
 
+/**
+ * Micro benchmark of the cost of wrapping a synopsis buffer with HllRaw.
+ * This happens for every block handed over to the UDAFs, so it should
+ * be negligible compared to the hashing done in add().
+ */
+void runConstructBenchmark(uint8_t precision, size_t iterations) {
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  uint64_t checksum = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    HllRaw<uint64_t> hll(precision, buffer.first.get() + sizeof(HLLHdr));
+    checksum ^= hll.add(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  cout << "construct+add: " << iterations << " iterations, "
+       << ns / iterations << " ns/iteration (checksum " << checksum << ")" << endl;
+}
+
+/**
+ * Micro benchmark of what the UDAFs do for every block: wrap the intermediate
+ * aggregate buffer, add a value and let the view go out of scope.
+ */
+void runWrapBenchmark(uint8_t precision, size_t iterations) {
+  SizedBuffer buffer = HllView<uint64_t>::makeDeserializedBuffer(precision);
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(precision, buffer.first.get(), buffer.second);
+    hll.add(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  HllView<uint64_t> hll = HllView<uint64_t>::wrapRawBuffer(precision, buffer.first.get(), buffer.second);
+  cout << "wrap+add+unwrap: " << iterations << " iterations, "
+       << ns / iterations << " ns/iteration (estimate " << hll.approximateCountDistinct() << ")" << endl;
+}
+
+/**
+ * Compares folding a 6-bit synopsis and estimating with the precision read at
+ * runtime against the kernels specialized for that precision, for each
+ * instruction set the host supports.
+ */
+void runKernelsBenchmark(size_t iterations) {
+  const char* isaNames[] = {"default", "sse4.2", "avx2", "avx512"};
+  for (uint8_t precision : {12, 14}) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+    HllRaw<uint64_t> hll(precision, buffer.first.get() + sizeof(HLLHdr));
+    for (uint64_t i = 0; i < 100000; ++i) {
+      hll.add(i);
+    }
+    SizedBuffer serialized = Hll<uint64_t>::makeSerializedBuffer(Format::COMPACT_6BITS, precision);
+    hll.serialize6Bits(serialized.first.get());
+
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      hll.fold6Bits(serialized.first.get(), serialized.second);
+      checksum += hll.estimate();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double runtimeNs = std::chrono::duration<double, std::nano>(end - start).count();
+    cout << "p=" << (int)precision << " fold6Bits+estimate: runtime precision "
+         << runtimeNs / iterations << " ns";
+
+    for (int isa = (int)CpuIsa::DEFAULT; isa <= (int)hostCpuIsa(); ++isa) {
+      const HllKernels<uint64_t>& kernels = HllKernels<uint64_t>::forPrecision(precision, (CpuIsa)isa);
+      start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < iterations; ++i) {
+        kernels.fold6Bits(hll.getCurrentSynopsis(), serialized.first.get(), serialized.second);
+        checksum += kernels.estimate(hll.getCurrentSynopsis());
+      }
+      end = std::chrono::steady_clock::now();
+      double specializedNs = std::chrono::duration<double, std::nano>(end - start).count();
+      cout << ", specialized " << isaNames[isa] << " " << specializedNs / iterations << " ns";
+    }
+    cout << " (checksum " << checksum << ")" << endl;
+  }
+}
+
+/**
+ * Throughput of folding the 6, 5 and 4-bit formats, in GB/s of payload, with
+ * the kernels of each instruction set the host supports.
+ */
+void runUnpackBenchmark(uint8_t precision, size_t iterations) {
+  const char* isaNames[] = {"default", "sse4.2", "avx2", "avx512"};
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  HllRaw<uint64_t> hll(precision, buffer.first.get() + sizeof(HLLHdr));
+  for (uint64_t i = 0; i < 100000; ++i) {
+    hll.add(i);
+  }
+  const uint8_t base = hll.histogram().minValue();
+  const uint32_t numberOfBuckets = hll.getNumberOfBuckets();
+  vector<uint8_t> payload6(numberOfBuckets / 4 * 3), payload5(numberOfBuckets / 8 * 5), payload4(numberOfBuckets / 2);
+  hll.serialize6Bits(payload6.data());
+  hll.serialize5BitsWithBase(payload5.data(), base);
+  hll.serialize4BitsWithBase(payload4.data(), base);
+  vector<uint8_t> synopsis(numberOfBuckets, 0);
+
+  for (int isa = (int)CpuIsa::DEFAULT; isa <= (int)hostCpuIsa(); ++isa) {
+    const HllKernels<uint64_t>& kernels = HllKernels<uint64_t>::forPrecision(precision, (CpuIsa)isa);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      kernels.fold6Bits(synopsis.data(), payload6.data(), payload6.size());
+    }
+    auto end6 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      kernels.fold5BitsWithBase(synopsis.data(), payload5.data(), base, payload5.size());
+    }
+    auto end5 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      kernels.fold4BitsWithBase(synopsis.data(), payload4.data(), base, payload4.size());
+    }
+    auto end4 = std::chrono::steady_clock::now();
+    cout << isaNames[isa]
+         << ": 6 bits " << iterations * payload6.size() / std::chrono::duration<double, std::nano>(end6 - start).count() << " GB/s"
+         << ", 5 bits " << iterations * payload5.size() / std::chrono::duration<double, std::nano>(end5 - end6).count() << " GB/s"
+         << ", 4 bits " << iterations * payload4.size() / std::chrono::duration<double, std::nano>(end4 - end5).count() << " GB/s"
+         << " (checksum " << (int)synopsis[numberOfBuckets - 1] << ")" << endl;
+  }
+}
+
+/**
+ * What combine() does with many intermediates, synopses with 8-bit registers:
+ * fold() of each in turn versus foldMany() of all of them. Each is timed
+ * several times and the fastest run is kept.
+ */
+void runFoldManyBenchmark(uint8_t precision, size_t synopses, size_t iterations) {
+  const size_t RUNS = 5;
+  vector<vector<uint8_t>> payloads;
+  vector<const uint8_t*> byteArrays;
+  vector<size_t> lengths;
+  for (size_t k = 0; k < synopses; ++k) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+    Hll<uint64_t> hll(precision, buffer.first.get());
+    hll.reset();
+    for (uint64_t i = 0; i < 100000; ++i) {
+      hll.add(k * 100000 + i);
+    }
+    payloads.emplace_back(buffer.first.get(), buffer.first.get() + buffer.second);
+    byteArrays.push_back(payloads.back().data());
+    lengths.push_back(payloads.back().size());
+  }
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  Hll<uint64_t> hll(precision, buffer.first.get());
+
+  double foldUs = std::numeric_limits<double>::max(), foldManyUs = std::numeric_limits<double>::max();
+  for (size_t run = 0; run < RUNS; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      hll.reset();
+      for (size_t k = 0; k < synopses; ++k) {
+        hll.fold(byteArrays[k], lengths[k]);
+      }
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      hll.reset();
+      hll.foldMany(byteArrays.data(), lengths.data(), synopses);
+    }
+    auto end = std::chrono::steady_clock::now();
+    foldUs = std::min(foldUs, std::chrono::duration<double, std::micro>(middle - start).count() / iterations);
+    foldManyUs = std::min(foldManyUs, std::chrono::duration<double, std::micro>(end - middle).count() / iterations);
+  }
+  cout << "p=" << (int)precision << ", " << synopses << " synopses: fold " << foldUs << " us, foldMany "
+       << foldManyUs << " us (estimate " << hll.approximateCountDistinct() << ")" << endl;
+}
+
+/**
+ * Stands in for Vertica's BlockReader: a row cursor over a column of ints,
+ * read with getIntRef() and advanced with next().
+ */
+class BlockReaderStub {
+public:
+  BlockReaderStub(const vector<uint64_t>& block) : block(block), row(0) {}
+
+  const uint64_t& getIntRef(size_t) { return block[row]; }
+  bool next() { return ++row < block.size(); }
+  void rewind() { row = 0; }
+
+private:
+  const vector<uint64_t>& block;
+  size_t row;
+};
+
+/**
+ * Throughput of HllCreateSynopsis' aggregation loop: values added one at a
+ * time versus copied to a stack buffer and added in batches.
+ */
+void runBatchBenchmark(uint8_t precision, size_t rows) {
+  const size_t BLOCK_SIZE = 1 << 16;
+  const size_t BATCH_SIZE = 1024;
+  vector<uint64_t> block(BLOCK_SIZE);
+  for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+    block[i] = i * 0x9E3779B97F4A7C15ULL;
+  }
+  BlockReaderStub argReader(block);
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  SizedBuffer bufferBatch = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  Hll<uint64_t> hll(precision, buffer.first.get());
+  Hll<uint64_t> hllBatch(precision, bufferBatch.first.get());
+  const size_t blocks = std::max<size_t>(rows / BLOCK_SIZE, 1);
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t b = 0; b < blocks; ++b) {
+    argReader.rewind();
+    do {
+      hll.add(argReader.getIntRef(0));
+    } while (argReader.next());
+  }
+  auto middle = std::chrono::steady_clock::now();
+  uint64_t values[BATCH_SIZE];
+  for (size_t b = 0; b < blocks; ++b) {
+    argReader.rewind();
+    size_t count = 0;
+    do {
+      values[count++] = argReader.getIntRef(0);
+      if (count == BATCH_SIZE) {
+        hllBatch.addBatch(values, count);
+        count = 0;
+      }
+    } while (argReader.next());
+    hllBatch.addBatch(values, count);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  const double totalRows = blocks * BLOCK_SIZE;
+  double addSeconds = std::chrono::duration<double>(middle - start).count();
+  double batchSeconds = std::chrono::duration<double>(end - middle).count();
+  cout << "add:      " << totalRows / addSeconds / 1e6 << " Mrows/s (estimate " << hll.approximateCountDistinct() << ")" << endl;
+  cout << "addBatch: " << totalRows / batchSeconds / 1e6 << " Mrows/s (estimate " << hllBatch.approximateCountDistinct() << ")" << endl;
+}
+
+/**
+ * Rows per second HllCreateSynopsis adds from a block of strings, each one
+ * turned into its StringKey then added HLL_ADD_BATCH_SIZE at a time, for
+ * strings of the length of a user id and of a URL.
+ */
+void runStringsBenchmark(uint8_t precision, size_t rows) {
+  const size_t BLOCK_SIZE = 1 << 16;
+  const size_t BATCH_SIZE = 1024;
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  Hll<uint64_t> hll(precision, buffer.first.get());
+  const size_t blocks = std::max<size_t>(rows / BLOCK_SIZE, 1);
+  for (const string prefix: {"", "https://www.example.com/catalog/product?id="}) {
+    vector<string> block(BLOCK_SIZE);
+    size_t bytes = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+      block[i] = prefix + to_string(i * 0x9E3779B97F4A7C15ULL);
+      bytes += block[i].size();
+    }
+    hll.reset();
+    uint64_t values[BATCH_SIZE];
+    auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < blocks; ++b) {
+      size_t count = 0;
+      for (const string& value: block) {
+        values[count++] = StringKey::of(value.data(), value.size());
+        if (count == BATCH_SIZE) {
+          hll.addBatch(values, count);
+          count = 0;
+        }
+      }
+      hll.addBatch(values, count);
+    }
+    auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    cout << bytes / BLOCK_SIZE << "-byte strings: " << blocks * BLOCK_SIZE / seconds / 1e6
+         << " Mrows/s (estimate " << hll.approximateCountDistinct() << ")" << endl;
+  }
+}
+
+/**
+ * Throughput of each HashFunction in HllCreateSynopsis' aggregation loop:
+ * hashing alone and hashing plus adding the hashes, on consecutive BIGINTs,
+ * and adding strings of the length of a user id and of a URL through the
+ * key of the hash function.
+ */
+void runHashesBenchmark(uint8_t precision, size_t rows) {
+  const size_t BLOCK_SIZE = 1 << 16;
+  const size_t BATCH_SIZE = 1024;
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  Hll<uint64_t> hll(precision, buffer.first.get());
+  const size_t blocks = std::max<size_t>(rows / BLOCK_SIZE, 1);
+  vector<uint64_t> ids(BLOCK_SIZE);
+  for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+    ids[i] = i;
+  }
+  vector<vector<string>> stringBlocks;
+  for (const string prefix: {"", "https://www.example.com/catalog/product?id="}) {
+    vector<string> block(BLOCK_SIZE);
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+      block[i] = prefix + to_string(i * 0x9E3779B97F4A7C15ULL);
+    }
+    stringBlocks.push_back(block);
+  }
+  uint64_t values[BATCH_SIZE];
+  uint64_t hashes[BATCH_SIZE];
+
+  for (size_t f = 0; f < HashFunction::COUNT; ++f) {
+    const HashFunction& function = HashFunction::all()[f];
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < blocks; ++b) {
+      for (size_t offset = 0; offset < BLOCK_SIZE; offset += BATCH_SIZE) {
+        function.hashBatch(ids.data() + offset, BATCH_SIZE, hashes, MURMURHASH_DEFAULT_SEED);
+        checksum += hashes[b % BATCH_SIZE];
+      }
+    }
+    auto middle = std::chrono::steady_clock::now();
+    hll.reset();
+    for (size_t b = 0; b < blocks; ++b) {
+      for (size_t offset = 0; offset < BLOCK_SIZE; offset += BATCH_SIZE) {
+        function.hashBatch(ids.data() + offset, BATCH_SIZE, hashes, MURMURHASH_DEFAULT_SEED);
+        hll.addHashes(hashes, BATCH_SIZE, function.id);
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    const double totalRows = blocks * BLOCK_SIZE;
+    cout << function.name << " BIGINT hash: " << totalRows / std::chrono::duration<double>(middle - start).count() / 1e6
+         << " Mrows/s (" << (checksum & 0xff) << "), hash and add: "
+         << totalRows / std::chrono::duration<double>(end - middle).count() / 1e6
+         << " Mrows/s (estimate " << hll.approximateCountDistinct() << ")" << endl;
+
+    for (const vector<string>& block: stringBlocks) {
+      size_t bytes = 0;
+      for (const string& value: block) {
+        bytes += value.size();
+      }
+      hll.reset();
+      start = std::chrono::steady_clock::now();
+      for (size_t b = 0; b < blocks; ++b) {
+        size_t count = 0;
+        for (const string& value: block) {
+          values[count++] = function.key(value.data(), value.size());
+          if (count == BATCH_SIZE) {
+            function.hashBatch(values, count, hashes, MURMURHASH_DEFAULT_SEED);
+            hll.addHashes(hashes, count, function.id);
+            count = 0;
+          }
+        }
+        function.hashBatch(values, count, hashes, MURMURHASH_DEFAULT_SEED);
+        hll.addHashes(hashes, count, function.id);
+      }
+      end = std::chrono::steady_clock::now();
+      cout << function.name << " " << bytes / BLOCK_SIZE << "-byte strings: "
+           << totalRows / std::chrono::duration<double>(end - start).count() / 1e6
+           << " Mrows/s (estimate " << hll.approximateCountDistinct() << ")" << endl;
+    }
+  }
+}
+
+/**
+ * Bytes per synopsis and fold throughput of each lossless serialization
+ * format, at cardinalities from 1e3 to 1e7.
+ */
+void runFormatsBenchmark(uint8_t precision, size_t iterations) {
+  const Format formats[] = {Format::COMPACT_6BITS, Format::COMPACT_5BITS, Format::COMPACT_5BITS_EXCEPTIONS,
+    Format::COMPACT_4BITS, Format::COMPACT_4BITS_EXCEPTIONS, Format::SPARSE_VARINT, Format::ENTROPY};
+  const char* formatNames[] = {"6 bits", "5 bits", "5 bits+exceptions", "4 bits", "4 bits+exceptions",
+    "sparse varint", "entropy"};
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  SizedBuffer bufferFolded = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  Hll<uint64_t> hll(precision, buffer.first.get());
+  Hll<uint64_t> folded(precision, bufferFolded.first.get());
+  hll.reset();
+  uint64_t itemsAdded = 0;
+  for (uint64_t cardinality = 1000; cardinality <= 10000000; cardinality *= 10) {
+    for (; itemsAdded < cardinality; ++itemsAdded) {
+      hll.add(itemsAdded);
+    }
+    const RegisterHistogram histogram = hll.histogram();
+    cout << "cardinality " << cardinality << endl;
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+      const Format format = formats[f];
+      if (format == Format::COMPACT_5BITS && histogram.maxValue() - histogram.minValue() >= 32) {
+        continue;
+      }
+      if (format == Format::COMPACT_4BITS && histogram.maxValue() - histogram.minValue() >= 16) {
+        continue;
+      }
+      vector<uint8_t> serialized(hll.getSerializedBufferSize(format, histogram));
+      hll.serialize(serialized.data(), format, histogram);
+
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < iterations; ++i) {
+        folded.reset();
+        folded.fold(serialized.data(), serialized.size());
+      }
+      auto end = std::chrono::steady_clock::now();
+      double ns = std::chrono::duration<double, std::nano>(end - start).count();
+      cout << "  " << formatNames[f] << ": " << serialized.size() << " bytes, "
+           << ns / iterations << " ns/fold (estimate " << folded.approximateCountDistinct() << ")" << endl;
+    }
+  }
+}
+
+/**
+ * HllEstimate of a single synopsis in each format, at cardinality 1e5:
+ * folded into registers then estimated, as HllDistinctCount does it, versus
+ * counted from the payload with histogramOf().
+ */
+void runEstimateBenchmark(uint8_t precision, size_t iterations) {
+  const Format formats[] = {Format::NORMAL, Format::COMPACT_6BITS, Format::COMPACT_5BITS,
+    Format::COMPACT_4BITS_EXCEPTIONS, Format::ENTROPY};
+  const char* formatNames[] = {"8 bits", "6 bits", "5 bits", "4 bits+exceptions", "entropy"};
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  SizedBuffer scratch = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  Hll<uint64_t> hll(precision, buffer.first.get());
+  Hll<uint64_t> reader(precision, scratch.first.get());
+  hll.reset();
+  for (uint64_t i = 0; i < 100000; ++i) {
+    hll.add(i);
+  }
+  const RegisterHistogram histogram = hll.histogram();
+  for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+    vector<uint8_t> serialized(hll.getSerializedBufferSize(formats[f], histogram));
+    hll.serialize(serialized.data(), formats[f], histogram);
+
+    uint64_t folded = 0, counted = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      reader.reset();
+      reader.fold(serialized.data(), serialized.size());
+      folded += reader.approximateCountDistinct();
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      counted += reader.approximateCountDistinct(reader.histogramOf(serialized.data(), serialized.size()));
+    }
+    auto end = std::chrono::steady_clock::now();
+    cout << formatNames[f] << ": fold+estimate "
+         << std::chrono::duration<double, std::nano>(middle - start).count() / iterations << " ns, histogramOf+estimate "
+         << std::chrono::duration<double, std::nano>(end - middle).count() / iterations << " ns (estimates "
+         << folded / iterations << ", " << counted / iterations << ")" << endl;
+  }
+}
+
+/**
+ * Running count of n values with an estimate after every row, as
+ * HllRunningCount emits it: addHashes() keeping the RegisterHistogram up to
+ * date, against histogram() of the registers for every estimate.
+ */
+void runRunningBenchmark(uint8_t precision, size_t n) {
+  const HashFunction& murmur = *HashFunction::forName("murmur");
+  vector<uint64_t> hashes(n);
+  for (uint64_t i = 0; i < n; ++i) {
+    murmur.hashBatch(&i, 1, &hashes[i], MURMURHASH_DEFAULT_SEED);
+  }
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+  Hll<uint64_t> hll(precision, buffer.first.get());
+
+  uint64_t scanned = 0, incremental = 0;
+  hll.reset();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    hll.addHashes(&hashes[i], 1, murmur.id);
+    scanned += hll.approximateCountDistinct(hll.histogram());
+  }
+  auto middle = std::chrono::steady_clock::now();
+  vector<uint8_t> trackedBuffer(Hll<uint64_t>::getMaxDeserializedBufferSize(precision, true));
+  Hll<uint64_t> tracked(precision, trackedBuffer.data());
+  tracked.reset();
+  tracked.trackHistogram();
+  for (size_t i = 0; i < n; ++i) {
+    tracked.addHashes(&hashes[i], 1, murmur.id);
+    incremental += tracked.approximateCountDistinct();
+  }
+  auto end = std::chrono::steady_clock::now();
+  cout << "estimate per row: histogram() "
+       << std::chrono::duration<double, std::nano>(middle - start).count() / n << " ns, kept up to date "
+       << std::chrono::duration<double, std::nano>(end - middle).count() / n << " ns (sums of estimates "
+       << scanned << ", " << incremental << ")" << endl;
+}
+
 int main(int argc, char **argv) {
 
   size_t minCardinality = 1;
   size_t maxCardinality = 1000;
   size_t repeatCount = 10;
+  size_t iterations = 10000000;
+  string mode = "accuracy";
   string outputFile = "./hll_benchmark_result.csv";
 
   // Command line parsing code
@@ -80,6 +568,16 @@ int main(int argc, char **argv) {
   }
 
 
+  if (options[MODE].arg) {
+    mode = options[MODE].arg;
+    cout << "MODE <<" << mode << endl;
+  }
+
+  if (options[ITERATIONS].arg) {
+    iterations = stoull(options[ITERATIONS].arg);
+    cout << "ITERATIONS <<" << iterations << endl;
+  }
+
   for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next())
   cout << "Unknown option: " << opt->name << "\n";
   for (int i = 0; i < parse.nonOptionsCount(); ++i) cout << "Non-option #" << i << ": " << parse.nonOption(i) << "\n";
@@ -88,6 +586,46 @@ int main(int argc, char **argv) {
     cerr << "Max cardinality has to be bigger than min cardinality" << endl;
   }
 
+  if (mode == "construct") {
+    runConstructBenchmark(14, iterations);
+    return 0;
+  } else if (mode == "wrap") {
+    runWrapBenchmark(14, iterations);
+    return 0;
+  } else if (mode == "batch") {
+    runBatchBenchmark(14, iterations);
+    return 0;
+  } else if (mode == "strings") {
+    runStringsBenchmark(14, iterations);
+    return 0;
+  } else if (mode == "hashes") {
+    runHashesBenchmark(14, iterations);
+    return 0;
+  } else if (mode == "kernels") {
+    runKernelsBenchmark(iterations / 1000);
+    return 0;
+  } else if (mode == "foldmany") {
+    for (uint8_t precision : {14, 16, 18}) {
+      runFoldManyBenchmark(precision, 256, iterations / 1000000);
+    }
+    return 0;
+  } else if (mode == "unpack") {
+    runUnpackBenchmark(14, iterations / 1000);
+    return 0;
+  } else if (mode == "formats") {
+    runFormatsBenchmark(14, iterations / 10000);
+    return 0;
+  } else if (mode == "estimate") {
+    runEstimateBenchmark(14, iterations / 1000);
+    return 0;
+  } else if (mode == "running") {
+    runRunningBenchmark(14, iterations / 100);
+    return 0;
+  } else if (mode != "accuracy") {
+    cerr << "Unknown benchmark mode: " << mode << endl;
+    return 1;
+  }
+
   std::ofstream output(outputFile);
   uint32_t input_value = 111;
   for (uint8_t precision = 14; precision <= 14; ++precision) {
@@ -1,6 +1,9 @@
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
 #include <string>
 #include <vector>
 #include <stdint.h>
@@ -419,6 +422,328 @@ TEST_F(HllRawTest, TestSmallInput) {
   EXPECT_GT(hll.estimate(), 0.99*realCardinality);
 }
 
+
+/**
+ * HllRaw specialized for a precision and the kernels from HllKernels have
+ * to give exactly the same synopsis and estimates as the HllRaw taking the
+ * precision at runtime.
+ */
+TEST_F(HllRawTest, TestFixedPrecisionMatchesRuntimePrecision) {
+  const uint8_t PRECISION = 12;
+  std::set<uint64_t> ids;
+  generateNumbers(ids, 100000);
+
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(PRECISION); // sizeof(HLLHdr) + synopsis
+  SizedBuffer bufferFixed = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  HllRaw<uint64_t> hll(PRECISION, buffer.first.get());
+  HllRaw<uint64_t, MurMurHash<uint64_t>, PRECISION> fixedHll(PRECISION, bufferFixed.first.get());
+
+  for(uint64_t id: ids) {
+    hll.add(id);
+    fixedHll.add(id);
+  }
+  EXPECT_TRUE(0 == std::memcmp(hll.getCurrentSynopsis(), fixedHll.getCurrentSynopsis(), hll.getNumberOfBuckets()));
+  EXPECT_EQ(hll.estimate(), fixedHll.estimate());
+  EXPECT_EQ(hll.betaEstimate(), fixedHll.betaEstimate());
+
+  const HllKernels<uint64_t>& kernels = HllKernels<uint64_t>::forPrecision(PRECISION);
+  EXPECT_EQ(hll.estimate(), kernels.estimate(hll.getCurrentSynopsis()));
+  EXPECT_EQ(hll.emptyBucketsCount(), kernels.emptyBucketsCount(hll.getCurrentSynopsis()));
+
+  SizedBuffer byte_array = Hll<uint64_t>::makeSerializedBuffer(Format::COMPACT_6BITS, PRECISION);
+  kernels.serialize6Bits(hll.getCurrentSynopsis(), byte_array.first.get());
+  SizedBuffer bufferFolded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  kernels.fold6Bits(bufferFolded.first.get(), byte_array.first.get(), byte_array.second);
+  EXPECT_TRUE(0 == std::memcmp(hll.getCurrentSynopsis(), bufferFolded.first.get(), hll.getNumberOfBuckets()));
+
+  EXPECT_THROW((HllRaw<uint64_t, MurMurHash<uint64_t>, PRECISION>(PRECISION + 1, bufferFixed.first.get())), SerializationError);
+  EXPECT_THROW(HllKernels<uint64_t>::forPrecision(3), SerializationError);
+}
+
+
+/**
+ * Kernels compiled for each instruction set the host supports have to give
+ * the same results as the ones compiled for the baseline.
+ */
+TEST_F(HllRawTest, TestIsaKernelsMatchDefault) {
+  const uint8_t PRECISION = 11;
+  std::set<uint64_t> idsSet;
+  generateNumbers(idsSet, 50000);
+  std::vector<uint64_t> ids(idsSet.begin(), idsSet.end());
+  const HllKernels<uint64_t>& reference = HllKernels<uint64_t>::forPrecision(PRECISION, CpuIsa::DEFAULT);
+  SizedBuffer expected = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  reference.addBatch(expected.first.get(), ids.data(), ids.size(), MURMURHASH_DEFAULT_SEED);
+  const uint32_t numberOfBuckets = 1 << PRECISION;
+
+  for (int isa = (int)CpuIsa::DEFAULT; isa <= (int)hostCpuIsa(); ++isa) {
+    const HllKernels<uint64_t>& kernels = HllKernels<uint64_t>::forPrecision(PRECISION, (CpuIsa)isa);
+    SizedBuffer synopsis = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    kernels.addBatch(synopsis.first.get(), ids.data(), ids.size(), MURMURHASH_DEFAULT_SEED);
+    EXPECT_TRUE(0 == std::memcmp(expected.first.get(), synopsis.first.get(), numberOfBuckets));
+    EXPECT_EQ(reference.estimate(expected.first.get()), kernels.estimate(synopsis.first.get()));
+    EXPECT_EQ(reference.betaEstimate(expected.first.get()), kernels.betaEstimate(synopsis.first.get()));
+    EXPECT_EQ(reference.emptyBucketsCount(expected.first.get()), kernels.emptyBucketsCount(synopsis.first.get()));
+    RegisterHistogram histogram = kernels.histogram(synopsis.first.get());
+    EXPECT_TRUE(0 == std::memcmp(reference.histogram(expected.first.get()).counts, histogram.counts, sizeof(histogram.counts)));
+
+    SizedBuffer serialized = Hll<uint64_t>::makeSerializedBuffer(Format::NORMAL, PRECISION);
+    SizedBuffer folded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    kernels.serialize8Bits(synopsis.first.get(), serialized.first.get());
+    kernels.fold8Bits(folded.first.get(), serialized.first.get(), serialized.second);
+    EXPECT_TRUE(0 == std::memcmp(expected.first.get(), folded.first.get(), numberOfBuckets));
+
+    folded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    kernels.serialize6Bits(synopsis.first.get(), serialized.first.get());
+    kernels.fold6Bits(folded.first.get(), serialized.first.get(), serialized.second);
+    EXPECT_TRUE(0 == std::memcmp(expected.first.get(), folded.first.get(), numberOfBuckets));
+
+    // 5 and 4 bits are lossy, so they are compared with the baseline kernels doing the same
+    SizedBuffer foldedReference = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    folded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    uint8_t base = histogram.minValue();
+    kernels.serialize5BitsWithBase(synopsis.first.get(), serialized.first.get(), base);
+    kernels.fold5BitsWithBase(folded.first.get(), serialized.first.get(), base, serialized.second);
+    reference.fold5BitsWithBase(foldedReference.first.get(), serialized.first.get(), base, serialized.second);
+    EXPECT_TRUE(0 == std::memcmp(foldedReference.first.get(), folded.first.get(), numberOfBuckets));
+
+    foldedReference = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    folded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    kernels.serialize4BitsWithBase(synopsis.first.get(), serialized.first.get(), base);
+    kernels.fold4BitsWithBase(folded.first.get(), serialized.first.get(), base, serialized.second);
+    reference.fold4BitsWithBase(foldedReference.first.get(), serialized.first.get(), base, serialized.second);
+    EXPECT_TRUE(0 == std::memcmp(foldedReference.first.get(), folded.first.get(), numberOfBuckets));
+  }
+}
+
+/**
+ * The vector unpacking of the compact formats has to give the same registers
+ * as the scalar loops, bit for bit, for any bytes (the 5 and 4-bit ones hold
+ * no invalid value) and any registers already there. The payloads are as
+ * short as the formats allow, so that the vector loops stop before the end
+ * and leave the last registers to the scalar loop.
+ */
+TEST_F(HllRawTest, TestIsaUnpackMatchesScalar) {
+  std::mt19937 random(42);
+  for (uint8_t precision = 4; precision <= 18; ++precision) {
+    const uint32_t numberOfBuckets = 1 << precision;
+    std::vector<uint8_t> registers(numberOfBuckets);
+    for (uint8_t& r: registers) {
+      r = random() % 64;
+    }
+    std::vector<uint8_t> payload(numberOfBuckets);
+    for (uint8_t& b: payload) {
+      b = random();
+    }
+    const uint8_t base = random() % 32;
+    const size_t length6 = numberOfBuckets / 4 * 3, length5 = numberOfBuckets / 8 * 5, length4 = numberOfBuckets / 2;
+
+    std::vector<uint8_t> expected6(registers), expected5(registers), expected4(registers);
+    HllRaw<uint64_t>(precision, expected6.data()).fold6Bits(payload.data(), length6);
+    HllRaw<uint64_t>(precision, expected5.data()).fold5BitsWithBase(payload.data(), base, length5);
+    HllRaw<uint64_t>(precision, expected4.data()).fold4BitsWithBase(payload.data(), base, length4);
+
+    for (int isa = (int)CpuIsa::DEFAULT; isa <= (int)hostCpuIsa(); ++isa) {
+      const HllKernels<uint64_t>& kernels = HllKernels<uint64_t>::forPrecision(precision, (CpuIsa)isa);
+      std::vector<uint8_t> folded(registers);
+      kernels.fold6Bits(folded.data(), payload.data(), length6);
+      EXPECT_TRUE(expected6 == folded) << "6 bits, precision " << (int)precision << ", isa " << isa;
+      folded = registers;
+      kernels.fold5BitsWithBase(folded.data(), payload.data(), base, length5);
+      EXPECT_TRUE(expected5 == folded) << "5 bits, precision " << (int)precision << ", isa " << isa;
+      folded = registers;
+      kernels.fold4BitsWithBase(folded.data(), payload.data(), base, length4);
+      EXPECT_TRUE(expected4 == folded) << "4 bits, precision " << (int)precision << ", isa " << isa;
+    }
+  }
+}
+
+/**
+ * Everything derived from the register histogram has to match what the
+ * dedicated loops compute from the registers.
+ */
+TEST_F(HllRawTest, TestHistogramMatchesRegisters) {
+  for (uint8_t precision : {4, 10, 14}) {
+    for (size_t cardinality : {0, 10, 1000, 100000}) {
+      std::set<uint64_t> ids;
+      generateNumbers(ids, cardinality);
+      SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+      HllRaw<uint64_t> hll(precision, buffer.first.get());
+      for (uint64_t id: ids) {
+        hll.add(id);
+      }
+
+      RegisterHistogram histogram = hll.histogram();
+      uint32_t total = 0;
+      for (uint32_t count: histogram.counts) {
+        total += count;
+      }
+      EXPECT_EQ(hll.getNumberOfBuckets(), total);
+      EXPECT_EQ(hll.emptyBucketsCount(), histogram.emptyRegisters());
+      EXPECT_EQ(hll.getNumberOfSetBuckets(), histogram.setRegisters());
+      const uint8_t* synopsis = hll.getCurrentSynopsis();
+      EXPECT_EQ(*std::min_element(synopsis, synopsis + hll.getNumberOfBuckets()), histogram.minValue());
+      EXPECT_EQ(*std::max_element(synopsis, synopsis + hll.getNumberOfBuckets()), histogram.maxValue());
+
+      double harmonicSum = 0.0;
+      for (uint32_t i = 0; i < hll.getNumberOfBuckets(); ++i) {
+        harmonicSum += std::pow(2.0, -synopsis[i]);
+      }
+      EXPECT_NEAR(harmonicSum, histogram.harmonicSum(), harmonicSum * 1e-12);
+
+      // a register out of range, as a corrupted 8-bit payload could bring, lands in the last bin
+      hll.setBucketValue(3, 200);
+      for (int isa = (int)CpuIsa::DEFAULT; isa <= (int)hostCpuIsa(); ++isa) {
+        RegisterHistogram corrupted = HllKernels<uint64_t>::forPrecision(precision, (CpuIsa)isa).histogram(synopsis);
+        EXPECT_EQ(1U, corrupted.counts[RegisterHistogram::MAX_VALUE]);
+        EXPECT_EQ(hll.getNumberOfBuckets(), std::accumulate(corrupted.counts, corrupted.counts + RegisterHistogram::MAX_VALUE + 1, 0U));
+      }
+    }
+  }
+}
+
+/**
+ * The joint histogram of every instruction set has to match the scalar one,
+ * with registers equal, above and below each other, and registers out of
+ * range, which land in the last bin on both sides.
+ */
+TEST_F(HllRawTest, TestIsaJointHistogramMatchesScalar) {
+  std::mt19937 random(42);
+  for (uint8_t precision : {4, 5, 6, 10, 14, 18}) {
+    const uint32_t numberOfBuckets = 1 << precision;
+    std::vector<uint8_t> first(numberOfBuckets), second(numberOfBuckets);
+    for (uint32_t i = 0; i < numberOfBuckets; ++i) {
+      first[i] = random() % 8 + precision;
+      second[i] = random() % 3 == 0 ? first[i] : random() % 8 + precision;
+    }
+    first[0] = 0;
+    second[1] = 0;
+    first[2] = 200;
+    second[2] = 64;
+    second[3] = 255;
+
+    const JointRegisterHistogram expected = JointRegisterHistogram::of(first.data(), second.data(), numberOfBuckets);
+    for (int isa = (int)CpuIsa::DEFAULT; isa <= (int)hostCpuIsa(); ++isa) {
+      const HllKernels<uint64_t>& kernels = HllKernels<uint64_t>::forPrecision(precision, (CpuIsa)isa);
+      const JointRegisterHistogram joint = kernels.jointHistogram(first.data(), second.data());
+      EXPECT_EQ(0, memcmp(&expected, &joint, sizeof(joint))) << "precision " << (int)precision << ", isa " << isa;
+    }
+  }
+}
+
+/**
+ * Adding values in batches has to give exactly the same synopsis as adding
+ * them one by one, including when the batch isn't a multiple of the internal
+ * hashing chunk.
+ */
+TEST_F(HllRawTest, TestAddBatchMatchesAdd) {
+  const uint8_t PRECISION = 14;
+  std::set<uint64_t> idsSet;
+  generateNumbers(idsSet, 100003);
+  std::vector<uint64_t> ids(idsSet.begin(), idsSet.end());
+
+  SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(PRECISION); // sizeof(HLLHdr) + synopsis
+  SizedBuffer bufferBatch = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  HllRaw<uint64_t> hll(PRECISION, buffer.first.get());
+  HllRaw<uint64_t> hllBatch(PRECISION, bufferBatch.first.get());
+
+  for(uint64_t id: ids) {
+    hll.add(id);
+  }
+  hllBatch.addBatch(ids.data(), 1000);
+  hllBatch.addBatch(ids.data() + 1000, ids.size() - 1000);
+
+  EXPECT_TRUE(0 == std::memcmp(hll.getCurrentSynopsis(), hllBatch.getCurrentSynopsis(), hll.getNumberOfBuckets()));
+}
+
+
+/**
+ * The vectorized MurmurHash must give the very same hashes as the scalar one,
+ * otherwise synopses built with batches couldn't be merged with older ones.
+ * 77 values exercise the vector loop as well as the scalar tail.
+ */
+TEST_F(HllRawTest, TestMurMurHashBatchMatchesScalar) {
+  std::set<uint64_t> idsSet;
+  generateNumbers(idsSet, 77);
+  std::vector<uint64_t> ids(idsSet.begin(), idsSet.end());
+  ids[0] = 0;
+  ids[1] = std::numeric_limits<uint64_t>::max();
+  std::vector<uint64_t> hashes(ids.size());
+  MurMurHash<uint64_t> hash;
+
+  for (uint32_t seed : {0U, MURMURHASH_DEFAULT_SEED, std::numeric_limits<uint32_t>::max()}) {
+    hash.hashBatch(ids.data(), ids.size(), hashes.data(), seed);
+    for (size_t i = 0; i < ids.size(); ++i) {
+      EXPECT_EQ(hash(ids[i], seed), hashes[i]);
+    }
+  }
+}
+
+/**
+ * Our XXH3 has to give the hashes of the reference implementation, on the
+ * integer path and on strings of every length class.
+ */
+TEST_F(HllRawTest, TestXxh3MatchesReference) {
+  EXPECT_EQ(0x089784669ed6f9efULL, Xxh3Hash<uint64_t>::hash(42, MURMURHASH_DEFAULT_SEED));
+  EXPECT_EQ(0xc77b3abb6f87acd9ULL, Xxh3Hash<uint64_t>::hash(0, 0));
+
+  const std::vector<std::pair<std::string, uint64_t>> strings = {
+    {"", 0x2d06800538d394c2ULL},
+    {"hll", 0xf46e71df6931910aULL},
+    {"criteo", 0xd368a16be3c44d27ULL},
+    {"vertica-hyperloglog", 0x3254ae2a58195183ULL},
+    {"https://github.com/criteo/vertica-hyperloglog", 0x3cccda2db4916b28ULL}
+  };
+  for (const auto& string: strings) {
+    EXPECT_EQ(string.second, Xxh3::hashBytes(reinterpret_cast<const uint8_t*>(string.first.data()), string.first.size()))
+      << string.first;
+  }
+  std::vector<uint8_t> bytes(1000);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = i % 251;
+  }
+  EXPECT_EQ(0xf42a8864feaf0703ULL, Xxh3::hashBytes(bytes.data(), 200));
+  EXPECT_EQ(0x33ef703fb2b20ed1ULL, Xxh3::hashBytes(bytes.data(), 1000));
+}
+
+/**
+ * Every hash function a synopsis can be built with has to hash a batch as it
+ * hashes one value, and keep the estimate within 3 standard errors on
+ * consecutive integers, the input a weak mixer gets wrong first.
+ */
+TEST_F(HllRawTest, TestHashFunctionsErrorWithinRange) {
+  const uint8_t PRECISION = 14;
+  const double standardError = 1.04 / std::sqrt(1 << PRECISION);
+  // the vector loops of hashBatch() and their scalar tail
+  std::vector<uint64_t> hashes(77);
+  std::vector<uint64_t> ids(hashes.size());
+  std::iota(ids.begin(), ids.end(), std::numeric_limits<uint64_t>::max() - ids.size() + 1);
+
+  for (size_t f = 0; f < HashFunction::COUNT; ++f) {
+    const HashFunction& function = HashFunction::all()[f];
+    function.hashBatch(ids.data(), ids.size(), hashes.data(), MURMURHASH_DEFAULT_SEED);
+    std::vector<uint64_t> one(1);
+    for (size_t i = 0; i < ids.size(); ++i) {
+      function.hashBatch(&ids[i], 1, one.data(), MURMURHASH_DEFAULT_SEED);
+      EXPECT_EQ(one[0], hashes[i]) << function.name;
+    }
+
+    for (uint64_t cardinality: {1000, 100000, 2000000}) {
+      // with room for the histogram addHashes() would keep if the synopsis tracked one
+      SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(PRECISION, true);
+      Hll<uint64_t> hll(PRECISION, buffer.first.get());
+      hll.reset();
+      for (uint64_t offset = 0; offset < cardinality; offset += hashes.size()) {
+        const size_t chunk = std::min<uint64_t>(hashes.size(), cardinality - offset);
+        std::iota(ids.begin(), ids.begin() + chunk, offset);
+        function.hashBatch(ids.data(), chunk, hashes.data(), MURMURHASH_DEFAULT_SEED);
+        hll.addHashes(hashes.data(), chunk, function.id);
+      }
+      const double error = std::fabs(static_cast<double>(hll.approximateCountDistinct()) - cardinality) / cardinality;
+      EXPECT_LT(error, 3 * standardError) << function.name << " " << cardinality;
+    }
+  }
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
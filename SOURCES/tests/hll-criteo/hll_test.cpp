@@ -1,6 +1,8 @@
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 #include <string>
 #include <vector>
 #include <stdint.h>
@@ -8,6 +10,8 @@
 #include "../base_test.hpp"
 #include "gtest/gtest.h"
 #include "hll-criteo/hll.hpp"
+#include "hll-criteo/hll_window.hpp"
+#include "hll-criteo/string_key.hpp"
 
 using namespace std;
 
@@ -45,7 +49,7 @@ class HllTest : public HllBaseTest {
  *
  * What we want to test is basically that the HLLHdr
  * get serialized as well. If so, the synopsis size will
- * be 8 bytes longer than for HllRaw
+ * be 24 bytes longer than for HllRaw
  */
 TEST_F(HllTest, TestSerializeDeserialize6Bits) {
   std::vector<uint64_t> ids;
@@ -67,7 +71,7 @@ TEST_F(HllTest, TestSerializeDeserialize6Bits) {
      * we expect his fixed length
 
      */
-    const uint32_t ARRAY_LENGTH_6BYTES_BUCKETS_COMPRESSED_WITH_HDR = ((1<<prec)*6/8)+8;
+    const uint32_t ARRAY_LENGTH_6BYTES_BUCKETS_COMPRESSED_WITH_HDR = ((1<<prec)*6/8)+24;
     EXPECT_EQ(byte_array.second, ARRAY_LENGTH_6BYTES_BUCKETS_COMPRESSED_WITH_HDR);
 
     SizedBuffer bufferFolded = Hll<uint64_t>::makeDeserializedBuffer(prec);
@@ -102,7 +106,7 @@ TEST_F(HllTest, TestSerializeDeserialize5Bits) {
      * we expect his fixed length
 
      */
-    const uint32_t ARRAY_LENGTH_5BYTES_BUCKETS_COMPRESSED_WITH_HDR = ((1<<prec)*5/8)+8;
+    const uint32_t ARRAY_LENGTH_5BYTES_BUCKETS_COMPRESSED_WITH_HDR = ((1<<prec)*5/8)+24;
     EXPECT_EQ(byte_array.second, ARRAY_LENGTH_5BYTES_BUCKETS_COMPRESSED_WITH_HDR);
 
     SizedBuffer bufferFolded = Hll<uint64_t>::makeDeserializedBuffer(prec);
@@ -239,4 +243,1022 @@ TEST_F(HllTest, TestApproximateCounts) {
   }
 }
 
+/**
+ * The improved estimator has no table and no threshold, so it is checked at
+ * every precision, from an empty synopsis to cardinalities far above 5m where
+ * the other estimators switch from bias correction to the raw estimate.
+ */
+TEST_F(HllTest, TestImprovedEstimateErrorWithinRange) {
+  const std::vector<uint64_t> testCardinalities = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+  for(uint8_t prec = 4; prec <= 18; ++prec) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> hll(prec, buffer.first.get());
+    EXPECT_EQ(0U, hll.approximateCountDistinct_improved());
+
+    // 4 standard errors, plus one for the rounding of small counts
+    const double expectedMaxError = 4 * 1.04 / std::sqrt(1 << prec);
+    uint64_t itemsAdded = 0;
+    for (uint64_t cardinality: testCardinalities) {
+      for (; itemsAdded < cardinality; ++itemsAdded) {
+        hll.add(itemsAdded);
+      }
+      uint64_t estimate = hll.approximateCountDistinct_improved();
+      EXPECT_GE(estimate, (1.0 - expectedMaxError) * cardinality - 1) << "precision " << (int)prec;
+      EXPECT_LE(estimate, (1.0 + expectedMaxError) * cardinality + 1) << "precision " << (int)prec;
+      EXPECT_EQ(estimate, hll.approximateCountDistinct_improved(hll.histogram()));
+    }
+  }
+}
+
+/**
+ * A synopsis started sparse has to end up with the very registers of one
+ * started dense, whether it is still sparse (through its histogram) or has
+ * been made dense, and whichever way the values came in.
+ */
+TEST_F(HllTest, TestSparseMatchesDense) {
+  const std::vector<uint64_t> testCardinalities = {1, 10, 100, 1000, 10000, 100000};
+
+  for(uint8_t prec = HllSparse::MIN_PRECISION; prec <= 18; ++prec) {
+    SizedBuffer sparseBuffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> sparse(prec, sparseBuffer.first.get());
+    sparse.resetSparse();
+    SizedBuffer denseBuffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> dense(prec, denseBuffer.first.get());
+    dense.reset();
+    EXPECT_TRUE(sparse.isSparse());
+    EXPECT_EQ(0U, sparse.approximateCountDistinct());
+
+    uint64_t itemsAdded = 0;
+    for (uint64_t cardinality: testCardinalities) {
+      std::vector<uint64_t> values;
+      for (; itemsAdded < cardinality; ++itemsAdded) {
+        values.push_back(itemsAdded * 0x9E3779B97F4A7C15ULL);
+      }
+      // half one by one, half in a batch
+      for (size_t i = 0; i < values.size() / 2; ++i) {
+        sparse.add(values[i]);
+      }
+      sparse.addBatch(values.data() + values.size() / 2, values.size() - values.size() / 2);
+      dense.addBatch(values.data(), values.size());
+
+      const RegisterHistogram expected = dense.histogram();
+      const RegisterHistogram actual = sparse.histogram();
+      EXPECT_EQ(0, memcmp(expected.counts, actual.counts, sizeof(expected.counts)))
+        << "precision " << (int)prec << ", cardinality " << cardinality;
+    }
+    // the largest cardinality doesn't fit in the buffer
+    EXPECT_FALSE(sparse.isSparse()) << "precision " << (int)prec;
+
+    sparse.toDense();
+    EXPECT_EQ(0, memcmp(sparseBuffer.first.get(), denseBuffer.first.get(), denseBuffer.second))
+      << "precision " << (int)prec;
+  }
+}
+
+/**
+ * The sparse list is merged and made dense in place, which has to hold for
+ * the hashes that pack its bytes the tightest: runs of consecutive index'
+ * (one-byte deltas, many entries per register) and pairs of index' on either
+ * side of a register boundary, as well as spread out ones.
+ */
+TEST_F(HllTest, TestSparseInPlaceMatchesDense) {
+  const HashFunction& murmur = *HashFunction::forName("murmur");
+  for (uint8_t prec: {HllSparse::MIN_PRECISION, (uint8_t)12, (uint8_t)18}) {
+    const uint8_t extraBits = HllSparse::PRECISION - prec;
+    std::vector<std::vector<uint64_t>> cases(3);
+    for (uint64_t i = 0; i < (1U << prec); ++i) {
+      // index' i, then bits that give rho' from 1 to 39
+      cases[0].push_back(i << (64 - HllSparse::PRECISION) | (1ULL << (38 - i % 39)));
+      const uint64_t boundary = (i + 1) << extraBits;
+      cases[1].push_back((boundary - 1) << (64 - HllSparse::PRECISION) | (1ULL << (i % 39)));
+      cases[1].push_back(boundary % (1U << HllSparse::PRECISION) << (64 - HllSparse::PRECISION) | 1);
+      cases[2].push_back((i + 1) * 0x9E3779B97F4A7C15ULL);
+    }
+    for (size_t c = 0; c < cases.size(); ++c) {
+      SizedBuffer sparseBuffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+      Hll<uint64_t> sparse(prec, sparseBuffer.first.get());
+      sparse.resetSparse();
+      SizedBuffer denseBuffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+      Hll<uint64_t> dense(prec, denseBuffer.first.get());
+      dense.reset();
+      for (size_t i = 0; i < cases[c].size() && sparse.isSparse(); i += 7) {
+        const size_t n = std::min<size_t>(7, cases[c].size() - i);
+        sparse.addHashes(cases[c].data() + i, n, murmur.id);
+        dense.addHashes(cases[c].data() + i, n, murmur.id);
+        if (i % 700 == 0) {
+          const RegisterHistogram expected = dense.histogram();
+          const RegisterHistogram actual = sparse.histogram();
+          ASSERT_EQ(0, memcmp(expected.counts, actual.counts, sizeof(expected.counts)))
+            << "precision " << (int)prec << ", case " << c << ", hash " << i;
+        }
+      }
+      sparse.toDense();
+      EXPECT_EQ(0, memcmp(sparseBuffer.first.get(), denseBuffer.first.get(), denseBuffer.second))
+        << "precision " << (int)prec << ", case " << c;
+    }
+  }
+}
+
+/**
+ * Intermediate aggregates are folded into each other with fold(), sparse
+ * ones included: into a sparse synopsis, which may have to become dense on
+ * the way, and into a dense one.
+ */
+TEST_F(HllTest, TestFoldSparse) {
+  const uint8_t prec = 12;
+  for (uint64_t cardinality: {100, 1000, 10000}) {
+    SizedBuffer expectedBuffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> expected(prec, expectedBuffer.first.get());
+    expected.reset();
+
+    std::vector<SizedBuffer> buffers;
+    for (uint64_t part = 0; part < 3; ++part) {
+      buffers.push_back(Hll<uint64_t>::makeDeserializedBuffer(prec));
+      Hll<uint64_t> hll(prec, buffers.back().first.get());
+      hll.resetSparse();
+      for (uint64_t value = part; value < cardinality * 3; value += 3) {
+        hll.add(value);
+        expected.add(value);
+      }
+    }
+
+    SizedBuffer sparseBuffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> sparse(prec, sparseBuffer.first.get());
+    sparse.resetSparse();
+    SizedBuffer denseBuffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> dense(prec, denseBuffer.first.get());
+    dense.reset();
+    for (const SizedBuffer& buffer: buffers) {
+      sparse.fold(buffer.first.get(), buffer.second);
+      dense.fold(buffer.first.get(), buffer.second);
+    }
+    sparse.toDense();
+    EXPECT_EQ(0, memcmp(sparseBuffer.first.get(), expectedBuffer.first.get(), expectedBuffer.second))
+      << "cardinality " << cardinality;
+    EXPECT_EQ(0, memcmp(denseBuffer.first.get(), expectedBuffer.first.get(), expectedBuffer.second))
+      << "cardinality " << cardinality;
+  }
+}
+
+/**
+ * While sparse, the in-memory synopsis counts at precision 25, so small
+ * cardinalities come out nearly exact at any precision.
+ */
+TEST_F(HllTest, TestSparseEstimateSmallCardinalities) {
+  for(uint8_t prec = 10; prec <= 18; prec += 4) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> hll(prec, buffer.first.get());
+    hll.resetSparse();
+    for (uint64_t value = 0; value < (1U << prec) / 8; ++value) {
+      hll.add(value);
+      if (value % 37 == 0) {
+        ASSERT_TRUE(hll.isSparse());
+        uint64_t cardinality = value + 1;
+        EXPECT_NEAR(cardinality, hll.approximateCountDistinct(), 0.005 * cardinality + 1)
+          << "precision " << (int)prec;
+      }
+    }
+  }
+}
+
+/**
+ *                *********************
+ *                *** SPARSE VARINT ***
+ *                *********************
+ *
+ * Holds bucket ids above 16 bits, takes exactly the size it advertises and
+ * is only picked while it is smaller than the dense format.
+ */
+TEST_F(HllTest, TestSerializeDeserializeSparseVarint) {
+  for(uint8_t prec = 10; prec <= 18; ++prec) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> hll(prec, buffer.first.get());
+    hll.reset();
+
+    for (uint64_t cardinality: {0, 1, 10, 100, 1000, 10000}) {
+      for (uint64_t id = cardinality / 10; id < cardinality; ++id) {
+        hll.add(id);
+      }
+      const RegisterHistogram histogram = hll.histogram();
+      const uint64_t length = hll.getSerializedBufferSize(Format::SPARSE_VARINT, histogram);
+      std::vector<uint8_t> byte_array(length + 1, 0xAA);
+      hll.serialize(byte_array.data(), Format::SPARSE_VARINT, histogram);
+      EXPECT_EQ(0xAA, byte_array[length]) << "precision " << (int)prec << ", cardinality " << cardinality;
+
+      SizedBuffer bufferFolded = Hll<uint64_t>::makeDeserializedBuffer(prec);
+      Hll<uint64_t> folded_hll(prec, bufferFolded.first.get());
+      folded_hll.reset();
+      folded_hll.fold(byte_array.data(), length);
+      EXPECT_EQ(0, memcmp(buffer.first.get(), bufferFolded.first.get(), buffer.second))
+        << "precision " << (int)prec << ", cardinality " << cardinality;
+
+      EXPECT_EQ(length < hll.getSerializedBufferSize(Format::COMPACT_6BITS),
+        hll.isBetterSerializedSparse(Format::COMPACT_6BITS, histogram));
+    }
+  }
+}
+
+/**
+ * AUTO has to pick the smallest format among the ones that give back the
+ * exact same registers, leaving out the entropy coded one, which is slower
+ * to fold.
+ */
+TEST_F(HllTest, TestAutoFormatIsSmallestLossless) {
+  const std::vector<Format> formats = {Format::NORMAL, Format::COMPACT_6BITS, Format::COMPACT_5BITS,
+    Format::COMPACT_4BITS, Format::SPARSE_VARINT, Format::COMPACT_5BITS_EXCEPTIONS, Format::COMPACT_4BITS_EXCEPTIONS};
+
+  for(uint8_t prec = 10; prec <= 18; prec += 4) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> hll(prec, buffer.first.get());
+    hll.reset();
+
+    uint64_t itemsAdded = 0;
+    for (uint64_t cardinality: {10, 1000, 100000, 10000000}) {
+      for (; itemsAdded < cardinality; ++itemsAdded) {
+        hll.add(itemsAdded);
+      }
+      const RegisterHistogram histogram = hll.histogram();
+      const Format chosen = hll.serializationFormat(Format::AUTO, histogram);
+      const uint64_t chosenSize = hll.getSerializedBufferSize(chosen, histogram);
+      EXPECT_NE(Format::ENTROPY, chosen) << "precision " << (int)prec << ", cardinality " << cardinality;
+
+      for (Format format: formats) {
+        const uint64_t length = hll.getSerializedBufferSize(format, histogram);
+        std::vector<uint8_t> byte_array(length);
+        hll.serialize(byte_array.data(), format, histogram);
+        SizedBuffer bufferFolded = Hll<uint64_t>::makeDeserializedBuffer(prec);
+        Hll<uint64_t> folded_hll(prec, bufferFolded.first.get());
+        folded_hll.reset();
+        folded_hll.fold(byte_array.data(), length);
+        const bool lossless = memcmp(buffer.first.get(), bufferFolded.first.get(), buffer.second) == 0;
+
+        if (format == chosen) {
+          EXPECT_TRUE(lossless) << "precision " << (int)prec << ", cardinality " << cardinality;
+        } else if (lossless) {
+          EXPECT_LE(chosenSize, length) << "precision " << (int)prec << ", cardinality " << cardinality;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * The 4 and 5-bit formats with exceptions give back every register, the ones
+ * the plain formats clamp included, and take the size they advertise.
+ */
+TEST_F(HllTest, TestSerializeDeserializeWithExceptions) {
+  for(uint8_t prec = 10; prec <= 18; prec += 2) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> hll(prec, buffer.first.get());
+    hll.reset();
+    for (uint64_t id = 0; id < (100ULL << prec); ++id) {
+      hll.add(id);
+    }
+    // a few outliers far above the rest, one of them in the last register
+    uint8_t* registers = buffer.first.get() + sizeof(HLLHdr);
+    for (uint64_t i = 7; i < (1ULL << prec); i += 1001) {
+      registers[i] = 30 + i % 20;
+    }
+    registers[(1ULL << prec) - 1] = 64 - prec + 1;
+
+    for (Format format: {Format::COMPACT_5BITS_EXCEPTIONS, Format::COMPACT_4BITS_EXCEPTIONS}) {
+      const RegisterHistogram histogram = hll.histogram();
+      const uint64_t length = hll.getSerializedBufferSize(format, histogram);
+      std::vector<uint8_t> byte_array(length + 1, 0xAA);
+      hll.serialize(byte_array.data(), format);
+      EXPECT_EQ(0xAA, byte_array[length]) << "precision " << (int)prec;
+
+      SizedBuffer bufferFolded = Hll<uint64_t>::makeDeserializedBuffer(prec);
+      Hll<uint64_t> folded_hll(prec, bufferFolded.first.get());
+      folded_hll.reset();
+      folded_hll.fold(byte_array.data(), length);
+      EXPECT_EQ(0, memcmp(buffer.first.get(), bufferFolded.first.get(), buffer.second))
+        << "precision " << (int)prec;
+      EXPECT_THROW(folded_hll.fold(byte_array.data(), length - 1), SerializationError);
+    }
+  }
+}
+
+/**
+ * The entropy coded format gives back every register, takes the size it
+ * advertises, fewer bytes than 4 bits per register past small cardinalities,
+ * and rejects a truncated payload.
+ */
+TEST_F(HllTest, TestSerializeDeserializeEntropy) {
+  for(uint8_t prec = 10; prec <= 18; prec += 2) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> hll(prec, buffer.first.get());
+    hll.reset();
+
+    uint64_t itemsAdded = 0;
+    for (uint64_t cardinality: {0, 100, 10000, 1000000, 10000000}) {
+      for (; itemsAdded < cardinality; ++itemsAdded) {
+        hll.add(itemsAdded);
+      }
+      const RegisterHistogram histogram = hll.histogram();
+      const uint64_t length = hll.getSerializedBufferSize(Format::ENTROPY, histogram);
+      std::vector<uint8_t> byte_array(length + 1, 0xAA);
+      hll.serialize(byte_array.data(), Format::ENTROPY, histogram);
+      EXPECT_EQ(0xAA, byte_array[length]) << "precision " << (int)prec << ", cardinality " << cardinality;
+      if (cardinality >= (1ULL << prec)) {
+        EXPECT_LT(length, hll.getSerializedBufferSize(Format::COMPACT_4BITS))
+          << "precision " << (int)prec << ", cardinality " << cardinality;
+      }
+
+      SizedBuffer bufferFolded = Hll<uint64_t>::makeDeserializedBuffer(prec);
+      Hll<uint64_t> folded_hll(prec, bufferFolded.first.get());
+      folded_hll.reset();
+      folded_hll.fold(byte_array.data(), length);
+      EXPECT_EQ(0, memcmp(buffer.first.get(), bufferFolded.first.get(), buffer.second))
+        << "precision " << (int)prec << ", cardinality " << cardinality;
+      EXPECT_THROW(folded_hll.fold(byte_array.data(), length - 2), SerializationError);
+    }
+  }
+}
+
+/**
+ * The codes of the entropy coded format are the ones synopses were written
+ * with: the code lengths of every center and a few encoded registers are
+ * pinned, so that a change to them fails here rather than decoding stored
+ * synopses into other registers.
+ */
+TEST_F(HllTest, TestEntropyCodesArePinned) {
+  const uint8_t SYMBOLS = RegisterEntropyCode::NUMBER_OF_SYMBOLS;
+  std::vector<uint8_t> lengths(RegisterEntropyCode::NUMBER_OF_CENTERS * SYMBOLS);
+  for (uint8_t center = 0; center < RegisterEntropyCode::NUMBER_OF_CENTERS; ++center) {
+    memcpy(lengths.data() + center * SYMBOLS, RegisterEntropyCode::forCenter(center).lengths, SYMBOLS);
+  }
+  EXPECT_EQ(0xf20cc89eU, Crc32c::of(lengths.data(), lengths.size()));
+
+  const uint8_t registers[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 12, 20, 40, 63, 3};
+  const std::vector<std::pair<uint8_t, std::vector<uint8_t>>> expected = {
+    {0, {0x5b, 0xbc, 0x3c, 0x4f, 0x17, 0xc6, 0xf1, 0xfc, 0x8f, 0x27, 0xcb, 0xf4, 0xfe, 0x7f, 0xfb, 0x80}},
+    {3, {0xf1, 0x20, 0xdd, 0xde, 0x1e, 0x2f, 0x8d, 0xe3, 0xf9, 0x3e, 0x8f, 0xcb, 0xfe, 0x20}},
+    {20, {0xf1, 0x3c, 0x5f, 0x1b, 0xc7, 0xf2, 0x3c, 0x9f, 0x2b, 0xcb, 0xf3, 0x3c, 0xdf, 0x3b, 0xd0, 0x7e, 0x5f, 0xf3, 0xc7}}
+  };
+  for (const auto& centerAndBytes: expected) {
+    const RegisterEntropyCode& code = RegisterEntropyCode::forCenter(centerAndBytes.first);
+    std::vector<uint8_t> encoded(2 * sizeof(registers));
+    encoded.resize(code.encode(registers, 16, encoded.data()));
+    EXPECT_EQ(centerAndBytes.second, encoded) << "center " << (int)centerAndBytes.first;
+
+    uint8_t decoded[16] = {};
+    ASSERT_TRUE(code.decodeFold(encoded.data(), encoded.size(), decoded, 16));
+    EXPECT_EQ(0, memcmp(registers, decoded, sizeof(registers))) << "center " << (int)centerAndBytes.first;
+  }
+}
+
+/**
+ * foldMany() gives the same synopsis as fold() of each payload, whatever
+ * their formats, and more of them than it folds at once.
+ */
+TEST_F(HllTest, TestFoldManyMatchesFold) {
+  const std::vector<Format> formats = {Format::NORMAL, Format::COMPACT_6BITS, Format::COMPACT_5BITS,
+    Format::COMPACT_4BITS, Format::SPARSE_VARINT, Format::COMPACT_5BITS_EXCEPTIONS, Format::COMPACT_4BITS_EXCEPTIONS,
+    Format::ENTROPY};
+
+  for(uint8_t prec: {8, 14, 16}) {
+    std::vector<std::vector<uint8_t>> payloads;
+    uint64_t value = 0;
+    for (size_t k = 0; k < 150; ++k) {
+      SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+      Hll<uint64_t> hll(prec, buffer.first.get());
+      hll.reset();
+      const uint64_t cardinality = 1ULL << (k % 20);
+      for (uint64_t i = 0; i < cardinality; ++i) {
+        hll.add(value++);
+      }
+      const Format format = formats[k % formats.size()];
+      std::vector<uint8_t> payload(hll.getSerializedBufferSize(format, hll.histogram()));
+      hll.serialize(payload.data(), format, hll.histogram());
+      payloads.push_back(payload);
+    }
+    std::vector<const uint8_t*> byteArrays;
+    std::vector<size_t> lengths;
+    for (const std::vector<uint8_t>& payload: payloads) {
+      byteArrays.push_back(payload.data());
+      lengths.push_back(payload.size());
+    }
+
+    SizedBuffer expected = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> expected_hll(prec, expected.first.get());
+    expected_hll.reset();
+    for (size_t k = 0; k < payloads.size(); ++k) {
+      expected_hll.fold(byteArrays[k], lengths[k]);
+    }
+    SizedBuffer folded = Hll<uint64_t>::makeDeserializedBuffer(prec);
+    Hll<uint64_t> folded_hll(prec, folded.first.get());
+    folded_hll.resetSparse();
+    folded_hll.foldMany(byteArrays.data(), lengths.data(), payloads.size());
+    EXPECT_EQ(0, memcmp(expected.first.get(), folded.first.get(), expected.second)) << "precision " << (int)prec;
+
+    lengths[1] -= 10;
+    EXPECT_THROW(folded_hll.foldMany(byteArrays.data(), lengths.data(), payloads.size()), SerializationError);
+  }
+}
+
+/**
+ * The same synopsis with the 8-byte header of version 1, written before the
+ * header had a version, and before it had the precision unless withPrecision.
+ */
+std::vector<uint8_t> toVersion1(const std::vector<uint8_t>& payload, bool withPrecision) {
+  std::vector<uint8_t> v1(HLL_HEADER_V1_SIZE + payload.size() - sizeof(HLLHdr));
+  std::copy(payload.begin(), payload.begin() + HLL_HEADER_V1_SIZE, v1.begin());
+  std::copy(payload.begin() + sizeof(HLLHdr), payload.end(), v1.begin() + HLL_HEADER_V1_SIZE);
+  v1[offsetof(HLLHdr, version)] = 0;
+  if (!withPrecision) {
+    v1[offsetof(HLLHdr, precision)] = 0;
+  }
+  return v1;
+}
+
+/**
+ * histogramOf() counts the registers fold() would give, read from the payload
+ * of every format, of a higher precision and with the header of version 1.
+ */
+TEST_F(HllTest, TestHistogramOfMatchesFold) {
+  const std::vector<Format> formats = {Format::NORMAL, Format::COMPACT_6BITS, Format::COMPACT_5BITS,
+    Format::COMPACT_4BITS, Format::SPARSE, Format::SPARSE_VARINT, Format::COMPACT_5BITS_EXCEPTIONS,
+    Format::COMPACT_4BITS_EXCEPTIONS, Format::ENTROPY};
+
+  for (uint8_t prec: {4, 12, 16}) {
+    for (uint64_t cardinality: {0, 10, 3000, 100000, 5000000}) {
+      SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(prec);
+      Hll<uint64_t> hll(prec, buffer.first.get());
+      hll.reset();
+      for (uint64_t i = 0; i < cardinality; ++i) {
+        hll.add(i);
+      }
+      // a few registers far above the others, for the exceptions and the 4 and 5-bit clamping
+      if (cardinality != 0) {
+        hll.addHashes(std::vector<uint64_t>{1, 2, 3}.data(), 3, MurMurHash<uint64_t>::ID);
+      }
+
+      for (Format format: formats) {
+        if (format == Format::SPARSE && prec > 12) {
+          // the count of its buckets only goes up to 65535
+          continue;
+        }
+        std::vector<uint8_t> payload(hll.getSerializedBufferSize(format, hll.histogram()));
+        hll.serialize(payload.data(), format, hll.histogram());
+        for (bool version1: {false, true}) {
+          const std::vector<uint8_t> read = version1 ? toVersion1(payload, false) : payload;
+          SizedBuffer folded = Hll<uint64_t>::makeDeserializedBuffer(prec);
+          Hll<uint64_t> foldedHll(prec, folded.first.get());
+          foldedHll.reset();
+          foldedHll.fold(read.data(), read.size());
+          const RegisterHistogram expected = foldedHll.histogram();
+
+          SizedBuffer scratch = Hll<uint64_t>::makeDeserializedBuffer(prec);
+          Hll<uint64_t> reader(Hll<uint64_t>::precisionOf(read.data(), read.size(), prec), scratch.first.get());
+          const RegisterHistogram histogram = reader.histogramOf(read.data(), read.size());
+          EXPECT_EQ(0, memcmp(expected.counts, histogram.counts, sizeof(expected.counts)))
+            << "precision " << (int)prec << ", cardinality " << cardinality << ", format " << (int)format;
+          EXPECT_EQ(foldedHll.approximateCountDistinct(), reader.approximateCountDistinct(histogram));
+          EXPECT_THROW(reader.histogramOf(read.data(), read.size() / 2), SerializationError);
+        }
+      }
+
+      // read at a lower precision, folded down
+      if (prec > 4) {
+        std::vector<uint8_t> payload(hll.getSerializedBufferSize(Format::COMPACT_6BITS));
+        hll.serialize(payload.data(), Format::COMPACT_6BITS);
+        SizedBuffer folded = Hll<uint64_t>::makeDeserializedBuffer(4);
+        Hll<uint64_t> foldedHll(4, folded.first.get());
+        foldedHll.reset();
+        foldedHll.fold(payload.data(), payload.size());
+        SizedBuffer scratch = Hll<uint64_t>::makeDeserializedBuffer(4);
+        Hll<uint64_t> reader(4, scratch.first.get());
+        const RegisterHistogram histogram = reader.histogramOf(payload.data(), payload.size());
+        EXPECT_EQ(0, memcmp(foldedHll.histogram().counts, histogram.counts, sizeof(histogram.counts)));
+      }
+    }
+  }
+}
+
+/**
+ * A synopsis folded down from a higher precision is the one the same values
+ * give at the lower precision, whatever format it comes in. Synopses
+ * written before the precision was recorded are read at the reader's, and
+ * a synopsis can't be folded into one of a higher precision.
+ */
+TEST_F(HllTest, TestFoldHigherPrecision) {
+  const std::vector<Format> formats = {Format::NORMAL, Format::COMPACT_6BITS, Format::SPARSE_VARINT,
+    Format::COMPACT_4BITS_EXCEPTIONS, Format::ENTROPY};
+  std::vector<uint8_t> scratch(Hll<uint64_t>::getMaxDeserializedBufferSize(18), 0xff);
+
+  for (uint8_t low: {4, 12}) {
+    for (uint8_t high: {14, 18}) {
+      for (uint64_t cardinality: {10, 10000, 1000000}) {
+        SizedBuffer lowBuffer = Hll<uint64_t>::makeDeserializedBuffer(low);
+        Hll<uint64_t> lowHll(low, lowBuffer.first.get());
+        lowHll.reset();
+        SizedBuffer highBuffer = Hll<uint64_t>::makeDeserializedBuffer(high);
+        Hll<uint64_t> highHll(high, highBuffer.first.get());
+        highHll.reset();
+        for (uint64_t i = 0; i < cardinality; ++i) {
+          lowHll.add(i);
+          highHll.add(i);
+        }
+
+        for (Format format: formats) {
+          std::vector<uint8_t> payload(highHll.getSerializedBufferSize(format, highHll.histogram()));
+          highHll.serialize(payload.data(), format, highHll.histogram());
+          SizedBuffer folded = Hll<uint64_t>::makeDeserializedBuffer(low);
+          Hll<uint64_t> foldedHll(low, folded.first.get());
+          foldedHll.reset();
+          foldedHll.fold(payload.data(), payload.size());
+          EXPECT_EQ(0, memcmp(lowBuffer.first.get(), folded.first.get(), lowBuffer.second))
+            << "precision " << (int)high << " to " << (int)low << ", cardinality " << cardinality;
+
+          // the same through the scratch of setFoldScratch(), whatever it held before
+          SizedBuffer withScratch = Hll<uint64_t>::makeDeserializedBuffer(low);
+          Hll<uint64_t> withScratchHll(low, withScratch.first.get());
+          withScratchHll.reset();
+          withScratchHll.setFoldScratch(scratch.data(), scratch.size());
+          const uint8_t* byteArrays[] = {payload.data()};
+          const size_t lengths[] = {payload.size()};
+          withScratchHll.foldMany(byteArrays, lengths, 1);
+          EXPECT_EQ(0, memcmp(lowBuffer.first.get(), withScratch.first.get(), lowBuffer.second))
+            << "precision " << (int)high << " to " << (int)low << ", cardinality " << cardinality;
+        }
+
+        SizedBuffer added = Hll<uint64_t>::makeDeserializedBuffer(low);
+        Hll<uint64_t> addedHll(low, added.first.get());
+        addedHll.reset();
+        addedHll.add(highHll);
+        EXPECT_EQ(0, memcmp(lowBuffer.first.get(), added.first.get(), lowBuffer.second));
+        EXPECT_THROW(highHll.add(lowHll), SerializationError);
+
+        std::vector<uint8_t> payload(lowHll.getSerializedBufferSize(Format::COMPACT_6BITS));
+        lowHll.serialize(payload.data(), Format::COMPACT_6BITS);
+        EXPECT_THROW(highHll.fold(payload.data(), payload.size()), SerializationError);
+        // written before the precision was recorded
+        const std::vector<uint8_t> v1 = toVersion1(payload, false);
+        SizedBuffer unrecorded = Hll<uint64_t>::makeDeserializedBuffer(low);
+        Hll<uint64_t> unrecordedHll(low, unrecorded.first.get());
+        unrecordedHll.reset();
+        unrecordedHll.fold(v1.data(), v1.size());
+        EXPECT_EQ(0, memcmp(lowBuffer.first.get() + sizeof(HLLHdr), unrecorded.first.get() + sizeof(HLLHdr),
+          lowBuffer.second - sizeof(HLLHdr)));
+      }
+    }
+  }
+}
+
+/**
+ * Version 1 payloads fold as they did. Version 2 ones only fold into a
+ * synopsis of the same hash function and seed, and into any buffer longer
+ * than the length in their header, and a checksum catches a changed byte.
+ */
+TEST_F(HllTest, TestHeaderVersions) {
+  const uint8_t PRECISION = 12;
+  const uint8_t HASH_ID = MurMurHash<uint64_t>::ID;
+  const std::vector<Format> formats = {Format::NORMAL, Format::COMPACT_6BITS, Format::SPARSE_VARINT,
+    Format::COMPACT_4BITS_EXCEPTIONS, Format::ENTROPY};
+
+  for (uint64_t cardinality: {10, 100000}) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    Hll<uint64_t> hll(PRECISION, buffer.first.get());
+    hll.reset();
+    for (uint64_t i = 0; i < cardinality; ++i) {
+      hll.add(i);
+    }
+
+    for (Format format: formats) {
+      const RegisterHistogram histogram = hll.histogram();
+      std::vector<uint8_t> payload(hll.getSerializedBufferSize(format, histogram));
+      hll.serialize(payload.data(), format, histogram);
+      HLLHdr hdr;
+      memcpy(reinterpret_cast<uint8_t*>(&hdr), payload.data(), sizeof(HLLHdr));
+      EXPECT_EQ(HLL_HEADER_VERSION, hdr.version);
+      EXPECT_EQ(PRECISION, hdr.precision);
+      EXPECT_EQ(MURMURHASH_DEFAULT_SEED, hdr.hashSeed);
+      EXPECT_EQ(HASH_ID, hdr.hashId);
+      EXPECT_EQ(payload.size() - sizeof(HLLHdr), hdr.length);
+      EXPECT_EQ(0, hdr.flags);
+
+      for (bool withPrecision: {false, true}) {
+        const std::vector<uint8_t> v1 = toVersion1(payload, withPrecision);
+        SizedBuffer folded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+        Hll<uint64_t> foldedHll(PRECISION, folded.first.get());
+        foldedHll.reset();
+        foldedHll.fold(v1.data(), v1.size());
+        EXPECT_EQ(0, memcmp(buffer.first.get() + sizeof(HLLHdr), folded.first.get() + sizeof(HLLHdr),
+          buffer.second - sizeof(HLLHdr))) << "format " << (int)format;
+      }
+
+      // the bytes past the length in the header aren't read
+      std::vector<uint8_t> longer(payload);
+      longer.resize(payload.size() + 100, 0xff);
+      SizedBuffer folded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+      Hll<uint64_t> foldedHll(PRECISION, folded.first.get());
+      foldedHll.reset();
+      foldedHll.fold(longer.data(), longer.size());
+      EXPECT_EQ(0, memcmp(buffer.first.get() + sizeof(HLLHdr), folded.first.get() + sizeof(HLLHdr),
+        buffer.second - sizeof(HLLHdr))) << "format " << (int)format;
+      EXPECT_THROW(foldedHll.fold(payload.data(), payload.size() - 1), SerializationError);
+
+      SizedBuffer seeded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+      Hll<uint64_t> seededHll(PRECISION, seeded.first.get(), MURMURHASH_DEFAULT_SEED + 1);
+      seededHll.reset();
+      EXPECT_THROW(seededHll.fold(payload.data(), payload.size()), SerializationError);
+      const std::vector<uint8_t> v1 = toVersion1(payload, true);
+      seededHll.fold(v1.data(), v1.size());
+
+      std::vector<uint8_t> otherHash(payload);
+      otherHash[offsetof(HLLHdr, hashId)] = HASH_ID + 1;
+      EXPECT_THROW(foldedHll.fold(otherHash.data(), otherHash.size()), SerializationError);
+      std::vector<uint8_t> otherVersion(payload);
+      otherVersion[offsetof(HLLHdr, version)] = HLL_HEADER_VERSION + 1;
+      EXPECT_THROW(foldedHll.fold(otherVersion.data(), otherVersion.size()), SerializationError);
+
+      hll.setChecksum(true);
+      std::vector<uint8_t> checked(payload.size());
+      hll.serialize(checked.data(), format, histogram);
+      hll.setChecksum(false);
+      EXPECT_EQ(HLL_HEADER_CHECKSUM, checked[offsetof(HLLHdr, flags)]);
+      foldedHll.fold(checked.data(), checked.size());
+      checked.back() ^= 1;
+      EXPECT_THROW(foldedHll.fold(checked.data(), checked.size()), SerializationError);
+    }
+  }
+}
+
+/**
+ * Strings are counted by their StringKey: the same string always gives the
+ * same key, whatever buffer it is read from, and distinct ones are counted
+ * as accurately as distinct integers.
+ */
+TEST_F(HllTest, TestStringKeys) {
+  const uint8_t PRECISION = 14;
+  const std::string url = "https://github.com/criteo/vertica-hyperloglog";
+  const std::string copy(url);
+  EXPECT_EQ(StringKey::of(url.data(), url.size()), StringKey::of(copy.data(), copy.size()));
+  EXPECT_NE(StringKey::of(url.data(), url.size()), StringKey::of(url.data(), url.size() - 1));
+  EXPECT_NE(StringKey::of("", 0), StringKey::of("\0", 1));
+
+  for (uint64_t cardinality: {100, 10000, 1000000}) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    Hll<uint64_t> hll(PRECISION, buffer.first.get());
+    hll.reset();
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < cardinality; ++i) {
+      const std::string id = "user-" + std::to_string(i);
+      keys.push_back(StringKey::of(id.data(), id.size()));
+      keys.push_back(StringKey::of(id.data(), id.size()));
+    }
+    hll.addBatch(keys.data(), keys.size());
+    EXPECT_NEAR(cardinality, hll.approximateCountDistinct(), 0.03 * cardinality);
+  }
+}
+
+/**
+ * A synopsis records the hash function of the first values or payload that
+ * go in, sparse or dense, and then refuses those of any other one. Empty
+ * synopses and version 1 payloads don't say, and fold into any.
+ */
+TEST_F(HllTest, TestHashFunctions) {
+  const uint8_t PRECISION = 12;
+  const HashFunction& xxh3 = *HashFunction::forName("xxh3");
+  const HashFunction& mix64 = *HashFunction::forName("mix64");
+  EXPECT_EQ(nullptr, HashFunction::forName("crc32"));
+  std::vector<uint64_t> values(5000);
+  std::iota(values.begin(), values.end(), 0);
+  std::vector<uint64_t> hashes(values.size());
+  xxh3.hashBatch(values.data(), values.size(), hashes.data(), MURMURHASH_DEFAULT_SEED);
+
+  SizedBuffer empty = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  Hll<uint64_t> emptyHll(PRECISION, empty.first.get());
+  emptyHll.reset();
+  std::vector<uint8_t> emptyPayload(emptyHll.getSerializedBufferSize(Format::NORMAL));
+  emptyHll.serialize(emptyPayload.data(), Format::NORMAL);
+  EXPECT_EQ(0, emptyPayload[offsetof(HLLHdr, hashId)]);
+
+  for (bool startSparse: {true, false}) {
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    Hll<uint64_t> hll(PRECISION, buffer.first.get());
+    if (startSparse) {
+      hll.resetSparse();
+    } else {
+      hll.reset();
+    }
+    hll.addHashes(hashes.data(), 10, xxh3.id);
+    hll.addHashes(hashes.data() + 10, hashes.size() - 10, xxh3.id);
+    EXPECT_NEAR(values.size(), hll.approximateCountDistinct(), 0.05 * values.size());
+    EXPECT_THROW(hll.add(1), SerializationError);
+    EXPECT_THROW(hll.addHashes(hashes.data(), 1, mix64.id), SerializationError);
+    hll.fold(emptyPayload.data(), emptyPayload.size());
+
+    hll.toDense();
+    std::vector<uint8_t> payload(hll.getSerializedBufferSize(Format::COMPACT_6BITS));
+    hll.serialize(payload.data(), Format::COMPACT_6BITS);
+    EXPECT_EQ(xxh3.id, payload[offsetof(HLLHdr, hashId)]);
+
+    SizedBuffer murmur = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    Hll<uint64_t> murmurHll(PRECISION, murmur.first.get());
+    murmurHll.reset();
+    murmurHll.add(1);
+    EXPECT_THROW(murmurHll.fold(payload.data(), payload.size()), SerializationError);
+    const uint8_t* payloads[] = {payload.data()};
+    const size_t lengths[] = {payload.size()};
+    EXPECT_THROW(murmurHll.foldMany(payloads, lengths, 1), SerializationError);
+    const std::vector<uint8_t> v1 = toVersion1(payload, true);
+    murmurHll.fold(v1.data(), v1.size());
+
+    SizedBuffer folded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    Hll<uint64_t> foldedHll(PRECISION, folded.first.get());
+    foldedHll.resetSparse();
+    foldedHll.fold(payload.data(), payload.size());
+    foldedHll.addHashes(hashes.data(), hashes.size(), xxh3.id);
+    EXPECT_EQ(hll.approximateCountDistinct(), foldedHll.approximateCountDistinct());
+    EXPECT_THROW(foldedHll.addBatch(values.data(), values.size()), SerializationError);
+  }
+}
+
+/**
+ * The joint estimate of A and B finds their intersection within a few
+ * standard errors of the union whether they are disjoint, overlap or are the
+ * same set, doesn't depend on which one comes first, and only takes
+ * synopses of the same precision.
+ */
+TEST_F(HllTest, TestJointEstimate) {
+  const uint8_t PRECISION = 14;
+  struct Overlap { uint64_t firstOnly, secondOnly, both; };
+  for (const Overlap& overlap: {Overlap{50000, 50000, 50000}, Overlap{100000, 100000, 0},
+                                Overlap{0, 0, 100000}, Overlap{1000000, 1000000, 10000},
+                                Overlap{0, 0, 0}, Overlap{100, 0, 20}}) {
+    SizedBuffer first = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    SizedBuffer second = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+    Hll<uint64_t> firstHll(PRECISION, first.first.get());
+    Hll<uint64_t> secondHll(PRECISION, second.first.get());
+    firstHll.reset();
+    secondHll.reset();
+    uint64_t value = 0;
+    for (uint64_t i = 0; i < overlap.firstOnly; ++i) {
+      firstHll.add(value++);
+    }
+    for (uint64_t i = 0; i < overlap.secondOnly; ++i) {
+      secondHll.add(value++);
+    }
+    for (uint64_t i = 0; i < overlap.both; ++i) {
+      firstHll.add(value);
+      secondHll.add(value++);
+    }
+
+    const double total = overlap.firstOnly + overlap.secondOnly + overlap.both;
+
+    const JointCardinality cardinality = firstHll.jointEstimate(secondHll);
+    EXPECT_NEAR(overlap.both, cardinality.both, 0.025 * total + 1)
+      << overlap.firstOnly << " " << overlap.secondOnly << " " << overlap.both;
+    EXPECT_NEAR(overlap.firstOnly, cardinality.firstOnly, 0.025 * total + 1);
+    EXPECT_NEAR(overlap.secondOnly, cardinality.secondOnly, 0.025 * total + 1);
+
+    const JointCardinality swapped = secondHll.jointEstimate(firstHll);
+    EXPECT_NEAR(cardinality.both, swapped.both, 1);
+    EXPECT_NEAR(cardinality.firstOnly, swapped.secondOnly, 1);
+  }
+
+  SizedBuffer first = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  SizedBuffer lower = Hll<uint64_t>::makeDeserializedBuffer(PRECISION - 1);
+  Hll<uint64_t> firstHll(PRECISION, first.first.get());
+  Hll<uint64_t> lowerHll(PRECISION - 1, lower.first.get());
+  firstHll.reset();
+  lowerHll.reset();
+  EXPECT_THROW(firstHll.jointEstimate(lowerHll), SerializationError);
+}
+
+/**
+ * The union HllWindow keeps of the last rows synopses is the same as folding
+ * them again for every row, whatever the window size, with rows without a
+ * synopsis and payloads of a higher precision among them.
+ */
+TEST_F(HllTest, TestWindowMatchesFold) {
+  const uint8_t PRECISION = 10;
+  const uint32_t DAYS = 40;
+  std::vector<std::vector<uint8_t> > payloads;
+  for (uint32_t day = 0; day < DAYS; ++day) {
+    const uint8_t precision = day % 5 == 3 ? PRECISION + 2 : PRECISION;
+    SizedBuffer buffer = Hll<uint64_t>::makeDeserializedBuffer(precision);
+    Hll<uint64_t> hll(precision, buffer.first.get());
+    hll.reset();
+    // users come back on the next days, some every day
+    for (uint64_t i = 0; i < 1000 * (day % 4 + 1); ++i) {
+      hll.add(day * 700 + i);
+      hll.add(i % 50);
+    }
+    payloads.push_back(std::vector<uint8_t>(hll.getSerializedBufferSize(Format::COMPACT_6BITS)));
+    hll.serialize(payloads.back().data(), Format::COMPACT_6BITS);
+  }
+
+  const HllKernels<uint64_t>& kernels = HllKernels<uint64_t>::forPrecision(PRECISION);
+  std::vector<uint8_t> scratch(Hll<uint64_t>::getMaxDeserializedBufferSize(PRECISION + 2));
+  for (uint32_t rows: {0, 1, 2, 7, 30}) {
+    std::vector<uint8_t> buffer(HllWindow<uint64_t>::getBufferSize(PRECISION, rows));
+    HllWindow<uint64_t> window(kernels, buffer.data(), rows);
+    if (rows == 7) {
+      window.setFoldScratch(scratch.data(), scratch.size());
+    }
+    window.reset();
+    for (uint32_t day = 0; day < DAYS; ++day) {
+      const bool missing = day % 11 == 5;
+      window.push(missing ? nullptr : payloads[day].data(), missing ? 0 : payloads[day].size());
+
+      SizedBuffer folded = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+      Hll<uint64_t> foldedHll(PRECISION, folded.first.get());
+      foldedHll.reset();
+      const uint32_t first = rows == 0 || day < rows ? 0 : day + 1 - rows;
+      for (uint32_t d = first; d <= day; ++d) {
+        if (d % 11 != 5) {
+          foldedHll.fold(payloads[d].data(), payloads[d].size());
+        }
+      }
+      EXPECT_EQ(foldedHll.approximateCountDistinct(), window.approximateCountDistinct())
+        << "rows " << rows << ", day " << day;
+    }
+  }
+
+  // the largest window a buffer budget takes
+  for (uint8_t precision: {10, 16, 18}) {
+    const size_t budget = 64 << 20;
+    const uint32_t maxRows = HllWindow<uint64_t>::getMaxRows(precision, budget);
+    EXPECT_LE(HllWindow<uint64_t>::getBufferSize(precision, maxRows), budget);
+    EXPECT_GT(HllWindow<uint64_t>::getBufferSize(precision, maxRows + 1), budget);
+  }
+  EXPECT_EQ(253U, HllWindow<uint64_t>::getMaxRows(18, 64 << 20));
+}
+
+/**
+ * The histogram a synopsis tracks after its registers is its histogram()
+ * after every batch, a row at a time as HllRunningCount adds them or more,
+ * so are the estimates taken from it.
+ */
+TEST_F(HllTest, TestRunningHistogram) {
+  const uint8_t PRECISION = 12;
+  const HashFunction& murmur = *HashFunction::forName("murmur");
+  std::vector<uint8_t> buffer(Hll<uint64_t>::getMaxDeserializedBufferSize(PRECISION, true));
+  Hll<uint64_t> tracked(PRECISION, buffer.data());
+  tracked.reset();
+  tracked.trackHistogram();
+  SizedBuffer reference = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  Hll<uint64_t> referenceHll(PRECISION, reference.first.get());
+  referenceHll.reset();
+  std::vector<uint64_t> values(1000);
+  std::vector<uint64_t> hashes(values.size());
+  for (uint64_t batch = 0; batch < 200; ++batch) {
+    // a batch per row at first, then larger ones, values seen again every other batch
+    const size_t n = batch < 50 ? 1 : values.size();
+    for (size_t i = 0; i < n; ++i) {
+      values[i] = (batch % 2 == 0 ? batch : 0) * values.size() + i;
+    }
+    murmur.hashBatch(values.data(), n, hashes.data(), MURMURHASH_DEFAULT_SEED);
+    tracked.addHashes(hashes.data(), n, murmur.id);
+    referenceHll.addHashes(hashes.data(), n, murmur.id);
+
+    const RegisterHistogram expected = referenceHll.histogram();
+    const RegisterHistogram histogram = tracked.histogram();
+    ASSERT_EQ(0, memcmp(expected.counts, histogram.counts, sizeof(expected.counts))) << "batch " << batch;
+    EXPECT_EQ(referenceHll.approximateCountDistinct(), tracked.approximateCountDistinct());
+  }
+}
+
+/**
+ * Dense payloads folded into a tracked synopsis that starts sparse, as the
+ * intermediates of HllCreateSynopsis are, leave the histogram() of the
+ * payloads and the serialized size that goes with it, whether they go in
+ * through fold(), foldMany() or add().
+ */
+TEST_F(HllTest, TestTrackedHistogramAfterFolds) {
+  const uint8_t PRECISION = 12;
+  SizedBuffer other = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  Hll<uint64_t> otherHll(PRECISION, other.first.get());
+  otherHll.reset();
+  for (uint64_t i = 0; i < 50000; ++i) {
+    otherHll.add(i);
+  }
+  std::vector<uint8_t> payload(otherHll.getSerializedBufferSize(Format::NORMAL));
+  otherHll.serialize(payload.data(), Format::NORMAL);
+  SizedBuffer scratch = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  Hll<uint64_t> reader(PRECISION, scratch.first.get());
+  const RegisterHistogram expected = reader.histogramOf(payload.data(), payload.size());
+
+  std::vector<uint8_t> buffer(Hll<uint64_t>::getMaxDeserializedBufferSize(PRECISION, true));
+  Hll<uint64_t> tracked(PRECISION, buffer.data());
+  for (int path = 0; path < 3; ++path) {
+    tracked.resetSparse();
+    tracked.trackHistogram();
+    if (path == 0) {
+      tracked.fold(payload.data(), payload.size());
+    } else if (path == 1) {
+      const uint8_t* byteArrays[] = {payload.data()};
+      const size_t lengths[] = {payload.size()};
+      tracked.foldMany(byteArrays, lengths, 1);
+    } else {
+      tracked.add(otherHll);
+    }
+
+    const RegisterHistogram histogram = tracked.histogram();
+    ASSERT_EQ(0, memcmp(expected.counts, histogram.counts, sizeof(expected.counts))) << "path " << path;
+    EXPECT_EQ(otherHll.approximateCountDistinct(), tracked.approximateCountDistinct());
+    const Format format = tracked.serializationFormat(Format::COMPACT_6BITS, histogram);
+    std::vector<uint8_t> serialized(tracked.getSerializedBufferSize(format, histogram));
+    tracked.serialize(serialized.data(), format, histogram);
+    EXPECT_EQ(otherHll.getSerializedBufferSize(format), serialized.size());
+  }
+}
+
+/**
+ * A synopsis that keeps its histogram after its registers gives the same
+ * histogram, estimates and payloads as one that doesn't, through values
+ * added sparse and dense, folds and resets.
+ */
+TEST_F(HllTest, TestTrackedHistogram) {
+  const uint8_t PRECISION = 12;
+  const HashFunction& murmur = *HashFunction::forName("murmur");
+  std::vector<uint8_t> buffer(Hll<uint64_t>::getMaxDeserializedBufferSize(PRECISION, true));
+  Hll<uint64_t> tracked(PRECISION, buffer.data());
+  SizedBuffer reference = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  Hll<uint64_t> referenceHll(PRECISION, reference.first.get());
+
+  SizedBuffer other = Hll<uint64_t>::makeDeserializedBuffer(PRECISION);
+  Hll<uint64_t> otherHll(PRECISION, other.first.get());
+  otherHll.reset();
+  for (uint64_t i = 0; i < 50000; ++i) {
+    otherHll.add(i * 7);
+  }
+  std::vector<uint8_t> payload(otherHll.getSerializedBufferSize(Format::COMPACT_6BITS));
+  otherHll.serialize(payload.data(), Format::COMPACT_6BITS);
+
+  for (bool startSparse: {true, false}) {
+    if (startSparse) {
+      tracked.resetSparse();
+      referenceHll.resetSparse();
+    } else {
+      tracked.reset();
+      referenceHll.reset();
+    }
+    tracked.trackHistogram();
+    EXPECT_TRUE(tracked.tracksHistogram());
+    std::vector<uint64_t> values(3000);
+    std::vector<uint64_t> hashes(values.size());
+    for (uint64_t step = 0; step < 12; ++step) {
+      for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = step * 1000 + i;
+      }
+      if (step % 3 == 0) {
+        tracked.add(values[0]);
+        referenceHll.add(values[0]);
+      } else if (step % 3 == 1) {
+        tracked.addBatch(values.data(), values.size());
+        referenceHll.addBatch(values.data(), values.size());
+      } else {
+        murmur.hashBatch(values.data(), values.size(), hashes.data(), MURMURHASH_DEFAULT_SEED);
+        tracked.addHashes(hashes.data(), hashes.size(), murmur.id);
+        referenceHll.addHashes(hashes.data(), hashes.size(), murmur.id);
+      }
+      if (step == 8) {
+        tracked.fold(payload.data(), payload.size());
+        referenceHll.fold(payload.data(), payload.size());
+      }
+
+      const RegisterHistogram expected = referenceHll.histogram();
+      const RegisterHistogram histogram = tracked.histogram();
+      ASSERT_EQ(0, memcmp(expected.counts, histogram.counts, sizeof(expected.counts)))
+        << "sparse " << startSparse << ", step " << step;
+      EXPECT_EQ(referenceHll.approximateCountDistinct(), tracked.approximateCountDistinct());
+      EXPECT_EQ(referenceHll.approximateCountDistinct_beta(), tracked.approximateCountDistinct_beta());
+    }
+
+    EXPECT_TRUE(tracked.tracksHistogram());
+    tracked.toDense();
+    referenceHll.toDense();
+    for (Format format: {Format::COMPACT_4BITS_EXCEPTIONS, Format::ENTROPY}) {
+      std::vector<uint8_t> expected(referenceHll.getSerializedBufferSize(format, referenceHll.histogram()));
+      referenceHll.serialize(expected.data(), format);
+      std::vector<uint8_t> serialized(tracked.getSerializedBufferSize(format, tracked.histogram()));
+      tracked.serialize(serialized.data(), format);
+      EXPECT_EQ(expected, serialized);
+    }
+  }
+}
+
+/**
+ * A histogram is only tracked when asked for: reset() starts without one
+ * whatever the buffer held, e.g. one without room for it that held another
+ * synopsis.
+ */
+TEST_F(HllTest, TestResetDoesNotTrackHistogram) {
+  const uint8_t PRECISION = 12;
+  std::vector<uint8_t> buffer(Hll<uint64_t>::getMaxDeserializedBufferSize(PRECISION), 0xff);
+  Hll<uint64_t> hll(PRECISION, buffer.data());
+  hll.reset();
+  EXPECT_FALSE(hll.tracksHistogram());
+  std::fill(buffer.begin(), buffer.end(), 0xff);
+  hll.resetSparse();
+  EXPECT_FALSE(hll.tracksHistogram());
+  hll.add(1);
+  EXPECT_EQ(1u, hll.approximateCountDistinct());
+}
+
 } // namespace
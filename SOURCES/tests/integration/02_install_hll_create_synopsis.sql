@@ -4,4 +4,16 @@ AS LANGUAGE 'C++'
 NAME 'HllCreateSynopsisFactory'
 LIBRARY HllLib;
 
+CREATE OR REPLACE AGGREGATE FUNCTION HllCreateSynopsis
+AS LANGUAGE 'C++'
+NAME 'HllCreateSynopsisVarcharFactory'
+LIBRARY HllLib;
+
+CREATE OR REPLACE AGGREGATE FUNCTION HllCreateSynopsis
+AS LANGUAGE 'C++'
+NAME 'HllCreateSynopsisVarbinaryFactory'
+LIBRARY HllLib;
+
 GRANT EXECUTE ON AGGREGATE FUNCTION HllCreateSynopsis(BIGINT) TO PUBLIC;
+GRANT EXECUTE ON AGGREGATE FUNCTION HllCreateSynopsis(VARCHAR) TO PUBLIC;
+GRANT EXECUTE ON AGGREGATE FUNCTION HllCreateSynopsis(VARBINARY) TO PUBLIC;
@@ -5,3 +5,50 @@ NAME 'HllDistinctCountFactory'
 LIBRARY HllLib;
 
 GRANT EXECUTE ON AGGREGATE FUNCTION HllDistinctCount(VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE FUNCTION HllEstimate
+AS LANGUAGE 'C++'
+NAME 'HllEstimateFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON FUNCTION HllEstimate(VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE FUNCTION HllUnionCount
+AS LANGUAGE 'C++'
+NAME 'HllUnionCountFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON FUNCTION HllUnionCount(VARBINARY, VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE FUNCTION HllIntersectCount
+AS LANGUAGE 'C++'
+NAME 'HllIntersectCountFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON FUNCTION HllIntersectCount(VARBINARY, VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE ANALYTIC FUNCTION HllRollingDistinctCount
+AS LANGUAGE 'C++'
+NAME 'HllRollingDistinctCountFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON ANALYTIC FUNCTION HllRollingDistinctCount(VARBINARY) TO PUBLIC;
+
+CREATE OR REPLACE TRANSFORM FUNCTION HllRunningCount
+AS LANGUAGE 'C++'
+NAME 'HllRunningCountFactory'
+LIBRARY HllLib;
+
+CREATE OR REPLACE TRANSFORM FUNCTION HllRunningCount
+AS LANGUAGE 'C++'
+NAME 'HllRunningCountVarcharFactory'
+LIBRARY HllLib;
+
+CREATE OR REPLACE TRANSFORM FUNCTION HllRunningCount
+AS LANGUAGE 'C++'
+NAME 'HllRunningCountVarbinaryFactory'
+LIBRARY HllLib;
+
+GRANT EXECUTE ON TRANSFORM FUNCTION HllRunningCount(BIGINT) TO PUBLIC;
+GRANT EXECUTE ON TRANSFORM FUNCTION HllRunningCount(VARCHAR) TO PUBLIC;
+GRANT EXECUTE ON TRANSFORM FUNCTION HllRunningCount(VARBINARY) TO PUBLIC;
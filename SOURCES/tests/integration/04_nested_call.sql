@@ -14,3 +14,78 @@ from
     select 12345
   ) as t
 ) as u;
+
+select HllEstimate(synopsis USING PARAMETERS hllLeadingBits=11) as cnt
+from
+(
+  select HllCreateSynopsis(value USING PARAMETERS hllLeadingBits=11) as synopsis
+  from
+  (
+    select 1234567890 as value
+    union
+    select 2234567890
+    union
+    select 67890
+    union
+    select 12345
+  ) as t
+) as u;
+
+select HllUnionCount(a.synopsis, b.synopsis USING PARAMETERS hllLeadingBits=11) as union_cnt,
+       HllIntersectCount(a.synopsis, b.synopsis USING PARAMETERS hllLeadingBits=11) as intersect_cnt
+from
+(
+  select HllCreateSynopsis(value USING PARAMETERS hllLeadingBits=11) as synopsis
+  from
+  (
+    select 1234567890 as value
+    union
+    select 2234567890
+    union
+    select 67890
+  ) as t
+) as a,
+(
+  select HllCreateSynopsis(value USING PARAMETERS hllLeadingBits=11) as synopsis
+  from
+  (
+    select 67890 as value
+    union
+    select 12345
+  ) as t
+) as b;
+
+select day, HllRollingDistinctCount(synopsis USING PARAMETERS hllLeadingBits=11, windowRows=2)
+  over (order by day) as cnt
+from
+(
+  select day, HllCreateSynopsis(value USING PARAMETERS hllLeadingBits=11) as synopsis
+  from
+  (
+    select 1 as day, 1234567890 as value
+    union
+    select 1, 67890
+    union
+    select 2, 67890
+    union
+    select 2, 12345
+    union
+    select 3, 2234567890
+  ) as t
+  group by day
+) as u;
+
+select HllRunningCount(value USING PARAMETERS hllLeadingBits=11, emitEvery=2)
+  over (order by ts)
+from
+(
+  select 1 as ts, 1234567890 as value
+  union
+  select 2, 67890
+  union
+  select 3, 67890
+  union
+  select 4, 12345
+  union
+  select 5, 2234567890
+) as t;
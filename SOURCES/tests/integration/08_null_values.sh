@@ -0,0 +1,25 @@
+#!/bin/bash
+# NULLs aren't counted, as in COUNT(DISTINCT), by HllCreateSynopsis and HllRunningCount, whatever the input type
+
+VSQL="/opt/vertica/bin/vsql -U dbadmin -t -A -v ON_ERROR_STOP=on"
+VALUES="select 1 as value union all select 2 union all select 3 union all select NULL union all select NULL"
+
+expect() {
+  if [ "$2" != "$3" ]; then
+    echo "$1: expected $3, got $2"
+    exit 1
+  fi
+}
+
+bigint=$($VSQL -c "select HllEstimate(HllCreateSynopsis(value)) from ($VALUES) as t;") || exit 1
+expect "HllCreateSynopsis(BIGINT)" "$bigint" 3
+
+varchar=$($VSQL -c "select HllEstimate(HllCreateSynopsis(value::varchar)) from ($VALUES) as t;") || exit 1
+expect "HllCreateSynopsis(VARCHAR)" "$varchar" 3
+
+# the NULLs come last, still counted as rows
+running=$($VSQL -F ',' -c "select HllRunningCount(value USING PARAMETERS emitEvery=1000) over (order by value nulls last) from ($VALUES) as t;") || exit 1
+expect "HllRunningCount(BIGINT)" "$running" "5,3"
+
+running=$($VSQL -F ',' -c "select HllRunningCount(value::varchar USING PARAMETERS emitEvery=1000) over (order by value nulls last) from ($VALUES) as t;") || exit 1
+expect "HllRunningCount(VARCHAR)" "$running" "5,3"